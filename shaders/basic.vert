@@ -19,9 +19,15 @@ layout(binding = 0) uniform Data {
     FrameData frame;
 };
 
-uniform mat4 model;
+layout(std430, binding = 2) readonly buffer Instances {
+    mat4 instance_transforms[];
+};
+
+// First instance of the current batch in instance_transforms
+uniform uint instance_offset;
 
 void main() {
+    const mat4 model = instance_transforms[instance_offset + uint(gl_InstanceID)];
     const vec4 position = model * vec4(in_pos, 1.0);
 
     out_normal = normalize(mat3(model) * in_normal);
@@ -0,0 +1,42 @@
+// Clustered lighting: the view frustum is split into screen tiles and exponential depth slices.
+// Constants must match LightClusters.h
+
+#define CLUSTER_TILE_SIZE 64
+#define CLUSTER_SLICES 24
+#define CLUSTER_MAX_LIGHTS 256
+
+struct ClusterRange {
+    uint offset;
+    uint count;
+};
+
+uniform mat4 cluster_view;
+uniform uvec2 cluster_tiles;
+uniform float cluster_near;
+uniform float cluster_far;
+
+uint cluster_slice(float view_depth) {
+    const float d = max(view_depth, cluster_near);
+    const float slice = log(d / cluster_near) / log(cluster_far / cluster_near) * CLUSTER_SLICES;
+    return uint(clamp(slice, 0.0, float(CLUSTER_SLICES - 1)));
+}
+
+// View depth of the near plane of a slice. Slice 0 starts at the camera, the last one never ends
+float cluster_slice_depth(uint slice) {
+    if(slice == 0) {
+        return 0.0;
+    }
+    if(slice >= CLUSTER_SLICES) {
+        return 1.0e6;
+    }
+    return cluster_near * pow(cluster_far / cluster_near, float(slice) / CLUSTER_SLICES);
+}
+
+uint cluster_index(uvec2 tile, uint slice) {
+    return (tile.y * cluster_tiles.x + tile.x) * CLUSTER_SLICES + slice;
+}
+
+vec3 heatmap(float t) {
+    t = saturate(t);
+    return saturate(vec3(t * 4.0 - 2.0, t < 0.5 ? t * 2.0 : 2.0 - t * 2.0, 2.0 - t * 4.0));
+}
@@ -1,5 +1,17 @@
 #version 450 core
 
+#ifdef ALPHA_TEST
+layout(location = 0) in vec2 in_uv;
+
+layout(binding = 0) uniform sampler2D in_texture;
+
+uniform float alpha_cutoff;
+#endif
+
 void main() {
-    
-}
\ No newline at end of file
+#ifdef ALPHA_TEST
+    if(texture(in_texture, in_uv).a <= alpha_cutoff) {
+        discard;
+    }
+#endif
+}
@@ -0,0 +1,42 @@
+#version 450
+
+// Vertex shader of depth only passes (Z-prepass, shadow maps) and of the visibility buffer pass
+
+layout(location = 0) in vec3 in_pos;
+
+#ifdef ALPHA_TEST
+layout(location = 2) in vec2 in_uv;
+
+layout(location = 0) out vec2 out_uv;
+#endif
+
+#ifdef VISIBILITY
+layout(location = 1) flat out uint out_draw_id;
+#endif
+
+layout(std430, binding = 2) readonly buffer Instances {
+    mat4 instance_transforms[];
+};
+
+// First instance of the current batch in instance_transforms
+uniform uint instance_offset;
+uniform mat4 view_proj;
+
+// The G-buffer pass tests its depth for equality with the Z-prepass, see gbuffer.vert
+invariant gl_Position;
+
+void main() {
+    const mat4 model = instance_transforms[instance_offset + uint(gl_InstanceID)];
+
+#ifdef ALPHA_TEST
+    out_uv = in_uv;
+#endif
+
+#ifdef VISIBILITY
+    out_draw_id = instance_offset + uint(gl_InstanceID);
+#endif
+
+    // Same expression as gbuffer.vert
+    const vec4 position = model * vec4(in_pos, 1.0);
+    gl_Position = view_proj * position;
+}
@@ -0,0 +1,27 @@
+// Automatic exposure (see AutoExposure.h)
+
+#define HISTOGRAM_BINS 256
+
+// Bin 0 holds the pixels too dark to be counted, the others split the log-luminance range evenly
+layout(std430, binding = 12) buffer LuminanceHistogram {
+    uint histogram[HISTOGRAM_BINS];
+};
+
+layout(std430, binding = 13) buffer Exposure {
+    ExposureData exposure_data;
+};
+
+uniform float min_log_luminance;
+uniform float log_luminance_range;
+
+uint luminance_bin(float luminance) {
+    if(luminance < exp2(min_log_luminance)) {
+        return 0;
+    }
+    const float t = saturate((log2(luminance) - min_log_luminance) / log_luminance_range);
+    return uint(t * float(HISTOGRAM_BINS - 2)) + 1;
+}
+
+float bin_log_luminance(uint bin) {
+    return min_log_luminance + (float(bin - 1) + 0.5) / float(HISTOGRAM_BINS - 2) * log_luminance_range;
+}
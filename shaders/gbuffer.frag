@@ -1,9 +1,11 @@
 #version 450
 
 #include "utils.glsl"
+#include "motion.glsl"
 
 layout(location = 0) out vec4 out_albedo_roughness;
 layout(location = 1) out vec4 out_normal_metal;
+layout(location = 2) out vec2 out_motion;
 
 layout(location = 0) in vec3 in_normal;
 layout(location = 1) in vec2 in_uv;
@@ -46,4 +48,6 @@ void main() {
     
     vec3 encoded_normal = normalize(normal) * 0.5 + 0.5;
     out_normal_metal = vec4(encoded_normal, metallic);
+
+    out_motion = motion_vector(in_position);
 }
@@ -11,11 +11,12 @@ layout(location = 0) in vec2 in_uv;
 uniform uint debug_mode; // 0=depth, 1=normal, 2=albedo, 3=metallic, 4=roughness
 
 void main() {
-    vec2 uv = in_uv;
+    // G-buffer textures can be larger than the viewport
+    const ivec2 coord = ivec2(gl_FragCoord.xy);
     
-    vec4 albedo_roughness = texture(gbuffer_albedo_roughness, uv);
-    vec4 normal_metal = texture(gbuffer_normal_metal, uv);
-    float depth = texture(gbuffer_depth, uv).r;
+    vec4 albedo_roughness = texelFetch(gbuffer_albedo_roughness, coord, 0);
+    vec4 normal_metal = texelFetch(gbuffer_normal_metal, coord, 0);
+    float depth = texelFetch(gbuffer_depth, coord, 0).r;
     
     vec3 albedo = albedo_roughness.rgb;
     float roughness = albedo_roughness.a;
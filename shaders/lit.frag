@@ -2,10 +2,14 @@
 
 #include "utils.glsl"
 #include "lighting.glsl"
+#include "shadows.glsl"
 
 // fragment shader of the main lighting pass
 
 layout(location = 0) out vec4 out_color;
+#ifdef WEIGHTED_OIT
+layout(location = 1) out float out_revealage;
+#endif
 
 layout(location = 0) in vec3 in_normal;
 layout(location = 1) in vec2 in_uv;
@@ -26,7 +30,6 @@ uniform float alpha_cutoff;
 
 layout(binding = 4) uniform samplerCube in_envmap;
 layout(binding = 5) uniform sampler2D brdf_lut;
-layout(binding = 6) uniform sampler2D shadow_map;
 
 layout(binding = 0) uniform Data {
     FrameData frame;
@@ -64,21 +67,8 @@ void main() {
     acc += eval_ibl(in_envmap, brdf_lut, normal, view_dir, base_color, metallic, roughness) * frame.ibl_intensity;
     {
         // Shadowing for directional sun
-        {
-            vec4 fragPosLightSpace = frame.light_view_proj * vec4(in_position, 1.0);
-            vec3 projCoords = fragPosLightSpace.xyz / fragPosLightSpace.w;
-            projCoords.xy = projCoords.xy * 0.5 + 0.5;
-
-            float shadow = 0.0;
-            if(projCoords.x >= 0.0 && projCoords.x <= 1.0 && projCoords.y >= 0.0 && projCoords.y <= 1.0 && projCoords.z >= 0.0 && projCoords.z <= 1.0) {
-                float closestDepth = texture(shadow_map, projCoords.xy).r;
-                float currentDepth = projCoords.z;
-                float bias = max(0.005 * (1.0 - dot(normal, frame.sun_dir)), 0.0005);
-                shadow = currentDepth - bias > closestDepth ? 1.0 : 0.0;
-            }
-
-            acc += (1.0 - shadow) * frame.sun_color * eval_brdf(normal, view_dir, frame.sun_dir, base_color, metallic, roughness);
-        }
+        const float shadow = sun_shadow(in_position, normalize(in_normal));
+        acc += shadow * frame.sun_color * eval_brdf(normal, view_dir, frame.sun_dir, base_color, metallic, roughness);
 
         for(uint i = 0; i != frame.point_light_count; ++i) {
             PointLight light = point_lights[i];
@@ -98,6 +88,14 @@ void main() {
 
     out_color = vec4(acc, alpha);
 
+#ifdef WEIGHTED_OIT
+    // Weighted blended OIT (McGuire and Bavoil 2013): premultiplied colors are summed with a weight favoring close
+    // surfaces, the revealage is the product of (1 - alpha) over all the surfaces of the pixel
+    const float weight = alpha * clamp(0.03 / (1e-5 + pow(length(to_view) / 200.0, 4.0)), 1e-2, 3e3);
+    out_color = vec4(acc * alpha, alpha) * weight;
+    out_revealage = alpha;
+#endif
+
 
 #ifdef DEBUG_NORMAL
     out_color = vec4(normal * 0.5 + 0.5, 1.0);
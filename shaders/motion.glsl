@@ -0,0 +1,12 @@
+// Motion vectors for temporal anti-aliasing (see TemporalAA.h)
+
+layout(binding = 3) uniform Temporal {
+    TemporalData temporal;
+};
+
+// Screen space motion since the previous frame, in UV units, for static geometry
+vec2 motion_vector(vec3 position) {
+    const vec4 current = temporal.view_proj * vec4(position, 1.0);
+    const vec4 previous = temporal.prev_view_proj * vec4(position, 1.0);
+    return (current.xy / current.w - previous.xy / previous.w) * 0.5;
+}
@@ -0,0 +1,22 @@
+#version 450
+
+// Resolves the weighted blended OIT targets, blended over the opaque scene with (SRC_ALPHA, ONE_MINUS_SRC_ALPHA)
+
+layout(location = 0) out vec4 out_color;
+
+layout(binding = 0) uniform sampler2D in_accum;
+layout(binding = 1) uniform sampler2D in_revealage;
+
+void main() {
+    const ivec2 coord = ivec2(gl_FragCoord.xy);
+
+    const float revealage = texelFetch(in_revealage, coord, 0).r;
+    if(revealage == 1.0) {
+        // No transparent surface
+        discard;
+    }
+
+    const vec4 accum = texelFetch(in_accum, coord, 0);
+    const vec3 average_color = accum.rgb / max(accum.a, 1e-5);
+    out_color = vec4(average_color, 1.0 - revealage);
+}
@@ -6,8 +6,11 @@ layout(location = 0) in vec2 in_uv;
 
 layout(binding = 0) uniform sampler2D in_tex;
 
+// Part of the texture covering the screen
+uniform vec2 uv_scale = vec2(1.0);
+
 void main() {
-    out_color = texture(in_tex, in_uv);
+    out_color = texture(in_tex, in_uv * uv_scale);
 }
 
 
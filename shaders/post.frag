@@ -0,0 +1,129 @@
+#version 450
+
+#include "utils.glsl"
+
+// Final pass writing the screen, the steps are selected by the TONE_MAPPING_ACES, TONE_MAPPING_REINHARD,
+// COLOR_GRADING and DITHERING defines (see PostProcess.h)
+
+layout(location = 0) out vec4 out_color;
+
+layout(location = 0) in vec2 in_uv;
+
+layout(binding = 0) uniform sampler2D in_hdr;
+// N slices of NxN texels side by side, in sRGB
+layout(binding = 1) uniform sampler2D in_lut;
+
+// Manual exposure, used unless auto_exposure is set
+uniform float exposure = 1.0;
+
+// Written by the auto exposure on the GPU
+layout(std430, binding = 13) readonly buffer Exposure {
+    ExposureData exposure_data;
+};
+uniform uint auto_exposure = 0;
+
+// Part of in_hdr that was rendered, it is upscaled to the output resolution
+uniform uvec2 source_size;
+// 0 = bilinear, 1 = edge-aware
+uniform uint upscale_filter = 0;
+
+vec3 aces(vec3 x) {
+    const float a = 2.51;
+    const float b = 0.03;
+    const float c = 2.43;
+    const float d = 0.59;
+    const float e = 0.14;
+    return saturate((x * (a * x + b)) / (x * (c * x + d) + e));
+}
+
+float reinhard(float hdr) {
+    return hdr / (hdr + 1.0);
+}
+
+vec3 reinhard(vec3 x) {
+    return vec3(reinhard(x.x), reinhard(x.y), reinhard(x.z));
+}
+
+vec3 tonemap_texel(ivec2 coord, float frame_exposure) {
+    const vec3 hdr = texelFetch(in_hdr, clamp(coord, ivec2(0), ivec2(source_size) - 1), 0).rgb * frame_exposure;
+#if defined(TONE_MAPPING_ACES)
+    return aces(hdr);
+#elif defined(TONE_MAPPING_REINHARD)
+    return reinhard(hdr);
+#else
+    return saturate(hdr);
+#endif
+}
+
+vec3 color_grade(vec3 srgb) {
+    const float size = float(textureSize(in_lut, 0).y);
+
+    // Blue selects the slice, interpolate between the two closest ones
+    const float slice = srgb.b * (size - 1.0);
+    const float slice0 = floor(slice);
+    const float slice1 = min(slice0 + 1.0, size - 1.0);
+
+    // Texel centers of the slice
+    const vec2 in_slice = (srgb.rg * (size - 1.0) + 0.5) / vec2(size * size, size);
+    const vec3 graded0 = textureLod(in_lut, in_slice + vec2(slice0 / size, 0.0), 0.0).rgb;
+    const vec3 graded1 = textureLod(in_lut, in_slice + vec2(slice1 / size, 0.0), 0.0).rgb;
+    return mix(graded0, graded1, slice - slice0);
+}
+
+// Interleaved gradient noise (Jimenez 2014), in [0, 1)
+float dither_noise(vec2 pixel) {
+    return fract(52.9829189 * fract(dot(pixel, vec2(0.06711056, 0.00583715))));
+}
+
+void main() {
+    // Filtering happens after tonemapping so that very bright texels don't bleed over their neighbours
+    const vec2 pos = in_uv * vec2(source_size) - 0.5;
+    const ivec2 base = ivec2(floor(pos));
+    const vec2 f = pos - vec2(base);
+
+    const float frame_exposure = auto_exposure != 0 ? exposure_data.exposure : exposure;
+    const vec3 texels[4] = {
+        tonemap_texel(base, frame_exposure),
+        tonemap_texel(base + ivec2(1, 0), frame_exposure),
+        tonemap_texel(base + ivec2(0, 1), frame_exposure),
+        tonemap_texel(base + ivec2(1, 1), frame_exposure),
+    };
+    float weights[4] = {
+        (1.0 - f.x) * (1.0 - f.y),
+        f.x * (1.0 - f.y),
+        (1.0 - f.x) * f.y,
+        f.x * f.y,
+    };
+
+    if(upscale_filter == 1) {
+        // Don't blend across edges: texels that differ from the nearest one lose most of their weight
+        const uint nearest = (f.x < 0.5 ? 0 : 1) + (f.y < 0.5 ? 0 : 2);
+        const float reference = luminance(texels[nearest]);
+        for(uint i = 0; i != 4; ++i) {
+            weights[i] *= 1.0 / (1.0 + 32.0 * abs(luminance(texels[i]) - reference));
+        }
+    }
+
+    vec3 tone_mapped = vec3(0.0);
+    float total_weight = 0.0;
+    for(uint i = 0; i != 4; ++i) {
+        tone_mapped += texels[i] * weights[i];
+        total_weight += weights[i];
+    }
+
+    vec3 color = tone_mapped / total_weight;
+
+#if defined(COLOR_GRADING) || defined(DITHERING)
+    // The framebuffer is sRGB: grading LUTs and quantization are both in sRGB space
+    vec3 srgb = linear_to_sRGB(color);
+#ifdef COLOR_GRADING
+    srgb = color_grade(saturate(srgb));
+#endif
+#ifdef DITHERING
+    srgb += (dither_noise(gl_FragCoord.xy) - 0.5) / 255.0;
+#endif
+    color = sRGB_to_linear(saturate(srgb));
+#endif
+
+    out_color = vec4(color, 1.0);
+}
@@ -1,4 +0,0 @@
-#version 450 core
-
-void main() {
-}
@@ -0,0 +1,35 @@
+// Sun shadows from cascaded shadow maps (see ShadowCascades.h)
+
+layout(binding = 2) uniform Shadows {
+    ShadowData shadow;
+};
+
+layout(binding = 6) uniform sampler2DArrayShadow in_shadow_map;
+
+float sun_shadow(vec3 position, vec3 normal) {
+    const float view_depth = -(shadow.camera_view * vec4(position, 1.0)).z;
+
+    for(uint i = 0; i != shadow.cascade_count; ++i) {
+        if(view_depth > shadow.cascade_splits[i]) {
+            continue;
+        }
+
+        // Normal offset to avoid acne on surfaces facing away from the sun
+        const vec3 offset_position = position + normal * shadow.cascade_texel_sizes[i] * 1.5;
+        const vec4 clip = shadow.cascade_view_proj[i] * vec4(offset_position, 1.0);
+        const vec3 proj = clip.xyz / clip.w;
+        const vec2 uv = proj.xy * 0.5 + 0.5;
+
+        // 3x3 taps, each one being a bilinear PCF lookup
+        const vec2 texel = 1.0 / vec2(textureSize(in_shadow_map, 0).xy);
+        float lit = 0.0;
+        for(int y = -1; y <= 1; ++y) {
+            for(int x = -1; x <= 1; ++x) {
+                lit += texture(in_shadow_map, vec4(uv + vec2(x, y) * texel, float(i), proj.z));
+            }
+        }
+        return lit / 9.0;
+    }
+
+    return 1.0;
+}
@@ -8,8 +8,6 @@ struct CameraData {
 struct FrameData {
     CameraData camera;
 
-    mat4 light_view_proj;
-
     vec3 sun_dir;
     uint point_light_count;
 
@@ -17,6 +15,69 @@ struct FrameData {
     float ibl_intensity;
 };
 
+#define MAX_SHADOW_CASCADES 4
+
+struct ShadowData {
+    mat4 camera_view;
+    mat4 cascade_view_proj[MAX_SHADOW_CASCADES];
+    vec4 cascade_splits; // View depth where each cascade ends
+    vec4 cascade_texel_sizes; // World size of a shadow map texel
+    uint cascade_count;
+    float padding0;
+    float padding1;
+    float padding2;
+};
+
+struct TemporalData {
+    mat4 view_proj; // Without jitter
+    mat4 prev_view_proj; // Without jitter
+    mat4 reprojection; // From the current clip space to the previous one, without jitter
+    vec2 jitter; // In render pixels
+    float padding0;
+    float padding1;
+};
+
+struct ExposureData {
+    float exposure; // Multiplier applied to the HDR color before tonemapping
+    float average_log_luminance; // log2 of the trimmed average luminance of the last frame
+    float padding0;
+    float padding1;
+};
+
+// Visibility buffer texels pack (draw ID + 1, triangle ID), 0 means no opaque object
+#define VISIBILITY_TRIANGLE_BITS 20
+
+struct VisibilityBatch {
+    uvec2 albedo_texture; // Bindless handles
+    uvec2 normal_texture;
+    uvec2 metal_rough_texture;
+    uint first_vertex; // In the merged vertex buffer
+    uint first_index; // In the merged index buffer
+    vec3 base_color_factor;
+    float alpha_cutoff;
+    vec2 metal_rough_factor;
+    float padding0;
+    float padding1;
+};
+
+#define MAX_TERRAIN_LODS 16
+#define MAX_CLIPMAP_LEVELS 8
+
+// Terrain patch selected by the CDLOD quadtree
+struct TerrainNode {
+    vec2 origin; // World XZ of the min corner
+    float size; // World size of a side
+    uint lod; // 0 is the finest
+};
+
+// Runtime virtual texture of the terrain surface (see TerrainVirtualTexture.h)
+#define RVT_PAGE_SIZE 128 // Texels of a page, without its border
+#define RVT_PAGE_BORDER 4 // Texels copied from the neighboring pages on each side, for filtering
+#define RVT_MIP_COUNT 12
+#define RVT_WINDOW_PAGES 32 // Indirection entries per side of each mip, centered on the camera
+#define RVT_MAX_REQUESTS 1024 // Pages requested by the feedback of a frame
+#define RVT_MAX_BAKES 8 // Pages baked per frame
+
 struct PointLight {
     vec3 position;
     float radius;
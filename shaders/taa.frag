@@ -0,0 +1,128 @@
+#version 450
+
+#include "utils.glsl"
+#include "motion.glsl"
+
+layout(location = 0) out vec4 out_color;
+
+layout(location = 0) in vec2 in_uv;
+
+layout(binding = 0) uniform sampler2D in_color;
+layout(binding = 1) uniform sampler2D in_depth;
+layout(binding = 2) uniform sampler2D in_motion;
+layout(binding = 3) uniform sampler2D in_history;
+
+// Part of the color, depth and motion textures that was rendered
+uniform uvec2 render_size;
+// Weight of the current frame, 1.0 when there is no history
+uniform float blend_factor;
+uniform uint sharp_history;
+
+// Accumulate in a tonemapped space so that very bright samples don't dominate (and flicker)
+vec3 compress(vec3 color) {
+    return color / (1.0 + luminance(color));
+}
+
+vec3 uncompress(vec3 color) {
+    return color / max(1.0 - luminance(color), 1.0e-4);
+}
+
+// Catmull-Rom filter using 9 bilinear taps
+vec3 sample_catmull_rom(vec2 uv) {
+    const vec2 size = vec2(textureSize(in_history, 0));
+    const vec2 pos = uv * size;
+    const vec2 center = floor(pos - 0.5) + 0.5;
+    const vec2 f = pos - center;
+
+    const vec2 w0 = f * (-0.5 + f * (1.0 - 0.5 * f));
+    const vec2 w1 = 1.0 + f * f * (-2.5 + 1.5 * f);
+    const vec2 w2 = f * (0.5 + f * (2.0 - 1.5 * f));
+    const vec2 w3 = f * f * (-0.5 + 0.5 * f);
+
+    const vec2 w12 = w1 + w2;
+    const vec2 uv0 = (center - 1.0) / size;
+    const vec2 uv12 = (center + w2 / w12) / size;
+    const vec2 uv3 = (center + 2.0) / size;
+
+    vec3 result = vec3(0.0);
+    result += textureLod(in_history, vec2(uv0.x, uv0.y), 0.0).rgb * w0.x * w0.y;
+    result += textureLod(in_history, vec2(uv12.x, uv0.y), 0.0).rgb * w12.x * w0.y;
+    result += textureLod(in_history, vec2(uv3.x, uv0.y), 0.0).rgb * w3.x * w0.y;
+    result += textureLod(in_history, vec2(uv0.x, uv12.y), 0.0).rgb * w0.x * w12.y;
+    result += textureLod(in_history, vec2(uv12.x, uv12.y), 0.0).rgb * w12.x * w12.y;
+    result += textureLod(in_history, vec2(uv3.x, uv12.y), 0.0).rgb * w3.x * w12.y;
+    result += textureLod(in_history, vec2(uv0.x, uv3.y), 0.0).rgb * w0.x * w3.y;
+    result += textureLod(in_history, vec2(uv12.x, uv3.y), 0.0).rgb * w12.x * w3.y;
+    result += textureLod(in_history, vec2(uv3.x, uv3.y), 0.0).rgb * w3.x * w3.y;
+
+    // The negative lobes can produce negative values
+    return max(result, vec3(0.0));
+}
+
+void main() {
+    // Position of the output pixel in render pixels, without jitter
+    const vec2 pos = in_uv * vec2(render_size);
+    // Render pixel whose jittered sample is the closest
+    const ivec2 center = ivec2(floor(pos + temporal.jitter));
+
+    vec3 current = vec3(0.0);
+    float total_weight = 0.0;
+    vec3 moment1 = vec3(0.0);
+    vec3 moment2 = vec3(0.0);
+    float closest_depth = 0.0;
+    ivec2 closest = center;
+
+    for(int y = -1; y <= 1; ++y) {
+        for(int x = -1; x <= 1; ++x) {
+            const ivec2 coord = clamp(center + ivec2(x, y), ivec2(0), ivec2(render_size) - 1);
+            const vec3 color = compress(texelFetch(in_color, coord, 0).rgb);
+
+            // Gaussian fit of a Blackman-Harris window, reconstructs the output pixel from the jittered samples
+            const vec2 offset = vec2(coord) + 0.5 - temporal.jitter - pos;
+            const float weight = exp(-2.29 * dot(offset, offset));
+            current += color * weight;
+            total_weight += weight;
+
+            moment1 += color;
+            moment2 += color * color;
+
+            // Reverse-Z: the closest surface has the largest depth
+            const float depth = texelFetch(in_depth, coord, 0).r;
+            if(depth > closest_depth) {
+                closest_depth = depth;
+                closest = coord;
+            }
+        }
+    }
+    current /= total_weight;
+
+    // Dilated motion: use the closest surface so that edges of moving objects aren't left behind
+    vec2 history_uv;
+    if(closest_depth > 0.0) {
+        history_uv = in_uv - texelFetch(in_motion, closest, 0).xy;
+    } else {
+        // Sky, only moves with the camera
+        const vec4 previous = temporal.reprojection * vec4(in_uv * 2.0 - 1.0, 0.0, 1.0);
+        history_uv = previous.xy / previous.w * 0.5 + 0.5;
+    }
+
+    float alpha = blend_factor;
+    vec3 history = current;
+    if(any(lessThan(history_uv, vec2(0.0))) || any(greaterThan(history_uv, vec2(1.0)))) {
+        alpha = 1.0;
+    } else {
+        const vec3 sampled = sharp_history != 0
+            ? sample_catmull_rom(history_uv)
+            : textureLod(in_history, history_uv, 0.0).rgb;
+        history = compress(sampled);
+    }
+
+    // Variance clipping: reject history that doesn't match the current neighborhood
+    const vec3 mean = moment1 / 9.0;
+    const vec3 sigma = sqrt(max(moment2 / 9.0 - mean * mean, vec3(0.0)));
+    const vec3 box_min = mean - 1.25 * sigma;
+    const vec3 box_max = mean + 1.25 * sigma;
+    history = clamp(history, box_min, box_max);
+
+    out_color = vec4(uncompress(mix(history, current, alpha)), 1.0);
+}
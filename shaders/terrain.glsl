@@ -0,0 +1,151 @@
+// Terrain clipmap sampling (see Terrain.h)
+
+// Heights, stored normalized: height = value * scale + bias
+layout(binding = 0) uniform sampler2DArray u_clipmap;
+// Normal (encoded in [0, 1]) in rgb, slope (1 - normal.y) in a
+layout(binding = 1) uniform sampler2DArray u_normal_clipmap;
+// Weights of the material layers
+layout(binding = 2) uniform sampler2DArray u_splat_clipmap;
+// One layer per material: albedo and roughness, normal (xy), AO and metalness
+layout(binding = 3) uniform sampler2DArray u_material_albedo;
+layout(binding = 4) uniform sampler2DArray u_material_normal;
+// Min/max pyramid of the heights, stored normalized
+layout(binding = 5) uniform sampler2DArray u_height_bounds;
+
+// xy = world position of the first texel of the window of each level, z = texel size
+uniform vec4 u_clipmap_levels[MAX_CLIPMAP_LEVELS];
+uniform uint u_clipmap_level_count;
+uniform uint u_clipmap_resolution;
+uniform vec2 u_height_scale_bias;
+// x = mip of the min/max pyramid, y = 1 / (texels per block * reference slope), z = min LOD scale
+uniform vec3 u_lod_scale_params;
+
+// Region of the window of a level, in [0, 1] from its center to its border
+float clipmap_level_distance(uint level, vec2 world_xz) {
+    const vec4 window = u_clipmap_levels[level];
+    const float half_extent = 0.5 * float(u_clipmap_resolution) * window.z;
+    const vec2 offset = abs(world_xz - (window.xy + half_extent)) / half_extent;
+    return max(offset.x, offset.y);
+}
+
+vec3 clipmap_uv(uint level, vec2 world_xz) {
+    // Texels are stored at world_texel % resolution, which repeat wrapping does for us
+    const vec2 uv = (world_xz / u_clipmap_levels[level].z + 0.5) / float(u_clipmap_resolution);
+    return vec3(uv, float(level));
+}
+
+// Finest level covering the position, and how much to blend it with the next one near its border
+uint clipmap_level(vec2 world_xz, out float blend) {
+    const uint last_level = u_clipmap_level_count - 1;
+    uint level = 0;
+    float dist = clipmap_level_distance(0, world_xz);
+    while (level < last_level && dist > 0.95) {
+        ++level;
+        dist = clipmap_level_distance(level, world_xz);
+    }
+    blend = level == last_level ? 0.0 : smoothstep(0.8, 0.95, dist);
+    return level;
+}
+
+float sample_height(vec2 world_xz) {
+    float blend = 0.0;
+    const uint level = clipmap_level(world_xz, blend);
+
+    float value = textureLod(u_clipmap, clipmap_uv(level, world_xz), 0.0).r;
+    if (blend > 0.0) {
+        value = mix(value, textureLod(u_clipmap, clipmap_uv(level + 1, world_xz), 0.0).r, blend);
+    }
+    return value * u_height_scale_bias.x + u_height_scale_bias.y;
+}
+
+vec4 sample_clipmap(sampler2DArray clipmap, vec2 world_xz) {
+    float blend = 0.0;
+    const uint level = clipmap_level(world_xz, blend);
+
+    vec4 value = textureLod(clipmap, clipmap_uv(level, world_xz), 0.0);
+    if (blend > 0.0) {
+        value = mix(value, textureLod(clipmap, clipmap_uv(level + 1, world_xz), 0.0), blend);
+    }
+    return value;
+}
+
+// Normal in xyz, slope in w
+vec4 sample_normal_slope(vec2 world_xz) {
+    const vec4 value = sample_clipmap(u_normal_clipmap, world_xz);
+    return vec4(normalize(value.xyz * 2.0 - 1.0), value.w);
+}
+
+vec4 sample_splat(vec2 world_xz) {
+    return sample_clipmap(u_splat_clipmap, world_xz);
+}
+
+// World uvs of the material textures
+const float material_uv_scale = 0.8;
+
+struct TerrainSurface {
+    vec3 albedo; // Darkened by the ambient occlusion of the materials, the G-buffer has no occlusion channel
+    float roughness;
+    vec3 normal;
+    float metalness;
+};
+
+// Material layers blended by the splat map over the clipmap normal. uv_dx and uv_dy are the derivatives of the
+// material uvs (world_xz * material_uv_scale)
+TerrainSurface terrain_surface(vec2 world_xz, vec2 uv_dx, vec2 uv_dy) {
+    const vec2 uv = world_xz * material_uv_scale;
+    const vec4 normal_slope = sample_normal_slope(world_xz);
+    const vec4 weights = sample_splat(world_xz);
+
+    // Only the two heaviest layers are blended: four material fetches whatever the weights
+    uint first = 0;
+    for (uint i = 1; i != 4; ++i) {
+        if (weights[i] > weights[first]) {
+            first = i;
+        }
+    }
+    uint second = first == 0 ? 1 : 0;
+    for (uint i = 0; i != 4; ++i) {
+        if (i != first && weights[i] > weights[second]) {
+            second = i;
+        }
+    }
+    const float t = weights[second] / max(weights[first] + weights[second], 1e-4);
+
+    const vec4 albedo_roughness = mix(textureGrad(u_material_albedo, vec3(uv, float(first)), uv_dx, uv_dy),
+                                      textureGrad(u_material_albedo, vec3(uv, float(second)), uv_dx, uv_dy), t);
+    const vec4 normal_ao_metal = mix(textureGrad(u_material_normal, vec3(uv, float(first)), uv_dx, uv_dy),
+                                     textureGrad(u_material_normal, vec3(uv, float(second)), uv_dx, uv_dy), t);
+
+    // Material normals are in the tangent space of the world aligned uvs
+    const vec3 normal = normal_slope.xyz;
+    const vec3 tangent = normalize(vec3(1.0, 0.0, 0.0) - normal * normal.x);
+    const vec3 bitangent = cross(tangent, normal);
+    const vec2 detail_xy = normal_ao_metal.xy * 2.0 - 1.0;
+    const vec3 detail = vec3(detail_xy, sqrt(saturate(1.0 - dot(detail_xy, detail_xy))));
+
+    TerrainSurface surface;
+    surface.albedo = albedo_roughness.rgb * normal_ao_metal.z;
+    surface.roughness = albedo_roughness.a;
+    surface.normal = normalize(tangent * detail.x + bitangent * detail.y + normal * detail.z);
+    surface.metalness = normal_ao_metal.w;
+    return surface;
+}
+
+// Scale of the LOD ranges, from the height range of the filtered blocks of the min/max pyramid relative to the size of
+// the blocks. Must match Terrain::node_bounds()
+float level_lod_scale(uint level, vec2 world_xz) {
+    const vec2 bounds = textureLod(u_height_bounds, clipmap_uv(level, world_xz), u_lod_scale_params.x).rg;
+    const float slope = (bounds.y - bounds.x) * u_height_scale_bias.x / u_clipmap_levels[level].z;
+    return clamp(slope * u_lod_scale_params.y, u_lod_scale_params.z, 1.0);
+}
+
+float lod_scale(vec2 world_xz) {
+    float blend = 0.0;
+    const uint level = clipmap_level(world_xz, blend);
+
+    float scale = level_lod_scale(level, world_xz);
+    if (blend > 0.0) {
+        scale = mix(scale, level_lod_scale(level + 1, world_xz), blend);
+    }
+    return scale;
+}
@@ -1,17 +1,54 @@
 #version 450
 
-layout(location = 0) in vec3 in_position;
-layout(location = 1) in vec3 in_normal;
-layout(location = 2) in vec2 in_uv;
+#include "utils.glsl"
+#include "terrain.glsl"
+
+// CDLOD patch vertex, see Terrain.h. There are no vertex attributes: the grid is generated from gl_VertexID.
+
+layout(std430, binding = 14) readonly buffer TerrainNodes {
+    TerrainNode terrain_nodes[];
+};
+
+uniform mat4 u_view_proj;
+// LODs follow the camera, even when rendering another view
+uniform vec3 u_lod_camera_pos;
+
+uniform uint u_node_offset;
+// Quads per side of the patches of this draw
+uniform uint u_grid_size;
+// Distance range over which each LOD morphs into the next one (x = start, y = end)
+uniform vec4 u_morph_ranges[MAX_TERRAIN_LODS];
 
 out vec3 v_position;
-out vec2 v_uv;
+
+// The depth and G-buffer programs both compile this shader and must produce the same depths
+invariant gl_Position;
+
+// Two counter-clockwise triangles seen from above
+const uvec2 quad_corners[6] = {
+    uvec2(0, 0), uvec2(0, 1), uvec2(1, 0),
+    uvec2(1, 0), uvec2(0, 1), uvec2(1, 1),
+};
 
 void main() {
-    v_position = in_position;
-    v_uv = in_uv;
-    
-    // Pass position through for tessellation stages
-    // TCS reads gl_in[].gl_Position
-    gl_Position = vec4(in_position, 1.0);
+    const TerrainNode node = terrain_nodes[u_node_offset + gl_InstanceID];
+
+    const uint quad = uint(gl_VertexID) / 6;
+    const vec2 grid = vec2(uvec2(quad % u_grid_size, quad / u_grid_size) + quad_corners[uint(gl_VertexID) % 6]);
+    const float quad_size = node.size / float(u_grid_size);
+
+    // Odd vertices slide onto the grid of the next LOD as the distance gets close to the end of the LOD range.
+    // Flat terrain scales the ranges down, which is the same as scaling the distance up.
+    const vec2 grid_xz = node.origin + grid * quad_size;
+    const vec3 grid_pos = vec3(grid_xz.x, sample_height(grid_xz), grid_xz.y);
+    const float dist = distance(u_lod_camera_pos, grid_pos) / lod_scale(grid_xz);
+    const vec2 morph_range = u_morph_ranges[node.lod].xy;
+    const float morph = saturate((dist - morph_range.x) / (morph_range.y - morph_range.x));
+    const vec2 xz = node.origin + (grid - mod(grid, 2.0) * morph) * quad_size;
+
+    const vec3 world_pos = vec3(xz.x, sample_height(xz), xz.y);
+    // Normals are fetched per pixel
+    v_position = world_pos;
+
+    gl_Position = u_view_proj * vec4(world_pos, 1.0);
 }
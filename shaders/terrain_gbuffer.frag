@@ -1,47 +1,39 @@
 #version 450
 
-in vec3 te_position;
-in vec3 te_normal;
-in vec2 te_uv;
+#include "utils.glsl"
+#include "motion.glsl"
+#include "terrain.glsl"
+#include "terrain_rvt.glsl"
 
-// Terrain material textures
-uniform sampler2D u_grass_albedo;
-uniform sampler2D u_forest_albedo;
-uniform sampler2D u_rocks_albedo;
-uniform sampler2D u_snow_albedo;
+// Occluded fragments must not request pages
+layout(early_fragment_tests) in;
+
+in vec3 v_position;
 
 layout(location = 0) out vec4 out_albedo;
 layout(location = 1) out vec4 out_normal_metal;
+layout(location = 2) out vec2 out_motion;
 
 void main() {
+    // Taken before the branches, which don't have derivatives
+    const vec2 world_dx = dFdx(v_position.xz);
+    const vec2 world_dy = dFdy(v_position.xz);
 
-    vec3 out_color;
-    vec2 uv = te_position.xz * 0.8;
-    float h = te_position.y;
-    // vec3 normal = normalize(out_normal);
-    if (h > 34.0) {
-        out_color = texture(u_snow_albedo, uv).xyz;
-        // normal = texture(snow_nm_text, uv).xyz;
-    }
-    else if (h > 25.0) {
-        float t = (h - 25.0) / 9.0;
-        out_color = mix(texture(u_rocks_albedo, uv).xyz, texture(u_snow_albedo, uv).xyz, t);
-        // normal = mix(texture(rock_nm_text, uv).xyz, texture(snow_nm_text, uv).xyz, t);
-    }
-    else if (h > 13.0) {
-        float t = (h - 13.0) / 12.0;
-        out_color = mix(texture(u_forest_albedo, uv).xyz, texture(u_rocks_albedo, uv).xyz, t);
-        // normal = mix(texture(forest_nm_text, uv).xyz, texture(rock_nm_text, uv).xyz, t);
+    // One lookup into the virtual texture, the materials are only blended where no page is baked yet
+    TerrainSurface surface;
+    bool baked = false;
+    if (u_rvt_enabled != 0) {
+        const uint mip = rvt_mip(world_dx, world_dy);
+        if (all(equal(uvec2(gl_FragCoord.xy) % 4u, u_rvt_feedback_pixel))) {
+            request_rvt_page(mip, v_position.xz);
+        }
+        baked = sample_rvt(v_position.xz, mip, surface);
     }
-    else if (h > 8.0) {
-        float t = (h - 8.0) / 5.0;
-        out_color = mix(texture(u_grass_albedo, uv).xyz, texture(u_forest_albedo, uv).xyz, t);
-        // normal = mix(texture(grass_nm_text, uv).xyz, texture(forest_nm_text, uv).xyz, t);
+    if (!baked) {
+        surface = terrain_surface(v_position.xz, world_dx * material_uv_scale, world_dy * material_uv_scale);
     }
-    else {
-        out_color = texture(u_grass_albedo, uv).xyz;
-    }
-    
-    out_albedo = vec4(out_color, 1.0); // Roughness in alpha (1.0 = rough)
-    out_normal_metal = vec4(normalize(te_normal) * 0.5 + 0.5, 0.0); // Metal in alpha
+
+    out_albedo = vec4(surface.albedo, surface.roughness); // Roughness in alpha
+    out_normal_metal = vec4(surface.normal * 0.5 + 0.5, surface.metalness); // Metal in alpha
+    out_motion = motion_vector(v_position);
 }
@@ -0,0 +1,82 @@
+// Runtime virtual texture of the terrain surface (see TerrainVirtualTexture.h), expects terrain.glsl
+
+// Baked pages, one per layer: albedo (sRGB encoded) and roughness, normal (encoded in [0, 1]) and metalness
+layout(binding = 6) uniform sampler2DArray u_rvt_albedo;
+layout(binding = 7) uniform sampler2DArray u_rvt_normal;
+// Layer + 1 of the baked page of each entry of the window of each mip (one per layer), 0 when it isn't baked
+layout(binding = 8) uniform usampler2DArray u_rvt_indirection;
+
+// Pages requested by the pixels, each page is only added once
+layout(std430, binding = 15) buffer TerrainFeedback {
+    uint u_rvt_request_count;
+    uint u_rvt_requested[RVT_MIP_COUNT * RVT_WINDOW_PAGES * RVT_WINDOW_PAGES / 32];
+    ivec4 u_rvt_requests[]; // Mip and page in xyz
+};
+
+// xy = first page of the window of each mip, z = world size of its pages
+uniform vec4 u_rvt_windows[RVT_MIP_COUNT];
+uniform uint u_rvt_enabled;
+// Pixel of every 4x4 block that requests pages this frame
+uniform uvec2 u_rvt_feedback_pixel;
+
+bool in_rvt_window(uint mip, ivec2 page) {
+    const ivec2 first = ivec2(u_rvt_windows[mip].xy);
+    return all(greaterThanEqual(page, first)) && all(lessThan(page, first + RVT_WINDOW_PAGES));
+}
+
+// Entries are stored at page modulo RVT_WINDOW_PAGES (a power of two), like the clipmap texels
+ivec3 rvt_indirection_coord(uint mip, ivec2 page) {
+    return ivec3(page & (RVT_WINDOW_PAGES - 1), mip);
+}
+
+// Mip with the largest texels that are at most as large as the footprint of the pixel
+uint rvt_mip(vec2 world_dx, vec2 world_dy) {
+    const float footprint = max(length(world_dx), length(world_dy)) * float(RVT_PAGE_SIZE) / u_rvt_windows[0].z;
+    return uint(clamp(floor(log2(max(footprint, 1.0))), 0.0, float(RVT_MIP_COUNT - 1)));
+}
+
+void request_rvt_page(uint mip, vec2 world_xz) {
+    const ivec2 page = ivec2(floor(world_xz / u_rvt_windows[mip].z));
+    if (!in_rvt_window(mip, page)) {
+        return;
+    }
+
+    const ivec3 coord = rvt_indirection_coord(mip, page);
+    const uint bit = (coord.z * RVT_WINDOW_PAGES + coord.y) * RVT_WINDOW_PAGES + coord.x;
+    const uint mask = 1u << (bit % 32u);
+    if ((atomicOr(u_rvt_requested[bit / 32u], mask) & mask) == 0) {
+        const uint index = atomicAdd(u_rvt_request_count, 1);
+        if (index < RVT_MAX_REQUESTS) {
+            u_rvt_requests[index] = ivec4(mip, page, 0);
+        }
+    }
+}
+
+// Surface from the finest baked page at or above a mip, false when none is baked
+bool sample_rvt(vec2 world_xz, uint mip, out TerrainSurface surface) {
+    for (; mip < RVT_MIP_COUNT; ++mip) {
+        const vec2 page_coord = world_xz / u_rvt_windows[mip].z;
+        const ivec2 page = ivec2(floor(page_coord));
+        if (!in_rvt_window(mip, page)) {
+            continue;
+        }
+        const uint entry = texelFetch(u_rvt_indirection, rvt_indirection_coord(mip, page), 0).r;
+        if (entry == 0) {
+            continue;
+        }
+
+        // Pages never filter past their border
+        const float physical_size = float(RVT_PAGE_SIZE + 2 * RVT_PAGE_BORDER);
+        const vec2 texel = (page_coord - vec2(page)) * float(RVT_PAGE_SIZE) + float(RVT_PAGE_BORDER);
+        const vec3 uv = vec3(texel / physical_size, float(entry - 1));
+        const vec4 albedo_roughness = textureLod(u_rvt_albedo, uv, 0.0);
+        const vec4 normal_metal = textureLod(u_rvt_normal, uv, 0.0);
+
+        surface.albedo = sRGB_to_linear(albedo_roughness.rgb);
+        surface.roughness = albedo_roughness.a;
+        surface.normal = normalize(normal_metal.xyz * 2.0 - 1.0);
+        surface.metalness = normal_metal.w;
+        return true;
+    }
+    return false;
+}
@@ -0,0 +1,20 @@
+// Tile classification for the compute scene shading (see TiledShading.h)
+
+#define SHADING_TILE_SIZE 16
+
+#define TILE_CLASS_SKY 0
+#define TILE_CLASS_TERRAIN 1
+#define TILE_CLASS_GENERIC 2
+
+// Indirect dispatch arguments (x, y, z) of each class, tightly packed
+layout(std430, binding = 10) buffer TileDispatches {
+    uint tile_dispatches[];
+};
+
+// Tiles of each class (x | y << 16), max_tiles per class
+layout(std430, binding = 11) buffer TileLists {
+    uint tile_lists[];
+};
+
+// Part of the G-buffer that was rendered
+uniform uvec2 render_size;
@@ -0,0 +1,26 @@
+#version 450 core
+
+#include "structs.glsl"
+
+layout(location = 0) out uint out_visibility;
+
+#ifdef ALPHA_TEST
+layout(location = 0) in vec2 in_uv;
+
+layout(binding = 0) uniform sampler2D in_texture;
+
+uniform float alpha_cutoff;
+#endif
+
+// Index of the instance in the visible instances
+layout(location = 1) flat in uint in_draw_id;
+
+void main() {
+#ifdef ALPHA_TEST
+    if(texture(in_texture, in_uv).a <= alpha_cutoff) {
+        discard;
+    }
+#endif
+
+    out_visibility = ((in_draw_id + 1) << VISIBILITY_TRIANGLE_BITS) | uint(gl_PrimitiveID);
+}
@@ -0,0 +1,141 @@
+#version 450
+
+#extension GL_ARB_bindless_texture : require
+
+// Fills the G-buffer from the visibility buffer: fetches the visible triangle of each pixel, interpolates its
+// attributes and evaluates its material, like gbuffer.frag does for rasterized triangles.
+
+#include "utils.glsl"
+#include "motion.glsl"
+
+layout(location = 0) out vec4 out_albedo_roughness;
+layout(location = 1) out vec4 out_normal_metal;
+layout(location = 2) out vec2 out_motion;
+
+layout(location = 0) in vec2 in_uv;
+
+layout(binding = 0) uniform usampler2D in_visibility;
+
+layout(binding = 0) uniform Data {
+    FrameData frame;
+};
+
+layout(std430, binding = 2) readonly buffer Instances {
+    mat4 instance_transforms[];
+};
+
+layout(std430, binding = 6) readonly buffer InstanceBatches {
+    uint instance_batches[];
+};
+
+layout(std430, binding = 7) readonly buffer Batches {
+    VisibilityBatch batches[];
+};
+
+layout(std430, binding = 8) readonly buffer Vertices {
+    float vertex_data[];
+};
+
+layout(std430, binding = 9) readonly buffer Indices {
+    uint indices[];
+};
+
+// Must match Vertex.h
+const uint vertex_stride = 15;
+
+struct VertexAttributes {
+    vec3 position;
+    vec3 normal;
+    vec2 uv;
+    vec4 tangent_bitangent_sign;
+    vec3 color;
+};
+
+VertexAttributes fetch_vertex(uint index) {
+    const uint base = index * vertex_stride;
+    VertexAttributes v;
+    v.position = vec3(vertex_data[base + 0], vertex_data[base + 1], vertex_data[base + 2]);
+    v.normal = vec3(vertex_data[base + 3], vertex_data[base + 4], vertex_data[base + 5]);
+    v.uv = vec2(vertex_data[base + 6], vertex_data[base + 7]);
+    v.tangent_bitangent_sign = vec4(vertex_data[base + 8], vertex_data[base + 9],
+                                    vertex_data[base + 10], vertex_data[base + 11]);
+    v.color = vec3(vertex_data[base + 12], vertex_data[base + 13], vertex_data[base + 14]);
+    return v;
+}
+
+// Barycentrics of the intersection between the camera ray through uv and a triangle (Moller-Trumbore)
+vec3 barycentrics(vec2 uv, vec3 p0, vec3 p1, vec3 p2) {
+    const vec3 origin = frame.camera.position;
+    const vec3 dir = unproject(uv, 1.0, frame.camera.inv_view_proj) - origin;
+
+    const vec3 e1 = p1 - p0;
+    const vec3 e2 = p2 - p0;
+    const vec3 pv = cross(dir, e2);
+    const float inv_det = 1.0 / dot(e1, pv);
+
+    const vec3 tv = origin - p0;
+    const float u = dot(tv, pv) * inv_det;
+    const float v = dot(dir, cross(tv, e1)) * inv_det;
+    return vec3(1.0 - u - v, u, v);
+}
+
+void main() {
+    // Screen space derivatives have to be taken before any non uniform control flow
+    const vec2 uv_dx = dFdx(in_uv);
+    const vec2 uv_dy = dFdy(in_uv);
+
+    const uint visibility = texelFetch(in_visibility, ivec2(gl_FragCoord.xy), 0).r;
+    if(visibility == 0) {
+        discard;
+    }
+
+    const uint draw_id = (visibility >> VISIBILITY_TRIANGLE_BITS) - 1;
+    const uint triangle_id = visibility & ((1u << VISIBILITY_TRIANGLE_BITS) - 1);
+
+    const mat4 model = instance_transforms[draw_id];
+    const VisibilityBatch batch = batches[instance_batches[draw_id]];
+
+    const uint first = batch.first_index + triangle_id * 3;
+    const VertexAttributes v0 = fetch_vertex(batch.first_vertex + indices[first + 0]);
+    const VertexAttributes v1 = fetch_vertex(batch.first_vertex + indices[first + 1]);
+    const VertexAttributes v2 = fetch_vertex(batch.first_vertex + indices[first + 2]);
+
+    const vec3 p0 = (model * vec4(v0.position, 1.0)).xyz;
+    const vec3 p1 = (model * vec4(v1.position, 1.0)).xyz;
+    const vec3 p2 = (model * vec4(v2.position, 1.0)).xyz;
+
+    const vec3 b = barycentrics(in_uv, p0, p1, p2);
+    // Barycentrics of the neighbouring pixels give the texture coordinate gradients
+    const vec3 b_dx = barycentrics(in_uv + uv_dx, p0, p1, p2);
+    const vec3 b_dy = barycentrics(in_uv + uv_dy, p0, p1, p2);
+
+    const vec3 position = p0 * b.x + p1 * b.y + p2 * b.z;
+    const vec2 uv = v0.uv * b.x + v1.uv * b.y + v2.uv * b.z;
+    const vec2 tex_dx = v0.uv * b_dx.x + v1.uv * b_dx.y + v2.uv * b_dx.z - uv;
+    const vec2 tex_dy = v0.uv * b_dy.x + v1.uv * b_dy.y + v2.uv * b_dy.z - uv;
+    const vec3 color = v0.color * b.x + v1.color * b.y + v2.color * b.z;
+
+    const mat3 normal_matrix = mat3(model);
+    const vec3 vertex_normal = normalize(normal_matrix * (v0.normal * b.x + v1.normal * b.y + v2.normal * b.z));
+    const vec3 tangent = normalize(normal_matrix * (v0.tangent_bitangent_sign.xyz * b.x +
+                                                    v1.tangent_bitangent_sign.xyz * b.y +
+                                                    v2.tangent_bitangent_sign.xyz * b.z));
+    const vec3 bitangent = cross(tangent, vertex_normal) * (v0.tangent_bitangent_sign.w > 0.0 ? 1.0 : -1.0);
+
+    sampler2D albedo_texture = sampler2D(batch.albedo_texture);
+    sampler2D normal_texture = sampler2D(batch.normal_texture);
+    sampler2D metal_rough_texture = sampler2D(batch.metal_rough_texture);
+
+    const vec3 normal_map = unpack_normal_map(textureGrad(normal_texture, uv, tex_dx, tex_dy).xy);
+    const vec3 normal = normal_map.x * tangent + normal_map.y * bitangent + normal_map.z * vertex_normal;
+
+    const vec3 base_color = color * textureGrad(albedo_texture, uv, tex_dx, tex_dy).rgb * batch.base_color_factor;
+
+    const vec4 metal_rough_tex = textureGrad(metal_rough_texture, uv, tex_dx, tex_dy);
+    const float roughness = metal_rough_tex.g * batch.metal_rough_factor.y;
+    const float metallic = metal_rough_tex.b * batch.metal_rough_factor.x;
+
+    out_albedo_roughness = vec4(base_color, roughness);
+    out_normal_metal = vec4(normalize(normal) * 0.5 + 0.5, metallic);
+    out_motion = motion_vector(position);
+}
@@ -0,0 +1,84 @@
+#include "AutoExposure.h"
+
+#include <glad/gl.h>
+
+#include <vector>
+
+namespace OM3D
+{
+
+    static constexpr u32 histogram_group_size = 16;
+
+    // Luminances covered by the histogram, in log2
+    static constexpr float min_log_luminance = -10.0f;
+    static constexpr float max_log_luminance = 12.0f;
+
+    AutoExposure::AutoExposure() :
+        _histogram_program(Program::from_file("luminance_histogram.comp")),
+        _adapt_program(Program::from_file("exposure_adapt.comp"))
+    {
+        // The adaptation pass clears the bins after reading them
+        const std::vector<u32> empty_histogram(histogram_bins, 0);
+        _histogram_buffer = std::make_unique<TypedBuffer<u32>>(empty_histogram.data(), histogram_bins);
+
+        const shader::ExposureData initial_data = {1.0f, 0.0f, 0.0f, 0.0f};
+        _exposure_buffer = std::make_unique<TypedBuffer<shader::ExposureData>>(&initial_data, 1);
+    }
+
+    void AutoExposure::set_enabled(bool enabled)
+    {
+        if (enabled != _enabled)
+        {
+            _enabled = enabled;
+            // Don't adapt from a stale exposure
+            _reset = true;
+        }
+    }
+
+    void AutoExposure::set_percentiles(float low, float high)
+    {
+        DEBUG_ASSERT(low >= 0.0f && low < high && high <= 1.0f);
+        _low_percentile = low;
+        _high_percentile = high;
+    }
+
+    void AutoExposure::set_speeds(float up, float down)
+    {
+        DEBUG_ASSERT(up > 0.0f && down > 0.0f);
+        _speed_up = up;
+        _speed_down = down;
+    }
+
+    void AutoExposure::update(const Texture& hdr, glm::uvec2 size, float delta_time)
+    {
+        hdr.bind(0);
+        _histogram_buffer->bind(BufferUsage::Storage, 12);
+        _exposure_buffer->bind(BufferUsage::Storage, 13);
+
+        _histogram_program->bind();
+        _histogram_program->set_uniform(HASH("render_size"), size);
+        _histogram_program->set_uniform(HASH("min_log_luminance"), min_log_luminance);
+        _histogram_program->set_uniform(HASH("log_luminance_range"), max_log_luminance - min_log_luminance);
+        glDispatchCompute(align_up_to(size.x, histogram_group_size) / histogram_group_size,
+                          align_up_to(size.y, histogram_group_size) / histogram_group_size, 1);
+
+        glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT);
+
+        _adapt_program->bind();
+        _adapt_program->set_uniform(HASH("min_log_luminance"), min_log_luminance);
+        _adapt_program->set_uniform(HASH("log_luminance_range"), max_log_luminance - min_log_luminance);
+        _adapt_program->set_uniform(HASH("low_percentile"), _low_percentile);
+        _adapt_program->set_uniform(HASH("high_percentile"), _high_percentile);
+        _adapt_program->set_uniform(HASH("compensation"), _compensation);
+        _adapt_program->set_uniform(HASH("speed_up"), _speed_up);
+        _adapt_program->set_uniform(HASH("speed_down"), _speed_down);
+        _adapt_program->set_uniform(HASH("delta_time"), delta_time);
+        _adapt_program->set_uniform(HASH("reset"), u32(_reset));
+        glDispatchCompute(1, 1, 1);
+
+        _reset = false;
+    }
+
+    void AutoExposure::bind() const { _exposure_buffer->bind(BufferUsage::Storage, 13); }
+
+} // namespace OM3D
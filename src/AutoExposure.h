@@ -0,0 +1,70 @@
+#ifndef AUTOEXPOSURE_H
+#define AUTOEXPOSURE_H
+
+#include <Program.h>
+#include <Texture.h>
+#include <TypedBuffer.h>
+#include <shader_structs.h>
+
+#include <memory>
+
+namespace OM3D
+{
+
+    // Automatic exposure computed entirely on the GPU.
+    // A log-luminance histogram of the HDR image is built with shared memory atomics, its average is taken over the
+    // bins between two percentiles (so that a few very dark or very bright pixels don't drive the exposure) and the
+    // exposure stored in a storage buffer slowly adapts towards it. The tonemap reads that buffer directly: nothing
+    // is ever read back on the CPU.
+    class AutoExposure : NonMovable
+    {
+    public:
+        // Must match exposure.glsl
+        static constexpr u32 histogram_bins = 256;
+
+        AutoExposure();
+
+        // Adapt the exposure to the top left size texels of hdr
+        void update(const Texture& hdr, glm::uvec2 size, float delta_time);
+
+        // Bind the exposure data storage buffer
+        void bind() const;
+
+        ByteBuffer& exposure_buffer() { return *_exposure_buffer; }
+
+        bool enabled() const { return _enabled; }
+        void set_enabled(bool enabled);
+
+        // Exposure compensation, in stops
+        float compensation() const { return _compensation; }
+        void set_compensation(float ev) { _compensation = ev; }
+
+        // Fraction of the darkest and brightest pixels ignored by the average
+        float low_percentile() const { return _low_percentile; }
+        float high_percentile() const { return _high_percentile; }
+        void set_percentiles(float low, float high);
+
+        // Speed at which the exposure adapts to brighter and darker scenes, in stops per second (roughly)
+        float speed_up() const { return _speed_up; }
+        float speed_down() const { return _speed_down; }
+        void set_speeds(float up, float down);
+
+    private:
+        std::shared_ptr<Program> _histogram_program;
+        std::shared_ptr<Program> _adapt_program;
+
+        std::unique_ptr<TypedBuffer<u32>> _histogram_buffer;
+        std::unique_ptr<TypedBuffer<shader::ExposureData>> _exposure_buffer;
+        bool _reset = true;
+
+        bool _enabled = true;
+        float _compensation = 0.0f;
+        float _low_percentile = 0.5f;
+        float _high_percentile = 0.95f;
+        float _speed_up = 3.0f;
+        float _speed_down = 1.0f;
+    };
+
+} // namespace OM3D
+
+#endif // AUTOEXPOSURE_H
@@ -39,6 +39,14 @@ namespace OM3D
 
     size_t ByteBuffer::byte_size() const { return _size; }
 
+    void ByteBuffer::clear() { glClearNamedBufferData(_handle.get(), GL_R8UI, GL_RED_INTEGER, GL_UNSIGNED_BYTE, nullptr); }
+
+    void ByteBuffer::copy_from(const ByteBuffer& source, size_t offset)
+    {
+        DEBUG_ASSERT(offset + source._size <= _size);
+        glCopyNamedBufferSubData(source._handle.get(), _handle.get(), 0, offset, source._size);
+    }
+
     BufferMapping<byte> ByteBuffer::map_bytes(AccessType access)
     {
         return BufferMapping<byte>(map_internal(access), byte_size(), handle());
@@ -47,6 +55,10 @@ namespace OM3D
     void* ByteBuffer::map_internal(AccessType access)
     {
         DEBUG_ASSERT(_handle.is_valid() && _size);
+        if (access == AccessType::WriteDiscard)
+        {
+            return glMapNamedBufferRange(_handle.get(), 0, _size, GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_BUFFER_BIT);
+        }
         return glMapNamedBuffer(_handle.get(), access_type_to_gl(access));
     }
 
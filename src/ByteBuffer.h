@@ -23,6 +23,12 @@ namespace OM3D
 
         size_t byte_size() const;
 
+        // Fill the whole buffer with zeros on the GPU
+        void clear();
+
+        // Copy the whole content of another buffer at an offset, on the GPU
+        void copy_from(const ByteBuffer& source, size_t offset);
+
         BufferMapping<byte> map_bytes(AccessType access = AccessType::ReadWrite);
 
     protected:
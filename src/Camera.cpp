@@ -62,6 +62,25 @@ namespace OM3D
         return reverse_z * glm::orthoZO<float>(left, right, bottom, top, z_near, z_far);
     }
 
+    std::array<glm::vec4, 6> Camera::frustum_planes(const glm::mat4& view_proj)
+    {
+        auto row = [&](u32 i) { return glm::vec4(view_proj[0][i], view_proj[1][i], view_proj[2][i], view_proj[3][i]); };
+
+        // Depth is in [0; 1] (see glClipControl)
+        std::array<glm::vec4, 6> planes = {
+                row(3) + row(0), row(3) - row(0), row(3) + row(1), row(3) - row(1), row(2), row(3) - row(2),
+        };
+
+        for (glm::vec4& plane: planes)
+        {
+            const float len = glm::length(glm::vec3(plane));
+            // Planes at infinity (far plane of infinite projections) never cull anything
+            plane = len > 0.0f ? plane / len : glm::vec4(0.0f, 0.0f, 0.0f, 1.0f);
+        }
+
+        return planes;
+    }
+
     Camera::Camera()
     {
         _projection = perspective(to_rad(60.0f), 16.0f / 9.0f, 0.001f);
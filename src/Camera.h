@@ -5,6 +5,8 @@
 
 #include <utils.h>
 
+#include <array>
+
 namespace OM3D
 {
 
@@ -25,6 +27,9 @@ namespace OM3D
         static glm::mat4 perspective(float fov_y, float ratio, float z_near);
         static glm::mat4 orthographic(float left, float right, float bottom, float top, float z_near, float z_far);
 
+        // Planes bounding the clip volume of a view-projection matrix, normals point inward (xyz: normal, w: distance)
+        static std::array<glm::vec4, 6> frustum_planes(const glm::mat4& view_proj);
+
         Camera();
 
         void set_view(const glm::mat4& matrix);
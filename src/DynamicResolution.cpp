@@ -0,0 +1,82 @@
+#include "DynamicResolution.h"
+
+#include <glm/common.hpp>
+
+#include <algorithm>
+#include <cmath>
+
+namespace OM3D
+{
+
+    // Frames to wait after a change, the profiler reports GPU times a few frames late
+    static constexpr u32 settle_frames = 8;
+
+    // The scale only goes up when the frame takes less than this fraction of the budget
+    static constexpr float increase_threshold = 0.85f;
+
+    // Largest increase of the scale per change, decreases are not limited so that spikes are absorbed quickly
+    static constexpr float max_increase = 0.05f;
+
+    // Smaller changes are ignored
+    static constexpr float min_change = 0.01f;
+
+    void DynamicResolution::update(float gpu_frame_time)
+    {
+        if (!_enabled || gpu_frame_time <= 0.0f)
+        {
+            return;
+        }
+
+        if (++_frames_since_change < settle_frames)
+        {
+            return;
+        }
+
+        // GPU time is roughly proportional to the number of pixels, so to the square of the scale
+        float target = _scale;
+        if (gpu_frame_time > _budget)
+        {
+            target = _scale * std::sqrt(_budget / gpu_frame_time);
+        }
+        else if (gpu_frame_time < _budget * increase_threshold)
+        {
+            // Aim for the middle of the hysteresis band
+            const float aim = _budget * (1.0f + increase_threshold) * 0.5f;
+            target = std::min(_scale * std::sqrt(aim / gpu_frame_time), _scale + max_increase);
+        }
+
+        target = std::clamp(target, _min_scale, max_scale);
+        const bool at_limit = target == _min_scale || target == max_scale;
+        if (target != _scale && (std::abs(target - _scale) >= min_change || at_limit))
+        {
+            _scale = target;
+            _frames_since_change = 0;
+        }
+    }
+
+    void DynamicResolution::set_scale(float scale)
+    {
+        _scale = std::clamp(scale, _min_scale, max_scale);
+        _frames_since_change = 0;
+    }
+
+    glm::uvec2 DynamicResolution::internal_size(glm::uvec2 output_size) const
+    {
+        const glm::uvec2 size = glm::uvec2(glm::round(glm::vec2(output_size) * _scale));
+        return glm::max(size, glm::uvec2(1));
+    }
+
+    void DynamicResolution::set_budget(float budget)
+    {
+        DEBUG_ASSERT(budget > 0.0f);
+        _budget = budget;
+    }
+
+    void DynamicResolution::set_min_scale(float scale)
+    {
+        DEBUG_ASSERT(scale > 0.0f && scale <= max_scale);
+        _min_scale = scale;
+        _scale = std::max(_scale, _min_scale);
+    }
+
+} // namespace OM3D
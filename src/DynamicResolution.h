@@ -0,0 +1,52 @@
+#ifndef DYNAMICRESOLUTION_H
+#define DYNAMICRESOLUTION_H
+
+#include <utils.h>
+
+#include <glm/vec2.hpp>
+
+namespace OM3D
+{
+
+    // Picks the internal render scale from the measured GPU frame time.
+    // The scale goes down as soon as the frame is over budget and only goes back up once the frame is comfortably
+    // under it, so that it doesn't oscillate around the budget. GPU timings arrive a few frames late: the controller
+    // waits for them to reflect a change before making another one.
+    class DynamicResolution
+    {
+    public:
+        DynamicResolution() = default;
+
+        // Feed the last measured GPU frame time, once per frame
+        void update(float gpu_frame_time);
+
+        float scale() const { return _scale; }
+        void set_scale(float scale);
+
+        // Internal resolution for an output size, never empty
+        glm::uvec2 internal_size(glm::uvec2 output_size) const;
+
+        bool enabled() const { return _enabled; }
+        void set_enabled(bool enabled) { _enabled = enabled; }
+
+        // Target GPU frame time, in seconds
+        float budget() const { return _budget; }
+        void set_budget(float budget);
+
+        float min_scale() const { return _min_scale; }
+        void set_min_scale(float scale);
+
+        static constexpr float max_scale = 1.0f;
+
+    private:
+        float _scale = max_scale;
+        float _min_scale = 0.5f;
+        float _budget = 1.0f / 60.0f;
+        bool _enabled = true;
+
+        u32 _frames_since_change = 0;
+    };
+
+} // namespace OM3D
+
+#endif // DYNAMICRESOLUTION_H
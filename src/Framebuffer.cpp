@@ -45,6 +45,21 @@ namespace OM3D
 
     Framebuffer::Framebuffer(Texture* depth) : Framebuffer(depth, nullptr, 0) {}
 
+    Framebuffer::Framebuffer(Texture* depth, u32 depth_layer) : _handle(create_framebuffer_handle())
+    {
+        DEBUG_ASSERT(depth && depth_layer < depth->layers());
+
+        glNamedFramebufferTextureLayer(_handle.get(), GL_DEPTH_ATTACHMENT, depth->_handle.get(), 0, depth_layer);
+        glNamedFramebufferDrawBuffer(_handle.get(), GL_NONE);
+        _size = depth->size();
+
+        ALWAYS_ASSERT(glCheckNamedFramebufferStatus(_handle.get(), GL_FRAMEBUFFER) == GL_FRAMEBUFFER_COMPLETE,
+                      "Invalid framebuffer");
+    }
+
+    Framebuffer::Framebuffer(Texture* depth, Span<Texture*> colors) : Framebuffer(depth, colors.data(), colors.size())
+    {}
+
     Framebuffer::Framebuffer(Texture* depth, Texture** colors, size_t count) : _handle(create_framebuffer_handle())
     {
         if (depth)
@@ -18,6 +18,9 @@ namespace OM3D
 
         Framebuffer();
         Framebuffer(Texture* depth);
+        // Depth only framebuffer rendering into a single layer of a texture array
+        Framebuffer(Texture* depth, u32 depth_layer);
+        Framebuffer(Texture* depth, Span<Texture*> colors);
 
         Framebuffer(Framebuffer&&) = default;
         Framebuffer& operator=(Framebuffer&&) = default;
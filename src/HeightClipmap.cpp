@@ -0,0 +1,651 @@
+#include "HeightClipmap.h"
+
+#include <algorithm>
+#include <cmath>
+
+#if defined(__SSE2__) || defined(_M_X64)
+#define OM3D_SSE2
+#include <emmintrin.h>
+#endif
+
+namespace OM3D
+{
+
+    // Must match clipmap_level() in terrain.glsl
+    static constexpr float blend_start = 0.8f;
+    static constexpr float max_level_distance = 0.95f;
+
+    static constexpr u32 max_ray_steps = 65536;
+    static constexpr u32 segment_samples = 4;
+    static constexpr u32 refine_steps = 6;
+
+    static constexpr float nan = std::numeric_limits<float>::quiet_NaN();
+    static constexpr float inf = std::numeric_limits<float>::infinity();
+
+    static glm::ivec2 floor_div(const glm::ivec2& value, i32 divisor)
+    {
+        return glm::ivec2(glm::floor(glm::vec2(value) / float(divisor)));
+    }
+
+    static float smoothstep(float edge0, float edge1, float x)
+    {
+        const float t = std::clamp((x - edge0) / (edge1 - edge0), 0.0f, 1.0f);
+        return t * t * (3.0f - 2.0f * t);
+    }
+
+    // Range of distances along the ray inside a square of the XZ plane, empty if x > y
+    static glm::vec2 square_interval(const glm::vec2& center, float half_extent, const TerrainRay& ray)
+    {
+        const glm::vec2 origin = glm::vec2(ray.origin.x, ray.origin.z);
+        const glm::vec2 direction = glm::vec2(ray.direction.x, ray.direction.z);
+
+        glm::vec2 interval = glm::vec2(-inf, inf);
+        for (u32 i = 0; i != 2; ++i)
+        {
+            if (direction[i] == 0.0f)
+            {
+                if (std::abs(origin[i] - center[i]) > half_extent)
+                {
+                    return glm::vec2(inf, -inf);
+                }
+                continue;
+            }
+            const float t0 = (center[i] - half_extent - origin[i]) / direction[i];
+            const float t1 = (center[i] + half_extent - origin[i]) / direction[i];
+            interval.x = std::max(interval.x, std::min(t0, t1));
+            interval.y = std::min(interval.y, std::max(t0, t1));
+        }
+        return interval;
+    }
+
+    HeightClipmap::HeightClipmap(u32 level_count, u32 resolution, float texel_size) :
+        _resolution(resolution),
+        _mask(resolution - 1),
+        _levels(level_count)
+    {
+        // Toroidal addressing masks texel coordinates
+        ALWAYS_ASSERT((resolution & _mask) == 0 && resolution >= (2u << max_bounds_mip),
+                      "Clipmap resolution must be a power of two");
+
+        for (u32 i = 0; i != level_count; ++i)
+        {
+            Level& level = _levels[i];
+            level.values.resize(size_t(resolution) * resolution);
+            for (u32 mip = 0; mip != max_bounds_mip; ++mip)
+            {
+                const size_t size = resolution >> (mip + 1);
+                level.bounds[mip].resize(size * size, glm::vec2(inf, -inf));
+            }
+            level.texel_size = texel_size * float(1u << i);
+            level.inv_texel_size = 1.0f / level.texel_size;
+            level.inv_half_extent = 1.0f / (0.5f * float(resolution) * level.texel_size);
+        }
+    }
+
+    void HeightClipmap::set_scale_bias(const glm::vec2& scale_bias)
+    {
+        _scale_bias = scale_bias;
+        for (u32 i = 0; i != _levels.size(); ++i)
+        {
+            const glm::ivec2 origin = _levels[i].window_origin;
+            const u32 size = _resolution;
+            _levels[i].dirty.push_back({origin, origin + i32(size) - 1});
+        }
+    }
+
+    void HeightClipmap::write_region(u32 level, const glm::ivec2& region_origin, const glm::uvec2& region_size,
+                                     const u16* values)
+    {
+        Level& target = _levels[level];
+        for (u32 y = 0; y != region_size.y; ++y)
+        {
+            const u32 row = (u32(region_origin.y + i32(y)) & _mask) * _resolution;
+            for (u32 x = 0; x != region_size.x; ++x)
+            {
+                target.values[row + (u32(region_origin.x + i32(x)) & _mask)] = values[y * region_size.x + x];
+            }
+        }
+        target.dirty.push_back({region_origin, region_origin + glm::ivec2(region_size) - 1});
+    }
+
+    void HeightClipmap::set_window(u32 level, const glm::ivec2& origin)
+    {
+        Level& target = _levels[level];
+        target.window_origin = origin;
+        target.window_center = (glm::vec2(origin) + 0.5f * float(_resolution)) * target.texel_size;
+        target.valid = true;
+
+        _last_valid = -1;
+        for (u32 i = 0; i != _levels.size() && _levels[i].valid; ++i)
+        {
+            _last_valid = i32(i);
+        }
+    }
+
+    void HeightClipmap::clear()
+    {
+        for (Level& level: _levels)
+        {
+            level.valid = false;
+        }
+        _last_valid = -1;
+    }
+
+    void HeightClipmap::update_bounds()
+    {
+        for (u32 i = 0; i != _levels.size(); ++i)
+        {
+            for (const Rect& dirty: _levels[i].dirty)
+            {
+                // The last texels of a window wrap around to its first ones: texels are also sampled one resolution
+                // away from where they were written
+                for (i32 y = -1; y <= 1; ++y)
+                {
+                    for (i32 x = -1; x <= 1; ++x)
+                    {
+                        const glm::ivec2 offset = glm::ivec2(x, y) * i32(_resolution);
+                        const Rect rect = {dirty.min + offset, dirty.max + offset};
+
+                        // Cells of two texels span three of them, and bound the texels of the next level under them
+                        update_cells(i, {floor_div(rect.min - 2, 2), floor_div(rect.max, 2)});
+                        if (i > 0)
+                        {
+                            update_cells(i - 1, {rect.min - 1, rect.max});
+                        }
+                    }
+                }
+            }
+        }
+        for (Level& level: _levels)
+        {
+            level.dirty.clear();
+        }
+    }
+
+    void HeightClipmap::update_cells(u32 level, const Rect& cells)
+    {
+        Level& target = _levels[level];
+        const Level* next = level + 1 < _levels.size() ? &_levels[level + 1] : nullptr;
+
+        // Only the cells of the window are sampled, the others don't need to be consistent with their texels
+        const glm::ivec2 window_min = floor_div(target.window_origin, 2);
+        const glm::ivec2 window_max = window_min + i32(_resolution / 2) - 1;
+        Rect rect = {glm::max(cells.min, window_min), glm::min(cells.max, window_max)};
+        if (rect.min.x > rect.max.x || rect.min.y > rect.max.y)
+        {
+            return;
+        }
+
+        {
+            const u32 size = _resolution / 2;
+            for (i32 y = rect.min.y; y <= rect.max.y; ++y)
+            {
+                for (i32 x = rect.min.x; x <= rect.max.x; ++x)
+                {
+                    glm::vec2 bounds = glm::vec2(inf, -inf);
+                    for (i32 dy = 0; dy != 3; ++dy)
+                    {
+                        for (i32 dx = 0; dx != 3; ++dx)
+                        {
+                            const float height = value(target, glm::ivec2(2 * x + dx, 2 * y + dy));
+                            bounds = glm::vec2(std::min(bounds.x, height), std::max(bounds.y, height));
+                        }
+                    }
+                    if (next && next->valid)
+                    {
+                        for (i32 dy = 0; dy != 2; ++dy)
+                        {
+                            for (i32 dx = 0; dx != 2; ++dx)
+                            {
+                                const float height = value(*next, glm::ivec2(x + dx, y + dy));
+                                bounds = glm::vec2(std::min(bounds.x, height), std::max(bounds.y, height));
+                            }
+                        }
+                    }
+                    target.bounds[0][(u32(y) & (size - 1)) * size + (u32(x) & (size - 1))] = bounds;
+                }
+            }
+        }
+
+        // Coarser cells are the union of the four cells stored under them, whatever world cells they hold
+        for (u32 mip = 1; mip != max_bounds_mip; ++mip)
+        {
+            const u32 size = _resolution >> (mip + 1);
+            const u32 child_size = size * 2;
+            rect = {floor_div(rect.min, 2), floor_div(rect.max, 2)};
+            rect.max = glm::min(rect.max, rect.min + i32(size) - 1);
+
+            for (i32 y = rect.min.y; y <= rect.max.y; ++y)
+            {
+                for (i32 x = rect.min.x; x <= rect.max.x; ++x)
+                {
+                    glm::vec2 bounds = glm::vec2(inf, -inf);
+                    for (u32 dy = 0; dy != 2; ++dy)
+                    {
+                        for (u32 dx = 0; dx != 2; ++dx)
+                        {
+                            const u32 child_x = (2 * u32(x) + dx) & (child_size - 1);
+                            const u32 child_y = (2 * u32(y) + dy) & (child_size - 1);
+                            const glm::vec2 child = target.bounds[mip - 1][child_y * child_size + child_x];
+                            bounds = glm::vec2(std::min(bounds.x, child.x), std::max(bounds.y, child.y));
+                        }
+                    }
+                    target.bounds[mip][(u32(y) & (size - 1)) * size + (u32(x) & (size - 1))] = bounds;
+                }
+            }
+        }
+    }
+
+    float HeightClipmap::value(const Level& level, const glm::ivec2& texel) const
+    {
+        const u16 value = level.values[(u32(texel.y) & _mask) * _resolution + (u32(texel.x) & _mask)];
+        return float(value) / 65535.0f * _scale_bias.x + _scale_bias.y;
+    }
+
+    float HeightClipmap::sample_level(const Level& level, const glm::vec2& position) const
+    {
+        // Texel i holds the height at i * texel_size
+        const glm::vec2 t = position * level.inv_texel_size;
+        const glm::vec2 t0 = glm::floor(t);
+        const glm::vec2 f = t - t0;
+        const glm::ivec2 i = glm::ivec2(t0);
+
+        const float h00 = value(level, i);
+        const float h10 = value(level, i + glm::ivec2(1, 0));
+        const float h01 = value(level, i + glm::ivec2(0, 1));
+        const float h11 = value(level, i + glm::ivec2(1, 1));
+        return glm::mix(glm::mix(h00, h10, f.x), glm::mix(h01, h11, f.x), f.y);
+    }
+
+    float HeightClipmap::window_distance(const Level& level, const glm::vec2& position) const
+    {
+        const glm::vec2 offset = glm::abs(position - level.window_center) * level.inv_half_extent;
+        return std::max(offset.x, offset.y);
+    }
+
+    i32 HeightClipmap::select_level(const glm::vec2& position, float& blend) const
+    {
+        blend = 0.0f;
+        for (i32 i = 0; i <= _last_valid; ++i)
+        {
+            // Unlike on the GPU, the last level isn't used outside of its window since it doesn't hold those texels
+            const bool last = i == _last_valid;
+            const float dist = window_distance(_levels[i], position);
+            if (dist <= (last ? 1.0f : max_level_distance))
+            {
+                blend = last ? 0.0f : smoothstep(blend_start, max_level_distance, dist);
+                return i;
+            }
+        }
+        return -1;
+    }
+
+    float HeightClipmap::height(const glm::vec2& position) const
+    {
+        float blend = 0.0f;
+        const i32 level = select_level(position, blend);
+        if (level < 0)
+        {
+            return nan;
+        }
+
+        const float height = sample_level(_levels[level], position);
+        return blend > 0.0f ? glm::mix(height, sample_level(_levels[level + 1], position), blend) : height;
+    }
+
+#ifdef OM3D_SSE2
+    static __m128 abs_ps(__m128 x)
+    {
+        return _mm_andnot_ps(_mm_set1_ps(-0.0f), x);
+    }
+
+    static __m128 select_ps(__m128 mask, __m128 a, __m128 b)
+    {
+        return _mm_or_ps(_mm_and_ps(mask, a), _mm_andnot_ps(mask, b));
+    }
+
+    // SSE2 has no rounding instructions
+    static __m128 floor_ps(__m128 x)
+    {
+        const __m128 truncated = _mm_cvtepi32_ps(_mm_cvttps_epi32(x));
+        return _mm_sub_ps(truncated, _mm_and_ps(_mm_cmpgt_ps(truncated, x), _mm_set1_ps(1.0f)));
+    }
+
+    static __m128 lerp_ps(__m128 a, __m128 b, __m128 t)
+    {
+        return _mm_add_ps(a, _mm_mul_ps(_mm_sub_ps(b, a), t));
+    }
+#endif
+
+    void HeightClipmap::heights4(const glm::vec2* positions, float* heights) const
+    {
+#ifdef OM3D_SSE2
+        const __m128 x = _mm_setr_ps(positions[0].x, positions[1].x, positions[2].x, positions[3].x);
+        const __m128 z = _mm_setr_ps(positions[0].y, positions[1].y, positions[2].y, positions[3].y);
+
+        // Finest level covering each lane
+        i32 levels[4] = {-1, -1, -1, -1};
+        __m128 assigned = _mm_setzero_ps();
+        __m128 blend = _mm_setzero_ps();
+        for (i32 i = 0; i <= _last_valid; ++i)
+        {
+            const Level& level = _levels[i];
+            const bool last = i == _last_valid;
+
+            const __m128 inv_half_extent = _mm_set1_ps(level.inv_half_extent);
+            const __m128 dx = _mm_mul_ps(abs_ps(_mm_sub_ps(x, _mm_set1_ps(level.window_center.x))), inv_half_extent);
+            const __m128 dz = _mm_mul_ps(abs_ps(_mm_sub_ps(z, _mm_set1_ps(level.window_center.y))), inv_half_extent);
+            const __m128 dist = _mm_max_ps(dx, dz);
+
+            const __m128 limit = _mm_set1_ps(last ? 1.0f : max_level_distance);
+            const __m128 inside = _mm_andnot_ps(assigned, _mm_cmple_ps(dist, limit));
+            const int mask = _mm_movemask_ps(inside);
+            if (!mask)
+            {
+                continue;
+            }
+
+            if (!last)
+            {
+                const __m128 range = _mm_set1_ps(1.0f / (max_level_distance - blend_start));
+                const __m128 t = _mm_min_ps(
+                        _mm_max_ps(_mm_mul_ps(_mm_sub_ps(dist, _mm_set1_ps(blend_start)), range), _mm_setzero_ps()),
+                        _mm_set1_ps(1.0f));
+                const __m128 smooth = _mm_mul_ps(_mm_mul_ps(t, t), _mm_sub_ps(_mm_set1_ps(3.0f), _mm_add_ps(t, t)));
+                blend = select_ps(inside, smooth, blend);
+            }
+            for (u32 lane = 0; lane != 4; ++lane)
+            {
+                if (mask & (1 << lane))
+                {
+                    levels[lane] = i;
+                }
+            }
+
+            assigned = _mm_or_ps(assigned, inside);
+            if (_mm_movemask_ps(assigned) == 0xF)
+            {
+                break;
+            }
+        }
+
+        const auto sample = [&](const i32 (&sampled)[4])
+        {
+            alignas(16) float inv_texel_sizes[4] = {};
+            for (u32 lane = 0; lane != 4; ++lane)
+            {
+                inv_texel_sizes[lane] = sampled[lane] < 0 ? 0.0f : _levels[sampled[lane]].inv_texel_size;
+            }
+            const __m128 inv_texel_size = _mm_load_ps(inv_texel_sizes);
+            const __m128 tx = _mm_mul_ps(x, inv_texel_size);
+            const __m128 tz = _mm_mul_ps(z, inv_texel_size);
+            const __m128 tx0 = floor_ps(tx);
+            const __m128 tz0 = floor_ps(tz);
+
+            alignas(16) i32 ix[4] = {};
+            alignas(16) i32 iz[4] = {};
+            _mm_store_si128(reinterpret_cast<__m128i*>(ix), _mm_cvttps_epi32(tx0));
+            _mm_store_si128(reinterpret_cast<__m128i*>(iz), _mm_cvttps_epi32(tz0));
+
+            alignas(16) float corners[4][4] = {};
+            for (u32 lane = 0; lane != 4; ++lane)
+            {
+                if (sampled[lane] < 0)
+                {
+                    continue;
+                }
+                const std::vector<u16>& values = _levels[sampled[lane]].values;
+                const u32 x0 = u32(ix[lane]) & _mask;
+                const u32 x1 = u32(ix[lane] + 1) & _mask;
+                const u32 row0 = (u32(iz[lane]) & _mask) * _resolution;
+                const u32 row1 = (u32(iz[lane] + 1) & _mask) * _resolution;
+                corners[0][lane] = float(values[row0 + x0]);
+                corners[1][lane] = float(values[row0 + x1]);
+                corners[2][lane] = float(values[row1 + x0]);
+                corners[3][lane] = float(values[row1 + x1]);
+            }
+
+            const __m128 fx = _mm_sub_ps(tx, tx0);
+            const __m128 fz = _mm_sub_ps(tz, tz0);
+            const __m128 top = lerp_ps(_mm_load_ps(corners[0]), _mm_load_ps(corners[1]), fx);
+            const __m128 bottom = lerp_ps(_mm_load_ps(corners[2]), _mm_load_ps(corners[3]), fx);
+            return lerp_ps(top, bottom, fz);
+        };
+
+        // Values are decoded once blended, which is the same since decoding is linear
+        __m128 value = sample(levels);
+        const int blend_mask = _mm_movemask_ps(_mm_cmpgt_ps(blend, _mm_setzero_ps()));
+        if (blend_mask)
+        {
+            i32 next_levels[4] = {-1, -1, -1, -1};
+            for (u32 lane = 0; lane != 4; ++lane)
+            {
+                next_levels[lane] = (blend_mask & (1 << lane)) ? levels[lane] + 1 : levels[lane];
+            }
+            value = lerp_ps(value, sample(next_levels), blend);
+        }
+
+        const __m128 scale = _mm_set1_ps(_scale_bias.x / 65535.0f);
+        const __m128 height = _mm_add_ps(_mm_mul_ps(value, scale), _mm_set1_ps(_scale_bias.y));
+        _mm_storeu_ps(heights, select_ps(assigned, height, _mm_set1_ps(nan)));
+#else
+        for (u32 i = 0; i != 4; ++i)
+        {
+            heights[i] = height(positions[i]);
+        }
+#endif
+    }
+
+    void HeightClipmap::heights(Span<const glm::vec2> positions, Span<float> heights) const
+    {
+        DEBUG_ASSERT(positions.size() == heights.size());
+
+        const size_t groups = positions.size() / 4;
+        parallel_for(groups, 4096, [&](size_t begin, size_t end)
+        {
+            for (size_t i = begin; i != end; ++i)
+            {
+                heights4(positions.data() + i * 4, heights.data() + i * 4);
+            }
+        });
+
+        for (size_t i = groups * 4; i != positions.size(); ++i)
+        {
+            heights[i] = height(positions[i]);
+        }
+    }
+
+    float HeightClipmap::level_area_exit(i32 level, const TerrainRay& ray, float t) const
+    {
+        const Level& target = _levels[level];
+        const float extent = (level == _last_valid ? 1.0f : max_level_distance) / target.inv_half_extent;
+        float exit = square_interval(target.window_center, extent, ray).y;
+
+        // The ray can also enter the area of a finer level, which is nested in this one
+        for (i32 i = level - 1; i >= 0; --i)
+        {
+            if (_levels[i].valid)
+            {
+                const Level& finer = _levels[i];
+                const glm::vec2 interval =
+                        square_interval(finer.window_center, max_level_distance / finer.inv_half_extent, ray);
+                if (interval.x <= interval.y && interval.x > t)
+                {
+                    exit = std::min(exit, interval.x);
+                }
+                break;
+            }
+        }
+        return exit;
+    }
+
+    bool HeightClipmap::intersect_segment(const TerrainRay& ray, float t0, float t1, TerrainHit& hit) const
+    {
+        // Height of the ray above the terrain
+        const auto above = [&](float t)
+        {
+            const glm::vec3 position = ray.origin + ray.direction * t;
+            return position.y - height(glm::vec2(position.x, position.z));
+        };
+
+        float f0 = above(t0);
+        if (f0 <= 0.0f)
+        {
+            hit.distance = t0;
+            hit.position = ray.origin + ray.direction * t0;
+            return true;
+        }
+
+        // Bilinear interpolation is quadratic along the ray and can dip under it between the ends of the segment
+        const float start = t0;
+        const float step = (t1 - t0) / float(segment_samples);
+        float f1 = f0;
+        for (u32 i = 1;; ++i)
+        {
+            if (i > segment_samples)
+            {
+                return false;
+            }
+            t1 = start + step * float(i);
+            f1 = above(t1);
+            if (f1 <= 0.0f)
+            {
+                break;
+            }
+            t0 = t1;
+            f0 = f1;
+        }
+
+        // The surface is close to linear on a sub-segment: regula falsi converges in a few steps
+        for (u32 i = 0; i != refine_steps; ++i)
+        {
+            const float t = t0 + (t1 - t0) * f0 / (f0 - f1);
+            const float f = above(t);
+            if (f > 0.0f)
+            {
+                t0 = t;
+                f0 = f;
+            }
+            else
+            {
+                t1 = t;
+                f1 = f;
+            }
+        }
+
+        hit.distance = t0 + (t1 - t0) * f0 / (f0 - f1);
+        hit.position = ray.origin + ray.direction * hit.distance;
+        return true;
+    }
+
+    TerrainHit HeightClipmap::raycast(const TerrainRay& ray) const
+    {
+        TerrainHit hit;
+        if (_last_valid < 0)
+        {
+            return hit;
+        }
+
+        float t_min = 0.0f;
+        float t_max = ray.max_distance;
+
+        // Clip the ray to the heights the terrain can have and to the area covered by the clipmap
+        const float min_height = _scale_bias.y;
+        const float max_height = _scale_bias.y + _scale_bias.x;
+        if (ray.direction.y != 0.0f)
+        {
+            const float t0 = (min_height - ray.origin.y) / ray.direction.y;
+            const float t1 = (max_height - ray.origin.y) / ray.direction.y;
+            t_min = std::max(t_min, std::min(t0, t1));
+            t_max = std::min(t_max, std::max(t0, t1));
+        }
+        else if (ray.origin.y < min_height || ray.origin.y > max_height)
+        {
+            return hit;
+        }
+
+        const Level& outer = _levels[_last_valid];
+        const glm::vec2 area = square_interval(outer.window_center, 1.0f / outer.inv_half_extent, ray);
+        t_min = std::max(t_min, area.x);
+        t_max = std::min(t_max, area.y);
+
+        // Offset taking positions on cell borders into the cell the ray enters
+        const float direction_xz = glm::length(glm::vec2(ray.direction.x, ray.direction.z));
+        const float nudge = direction_xz > 0.0f ? 1e-3f * _levels[0].texel_size / direction_xz : 0.0f;
+
+        // Walk the quadtree of the level under the ray: cells whose bounds the ray stays above are skipped
+        // whole, going up a mip after each skip and down when a cell can't be skipped
+        u32 mip = max_bounds_mip;
+        float t = t_min;
+        for (u32 step = 0; step != max_ray_steps && t <= t_max; ++step)
+        {
+            const glm::vec3 probe = ray.origin + ray.direction * (t + nudge);
+            const glm::vec2 probe_xz = glm::vec2(probe.x, probe.z);
+
+            float blend = 0.0f;
+            const i32 level_index = select_level(probe_xz, blend);
+            if (level_index < 0)
+            {
+                break;
+            }
+            const Level& level = _levels[level_index];
+
+            const float cell_size = level.texel_size * float(1u << mip);
+            const glm::vec2 cell = glm::floor(probe_xz / cell_size);
+            float cell_exit = inf;
+            for (u32 i = 0; i != 2; ++i)
+            {
+                const u32 axis = i * 2;
+                if (ray.direction[axis] != 0.0f)
+                {
+                    const float border = (ray.direction[axis] > 0.0f ? cell[i] + 1.0f : cell[i]) * cell_size;
+                    cell_exit = std::min(cell_exit, (border - ray.origin[axis]) / ray.direction[axis]);
+                }
+            }
+            const float t_exit =
+                    std::max(std::min({cell_exit, level_area_exit(level_index, ray, t), t_max}), t + nudge);
+
+            if (mip == 0)
+            {
+                if (intersect_segment(ray, t, std::min(t_exit, t_max), hit))
+                {
+                    return hit;
+                }
+                t = t_exit;
+                mip = 1;
+                continue;
+            }
+
+            const u32 size = _resolution >> mip;
+            const glm::ivec2 c = glm::ivec2(cell);
+            const glm::vec2 bounds = level.bounds[mip - 1][(u32(c.y) & (size - 1)) * size + (u32(c.x) & (size - 1))];
+            const float y0 = ray.origin.y + ray.direction.y * t;
+            const float y1 = ray.origin.y + ray.direction.y * t_exit;
+            // Rays under the terrain aren't skipped, the texel they start in reports the hit
+            if (std::min(y0, y1) > bounds.y)
+            {
+                t = t_exit;
+                mip = std::min(mip + 1, max_bounds_mip);
+            }
+            else
+            {
+                --mip;
+            }
+        }
+        return hit;
+    }
+
+    void HeightClipmap::raycast(Span<const TerrainRay> rays, Span<TerrainHit> hits) const
+    {
+        DEBUG_ASSERT(rays.size() == hits.size());
+
+        parallel_for(rays.size(), 256, [&](size_t begin, size_t end)
+        {
+            for (size_t i = begin; i != end; ++i)
+            {
+                hits[i] = raycast(rays[i]);
+            }
+        });
+    }
+
+} // namespace OM3D
@@ -0,0 +1,110 @@
+#ifndef HEIGHTCLIPMAP_H
+#define HEIGHTCLIPMAP_H
+
+#include <utils.h>
+
+#include <glm/glm.hpp>
+
+#include <array>
+#include <limits>
+#include <vector>
+
+namespace OM3D
+{
+
+    struct TerrainRay
+    {
+        glm::vec3 origin = {};
+        // Doesn't need to be normalized, distances are in multiples of its length
+        glm::vec3 direction = glm::vec3(0.0f, -1.0f, 0.0f);
+        float max_distance = std::numeric_limits<float>::max();
+    };
+
+    struct TerrainHit
+    {
+        // Negative when the ray misses the terrain
+        float distance = -1.0f;
+        glm::vec3 position = {};
+
+        bool is_hit() const { return distance >= 0.0f; }
+    };
+
+    // CPU copy of the terrain height clipmap (see Terrain.h) for height and ray queries.
+    // Regions are written with the same values that are uploaded to the GPU (generated or heightfield heights with
+    // the edits applied), levels use the same toroidal addressing, and heights are sampled like terrain.glsl does
+    // (finest level covering a position, blended with the next one near its border). Rays traverse a min/max quadtree
+    // of every level, whose cells also bound the next level where the two are blended, and only sample heights in the
+    // cells they can hit.
+    // Batched queries are split across all hardware threads, heights are sampled four at a time with SSE2.
+    class HeightClipmap : NonCopyable
+    {
+    public:
+        // Cells of the coarsest mip of the quadtree are 2^max_bounds_mip texels wide
+        static constexpr u32 max_bounds_mip = 6;
+
+        HeightClipmap(u32 level_count, u32 resolution, float texel_size);
+
+        // Values are normalized heights: height = value * scale + bias
+        void set_scale_bias(const glm::vec2& scale_bias);
+
+        // Copies a region of a level (in texels of that level), values are rows of region_size.x normalized heights
+        void write_region(u32 level, const glm::ivec2& region_origin, const glm::uvec2& region_size, const u16* values);
+        // Window of a level that the written regions belong to, makes the level usable by queries
+        void set_window(u32 level, const glm::ivec2& origin);
+        // Makes every level unusable until its window is set again
+        void clear();
+        // Updates the quadtree cells covering the regions written since the last call
+        void update_bounds();
+
+        // NaN where no level covers the position
+        float height(const glm::vec2& position) const;
+        TerrainHit raycast(const TerrainRay& ray) const;
+
+        void heights(Span<const glm::vec2> positions, Span<float> heights) const;
+        void raycast(Span<const TerrainRay> rays, Span<TerrainHit> hits) const;
+
+    private:
+        // Inclusive bounds, in texels or cells
+        struct Rect
+        {
+            glm::ivec2 min = {};
+            glm::ivec2 max = {};
+        };
+
+        struct Level
+        {
+            std::vector<u16> values;
+            // Min/max heights of cells of 2^(i + 1) texels, stored toroidally like the values
+            std::array<std::vector<glm::vec2>, max_bounds_mip> bounds;
+            std::vector<Rect> dirty;
+
+            glm::ivec2 window_origin = {};
+            glm::vec2 window_center = {};
+            float inv_half_extent = 0.0f;
+            float texel_size = 0.0f;
+            float inv_texel_size = 0.0f;
+            bool valid = false;
+        };
+
+        float value(const Level& level, const glm::ivec2& texel) const;
+        float sample_level(const Level& level, const glm::vec2& position) const;
+        float window_distance(const Level& level, const glm::vec2& position) const;
+        // Index of the level sampled at a position (-1 if none) and how much it is blended with the next one
+        i32 select_level(const glm::vec2& position, float& blend) const;
+        // Distance along the ray at which it leaves the area where a level is the one sampled
+        float level_area_exit(i32 level, const TerrainRay& ray, float t) const;
+        // Finds where the ray crosses the surface between two distances, for segments shorter than a texel
+        bool intersect_segment(const TerrainRay& ray, float t0, float t1, TerrainHit& hit) const;
+        void update_cells(u32 level, const Rect& cells);
+        void heights4(const glm::vec2* positions, float* heights) const;
+
+        u32 _resolution = 0;
+        u32 _mask = 0;
+        std::vector<Level> _levels;
+        i32 _last_valid = -1;
+        glm::vec2 _scale_bias = glm::vec2(1.0f, 0.0f);
+    };
+
+} // namespace OM3D
+
+#endif // HEIGHTCLIPMAP_H
@@ -0,0 +1,459 @@
+#include "HeightTileFile.h"
+
+#include <stb/stb_image.h>
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <filesystem>
+#include <limits>
+#include <vector>
+
+#ifdef OS_WIN
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace OM3D
+{
+
+    static constexpr u32 file_magic = 0x46484d4f; // "OMHF"
+    static constexpr u32 file_version = 1;
+    // Tiles start on a page boundary so that mapping one doesn't page in its neighbors
+    static constexpr u64 tile_alignment = 4096;
+    static constexpr size_t tile_bytes = size_t(HeightTileFile::tile_size) * HeightTileFile::tile_size * sizeof(u16);
+
+    struct HeightTileFile::Header
+    {
+        u32 magic = file_magic;
+        u32 version = file_version;
+        // Samples of mip 0
+        u32 width = 0;
+        u32 height = 0;
+        u32 tile_size = HeightTileFile::tile_size;
+        // The last mip fits in a tile
+        u32 mip_count = 0;
+        float texel_size = 1.0f;
+        // height = value / 65535 * (max_height - min_height) + min_height
+        float min_height = 0.0f;
+        float max_height = 0.0f;
+        u32 padding = 0;
+    };
+
+    struct HeightTileFile::Mapping
+    {
+        const u8* data = nullptr;
+        size_t size = 0;
+#ifdef OS_WIN
+        HANDLE file = INVALID_HANDLE_VALUE;
+        HANDLE mapping = nullptr;
+#else
+        int file = -1;
+#endif
+
+        bool map(const std::string& file_name)
+        {
+#ifdef OS_WIN
+            file = CreateFileA(file_name.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING,
+                               FILE_ATTRIBUTE_NORMAL, nullptr);
+            LARGE_INTEGER file_size = {};
+            if (file == INVALID_HANDLE_VALUE || !GetFileSizeEx(file, &file_size) || !file_size.QuadPart)
+            {
+                return false;
+            }
+            mapping = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+            if (!mapping)
+            {
+                return false;
+            }
+            data = static_cast<const u8*>(MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0));
+            size = size_t(file_size.QuadPart);
+#else
+            file = ::open(file_name.c_str(), O_RDONLY);
+            struct stat file_stat = {};
+            if (file < 0 || fstat(file, &file_stat) != 0 || !file_stat.st_size)
+            {
+                return false;
+            }
+            void* view = mmap(nullptr, size_t(file_stat.st_size), PROT_READ, MAP_SHARED, file, 0);
+            if (view == MAP_FAILED)
+            {
+                return false;
+            }
+            data = static_cast<const u8*>(view);
+            size = size_t(file_stat.st_size);
+#endif
+            return data != nullptr;
+        }
+
+        ~Mapping()
+        {
+#ifdef OS_WIN
+            if (data)
+                UnmapViewOfFile(data);
+            if (mapping)
+                CloseHandle(mapping);
+            if (file != INVALID_HANDLE_VALUE)
+                CloseHandle(file);
+#else
+            if (data)
+                munmap(const_cast<u8*>(data), size);
+            if (file >= 0)
+                ::close(file);
+#endif
+        }
+    };
+
+    // Rounded up without overflowing, sizes come from the header
+    static glm::uvec2 div_ceil(const glm::uvec2& value, u32 divisor)
+    {
+        return value / divisor + glm::uvec2(glm::notEqual(value % divisor, glm::uvec2(0)));
+    }
+
+    static glm::uvec2 mip_size(const glm::uvec2& size, u32 mip)
+    {
+        return glm::max(div_ceil(size, 1u << mip), glm::uvec2(1));
+    }
+
+    static glm::uvec2 tile_count(const glm::uvec2& size)
+    {
+        return div_ceil(size, HeightTileFile::tile_size);
+    }
+
+    HeightTileFile::~HeightTileFile() {}
+
+    Result<std::unique_ptr<HeightTileFile>> HeightTileFile::open(const std::string& file_name)
+    {
+        auto mapping = std::make_unique<Mapping>();
+        if (!mapping->map(file_name) || mapping->size < sizeof(Header))
+        {
+            return {false, nullptr};
+        }
+
+        const Header* header = reinterpret_cast<const Header*>(mapping->data);
+        if (header->magic != file_magic || header->version != file_version || header->tile_size != tile_size ||
+            !header->width || !header->height || !header->mip_count || header->mip_count > 32 ||
+            !(header->texel_size > 0.0f))
+        {
+            return {false, nullptr};
+        }
+
+        auto first_tiles = std::make_unique<u32[]>(header->mip_count);
+        u64 total_tiles = 0;
+        for (u32 mip = 0; mip != header->mip_count; ++mip)
+        {
+            first_tiles[mip] = u32(total_tiles);
+            const glm::uvec2 tiles = tile_count(mip_size(glm::uvec2(header->width, header->height), mip));
+            total_tiles += u64(tiles.x) * tiles.y;
+        }
+
+        // The index must fit in the file, which also keeps its end from overflowing
+        const size_t max_tiles = (mapping->size - sizeof(Header)) / sizeof(u64);
+        if (total_tiles > max_tiles || total_tiles > std::numeric_limits<u32>::max())
+        {
+            return {false, nullptr};
+        }
+        const size_t index_end = sizeof(Header) + size_t(total_tiles) * sizeof(u64);
+        const u64* tile_offsets = reinterpret_cast<const u64*>(mapping->data + sizeof(Header));
+        for (u32 i = 0; i != u32(total_tiles); ++i)
+        {
+            const u64 offset = tile_offsets[i];
+            if (offset < index_end || offset > mapping->size || mapping->size - offset < tile_bytes ||
+                offset % sizeof(u16) != 0)
+            {
+                return {false, nullptr};
+            }
+        }
+
+        std::unique_ptr<HeightTileFile> file(new HeightTileFile());
+        file->_header = header;
+        file->_tile_offsets = tile_offsets;
+        file->_first_tiles = std::move(first_tiles);
+        file->_mapping = std::move(mapping);
+        return {true, std::move(file)};
+    }
+
+    Result<void> HeightTileFile::convert(const std::string& input, const std::string& output,
+                                         const ConvertSettings& settings)
+    {
+        glm::uvec2 size = {};
+        std::vector<u16> heights;
+        if (ends_with(input, ".png"))
+        {
+            int width = 0;
+            int height = 0;
+            int channels = 0;
+            u16* image = stbi_load_16(input.c_str(), &width, &height, &channels, 1);
+            DEFER(stbi_image_free(image));
+            if (!image || width <= 0 || height <= 0)
+            {
+                return {false};
+            }
+            size = glm::uvec2(width, height);
+            heights.assign(image, image + size_t(size.x) * size.y);
+        }
+        else
+        {
+            FILE* file = std::fopen(input.c_str(), "rb");
+            if (!file)
+            {
+                return {false};
+            }
+            DEFER(std::fclose(file));
+
+            std::error_code error;
+            const u64 bytes = std::filesystem::file_size(input, error);
+            const u32 side = u32(std::sqrt(double(bytes / sizeof(u16))) + 0.5);
+            if (error || !side || u64(side) * side * sizeof(u16) != bytes)
+            {
+                return {false};
+            }
+            size = glm::uvec2(side);
+            heights.resize(size_t(side) * side);
+            if (std::fread(heights.data(), sizeof(u16), heights.size(), file) != heights.size())
+            {
+                return {false};
+            }
+        }
+
+        // Every mip averages 2x2 samples of the previous one, clamped to its edges
+        std::vector<std::vector<u16>> mips;
+        mips.push_back(std::move(heights));
+        while (glm::any(glm::greaterThan(mip_size(size, u32(mips.size() - 1)), glm::uvec2(tile_size))))
+        {
+            const u32 mip = u32(mips.size());
+            const glm::uvec2 source_size = mip_size(size, mip - 1);
+            const glm::uvec2 mip_dims = mip_size(size, mip);
+            std::vector<u16> values(size_t(mip_dims.x) * mip_dims.y);
+            const std::vector<u16>& source = mips.back();
+            for (u32 y = 0; y != mip_dims.y; ++y)
+            {
+                const u32 y0 = y * 2;
+                const u32 y1 = std::min(y0 + 1, source_size.y - 1);
+                for (u32 x = 0; x != mip_dims.x; ++x)
+                {
+                    const u32 x0 = x * 2;
+                    const u32 x1 = std::min(x0 + 1, source_size.x - 1);
+                    const u32 sum = u32(source[size_t(y0) * source_size.x + x0]) +
+                                    source[size_t(y0) * source_size.x + x1] +
+                                    source[size_t(y1) * source_size.x + x0] + source[size_t(y1) * source_size.x + x1];
+                    values[size_t(y) * mip_dims.x + x] = u16((sum + 2) / 4);
+                }
+            }
+            mips.push_back(std::move(values));
+        }
+
+        Header header;
+        header.width = size.x;
+        header.height = size.y;
+        header.mip_count = u32(mips.size());
+        header.texel_size = settings.texel_size;
+        header.min_height = settings.min_height;
+        header.max_height = settings.max_height;
+
+        size_t tile_total = 0;
+        for (u32 mip = 0; mip != header.mip_count; ++mip)
+        {
+            const glm::uvec2 tiles = tile_count(mip_size(size, mip));
+            tile_total += size_t(tiles.x) * tiles.y;
+        }
+        const u64 index_end = sizeof(Header) + u64(tile_total) * sizeof(u64);
+        const u64 first_tile = (index_end + tile_alignment - 1) / tile_alignment * tile_alignment;
+
+        // Written under another name first so that an interrupted conversion never leaves a truncated file behind
+        const std::string temp_path = output + ".tmp";
+        FILE* file = std::fopen(temp_path.c_str(), "wb");
+        if (!file)
+        {
+            return {false};
+        }
+
+        // Tiles are written in the order of the index
+        std::vector<u64> tile_offsets(tile_total);
+        for (size_t i = 0; i != tile_total; ++i)
+        {
+            tile_offsets[i] = first_tile + u64(i) * tile_bytes;
+        }
+
+        bool written = std::fwrite(&header, sizeof(header), 1, file) == 1;
+        written = written && std::fwrite(tile_offsets.data(), sizeof(u64), tile_total, file) == tile_total;
+        const std::vector<u8> padding(size_t(first_tile - index_end), 0);
+        written = written && std::fwrite(padding.data(), 1, padding.size(), file) == padding.size();
+
+        std::vector<u16> tile(size_t(tile_size) * tile_size);
+        for (u32 mip = 0; written && mip != header.mip_count; ++mip)
+        {
+            const glm::uvec2 mip_dims = mip_size(size, mip);
+            const glm::uvec2 tiles = tile_count(mip_dims);
+            for (u32 tile_y = 0; written && tile_y != tiles.y; ++tile_y)
+            {
+                for (u32 tile_x = 0; written && tile_x != tiles.x; ++tile_x)
+                {
+                    // Samples past the edges are never read
+                    std::fill(tile.begin(), tile.end(), u16(0));
+                    for (u32 y = 0; y != tile_size && tile_y * tile_size + y < mip_dims.y; ++y)
+                    {
+                        const u32 first_x = tile_x * tile_size;
+                        const u32 columns = std::min(tile_size, mip_dims.x - first_x);
+                        const u16* row = mips[mip].data() + size_t(tile_y * tile_size + y) * mip_dims.x + first_x;
+                        std::copy_n(row, columns, tile.data() + size_t(y) * tile_size);
+                    }
+                    written = std::fwrite(tile.data(), sizeof(u16), tile.size(), file) == tile.size();
+                }
+            }
+        }
+        std::fclose(file);
+
+        std::error_code error;
+        if (written)
+        {
+            std::filesystem::rename(temp_path, output, error);
+        }
+        else
+        {
+            std::filesystem::remove(temp_path, error);
+        }
+        return {written && !error};
+    }
+
+    glm::uvec2 HeightTileFile::size() const
+    {
+        return glm::uvec2(_header->width, _header->height);
+    }
+
+    float HeightTileFile::texel_size() const
+    {
+        return _header->texel_size;
+    }
+
+    glm::vec2 HeightTileFile::height_range() const
+    {
+        return glm::vec2(_header->min_height, _header->max_height);
+    }
+
+    u16 HeightTileFile::sample(u32 mip, const glm::ivec2& coord) const
+    {
+        const glm::uvec2 dims = mip_size(size(), mip);
+        if (coord.x < 0 || coord.y < 0 || u32(coord.x) >= dims.x || u32(coord.y) >= dims.y)
+        {
+            return 0;
+        }
+
+        const glm::uvec2 texel = glm::uvec2(coord);
+        const glm::uvec2 tile = texel / tile_size;
+        const u32 tiles_x = tile_count(dims).x;
+        const u64 offset = _tile_offsets[_first_tiles[mip] + tile.y * tiles_x + tile.x];
+        const u16* values = reinterpret_cast<const u16*>(_mapping->data + offset);
+        return values[(texel.y % tile_size) * tile_size + texel.x % tile_size];
+    }
+
+    u32 HeightTileFile::region_mip(float texel_size) const
+    {
+        // Largest mip whose samples are at most as large as the texels, with some slack for rounding
+        const float ratio = texel_size / _header->texel_size;
+        u32 mip = 0;
+        while (mip + 1 < _header->mip_count && float(2u << mip) <= ratio * 1.001f)
+        {
+            ++mip;
+        }
+        return mip;
+    }
+
+    void HeightTileFile::read_region(const glm::ivec2& origin, const glm::uvec2& size, float texel_size,
+                                     const glm::vec2& scale_bias, u16* values) const
+    {
+        const u32 mip = region_mip(texel_size);
+        const float mip_scale = float(1u << mip);
+        // The world origin is at the center of the dataset, in samples of mip 0
+        const glm::vec2 center = glm::vec2(_header->width, _header->height) * 0.5f;
+        const float value_to_height = (_header->max_height - _header->min_height) / 65535.0f;
+        const float height_to_value = 65535.0f / scale_bias.x;
+
+        parallel_for(size.y, 16, [&](size_t begin, size_t end) {
+            for (size_t y = begin; y != end; ++y)
+            {
+                for (u32 x = 0; x != size.x; ++x)
+                {
+                    // Samples of mip m average 2^m samples of mip 0 per side and are centered on them
+                    const glm::vec2 world = glm::vec2(origin + glm::ivec2(x, y)) * texel_size;
+                    const glm::vec2 coord = (world / _header->texel_size + center) / mip_scale - 0.5f;
+                    const glm::ivec2 base = glm::ivec2(glm::floor(coord));
+                    const glm::vec2 t = coord - glm::vec2(base);
+
+                    const float v00 = float(sample(mip, base));
+                    const float v10 = float(sample(mip, base + glm::ivec2(1, 0)));
+                    const float v01 = float(sample(mip, base + glm::ivec2(0, 1)));
+                    const float v11 = float(sample(mip, base + glm::ivec2(1, 1)));
+                    const float value = glm::mix(glm::mix(v00, v10, t.x), glm::mix(v01, v11, t.x), t.y);
+
+                    const float height = value * value_to_height + _header->min_height;
+                    const float normalized = (height - scale_bias.y) * height_to_value;
+                    values[y * size.x + x] = u16(std::clamp(normalized, 0.0f, 65535.0f) + 0.5f);
+                }
+            }
+        });
+    }
+
+    void HeightTileFile::prefetch_region(const glm::ivec2& origin, const glm::uvec2& size, float texel_size) const
+    {
+        if (size.x == 0 || size.y == 0)
+        {
+            return;
+        }
+
+        // Samples filtered by the first and last texels, like read_region()
+        const u32 mip = region_mip(texel_size);
+        const float mip_scale = float(1u << mip);
+        const glm::vec2 center = glm::vec2(_header->width, _header->height) * 0.5f;
+        const auto sample_coord = [&](const glm::ivec2& texel) {
+            const glm::vec2 world = glm::vec2(texel) * texel_size;
+            return glm::ivec2(glm::floor((world / _header->texel_size + center) / mip_scale - 0.5f));
+        };
+        const glm::ivec2 first = sample_coord(origin);
+        const glm::ivec2 last = sample_coord(origin + glm::ivec2(size) - 1) + 1;
+
+        const glm::ivec2 dims = glm::ivec2(mip_size(glm::uvec2(_header->width, _header->height), mip));
+        if (last.x < 0 || last.y < 0 || first.x >= dims.x || first.y >= dims.y)
+        {
+            return;
+        }
+        const glm::uvec2 first_tile = glm::uvec2(glm::max(first, 0)) / tile_size;
+        const glm::uvec2 last_tile = glm::uvec2(glm::min(last, dims - 1)) / tile_size;
+        const u32 tiles_x = tile_count(glm::uvec2(dims)).x;
+
+#ifndef OS_WIN
+        static const uintptr_t page_mask = uintptr_t(sysconf(_SC_PAGESIZE)) - 1;
+#endif
+        for (u32 y = first_tile.y; y <= last_tile.y; ++y)
+        {
+            // Tiles of a row are usually contiguous in the file, they are prefetched together
+            const u32 row = _first_tiles[mip] + y * tiles_x;
+            u32 x = first_tile.x;
+            while (x <= last_tile.x)
+            {
+                const u64 begin = _tile_offsets[row + x];
+                u64 end = begin + tile_bytes;
+                for (++x; x <= last_tile.x && _tile_offsets[row + x] == end; ++x)
+                {
+                    end += tile_bytes;
+                }
+
+                u8* data = const_cast<u8*>(_mapping->data);
+#ifdef OS_WIN
+                WIN32_MEMORY_RANGE_ENTRY range = {data + begin, size_t(end - begin)};
+                PrefetchVirtualMemory(GetCurrentProcess(), 1, &range, 0);
+#else
+                // Ranges must start on a page
+                const uintptr_t first_page = reinterpret_cast<uintptr_t>(data + begin) & ~page_mask;
+                madvise(reinterpret_cast<void*>(first_page),
+                        size_t(reinterpret_cast<uintptr_t>(data + end) - first_page), MADV_WILLNEED);
+#endif
+            }
+        }
+    }
+
+} // namespace OM3D
@@ -0,0 +1,73 @@
+#ifndef HEIGHTTILEFILE_H
+#define HEIGHTTILEFILE_H
+
+#include <utils.h>
+
+#include <glm/glm.hpp>
+
+#include <memory>
+#include <string>
+
+namespace OM3D
+{
+
+    // Heightfield stored on disk as square tiles of 16 bit heights, with a mip pyramid so that distant areas read
+    // few tiles. The file starts with a header and an index of the offsets of the tiles of every mip, followed by the
+    // tiles, each aligned on a page. It is memory mapped: only the tiles that are sampled are paged in, and the system
+    // evicts the least recently used ones, so datasets don't need to fit in memory.
+    // The dataset is centered on the world origin and heights outside of it are its lowest height.
+    class HeightTileFile : NonCopyable
+    {
+    public:
+        // Samples per side of a tile
+        static constexpr u32 tile_size = 256;
+
+        struct ConvertSettings
+        {
+            // World size of a sample of the input
+            float texel_size = 1.0f;
+            // Heights of the smallest and largest input values
+            float min_height = 0.0f;
+            float max_height = 1000.0f;
+        };
+
+        ~HeightTileFile();
+
+        static Result<std::unique_ptr<HeightTileFile>> open(const std::string& file_name);
+        // Writes the tiles of a 16 bit grayscale PNG or of raw 16 bit little endian heights (which must be square)
+        static Result<void> convert(const std::string& input, const std::string& output,
+                                    const ConvertSettings& settings);
+
+        glm::uvec2 size() const;
+        float texel_size() const;
+        // Range of the heights of the dataset
+        glm::vec2 height_range() const;
+
+        // Normalized heights (height = value * scale + bias) of a region, in rows of size.x values. Texels are
+        // texel_size wide and bilinearly filtered from the mip whose samples are the closest smaller than them
+        void read_region(const glm::ivec2& origin, const glm::uvec2& size, float texel_size,
+                         const glm::vec2& scale_bias, u16* values) const;
+        // Asks the system to page in the tiles read_region() would read, without waiting for them
+        void prefetch_region(const glm::ivec2& origin, const glm::uvec2& size, float texel_size) const;
+
+    private:
+        struct Header;
+        struct Mapping;
+
+        HeightTileFile() = default;
+
+        // Mip read for texels texel_size wide
+        u32 region_mip(float texel_size) const;
+        // Value of a sample of a mip, 0 outside of the dataset
+        u16 sample(u32 mip, const glm::ivec2& coord) const;
+
+        std::unique_ptr<Mapping> _mapping;
+        const Header* _header = nullptr;
+        // Offsets of the tiles of all mips, and index of the first tile of each mip
+        const u64* _tile_offsets = nullptr;
+        std::unique_ptr<u32[]> _first_tiles;
+    };
+
+} // namespace OM3D
+
+#endif // HEIGHTTILEFILE_H
@@ -0,0 +1,106 @@
+#include "HeightTileLoader.h"
+
+namespace OM3D
+{
+
+    HeightTileLoader::HeightTileLoader(std::unique_ptr<HeightTileFile> file) :
+        _file(std::move(file))
+    {
+        _loader = std::thread([this] { load_batches(); });
+    }
+
+    HeightTileLoader::~HeightTileLoader()
+    {
+        {
+            // The batch being read is finished first, its tiles are mapped until the file is destroyed
+            std::lock_guard<std::mutex> lock(_mutex);
+            _stop = true;
+        }
+        _condition.notify_one();
+        _loader.join();
+    }
+
+    bool HeightTileLoader::is_busy() const
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        return _requested || _loading || _loaded;
+    }
+
+    void HeightTileLoader::request(std::vector<Read> reads, std::vector<Read> prefetched, const glm::vec2& scale_bias)
+    {
+        {
+            std::lock_guard<std::mutex> lock(_mutex);
+            DEBUG_ASSERT(!_requested && !_loading && !_loaded);
+            _batch.reads = std::move(reads);
+            _batch.prefetched = std::move(prefetched);
+            _batch.scale_bias = scale_bias;
+            _requested = true;
+        }
+        _condition.notify_one();
+    }
+
+    bool HeightTileLoader::take_values(std::vector<std::vector<u16>>& values)
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        if (!_loaded)
+        {
+            return false;
+        }
+        values = std::move(_batch.values);
+        _loaded = false;
+        return true;
+    }
+
+    void HeightTileLoader::cancel()
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        _requested = false;
+        _loaded = false;
+        _discard = _loading;
+    }
+
+    void HeightTileLoader::load_batches()
+    {
+        std::unique_lock<std::mutex> lock(_mutex);
+        while (true)
+        {
+            _condition.wait(lock, [this] { return _stop || _requested; });
+            if (_stop)
+            {
+                return;
+            }
+
+            Batch batch = std::move(_batch);
+            _requested = false;
+            _loading = true;
+            lock.unlock();
+
+            // The system pages the tiles of the whole batch in at once instead of faulting them one by one
+            for (const Read& read: batch.reads)
+            {
+                _file->prefetch_region(read.origin, read.size, read.texel_size);
+            }
+            batch.values.resize(batch.reads.size());
+            for (size_t i = 0; i != batch.reads.size(); ++i)
+            {
+                const Read& read = batch.reads[i];
+                batch.values[i].resize(size_t(read.size.x) * read.size.y);
+                _file->read_region(read.origin, read.size, read.texel_size, batch.scale_bias, batch.values[i].data());
+            }
+            for (const Read& read: batch.prefetched)
+            {
+                _file->prefetch_region(read.origin, read.size, read.texel_size);
+            }
+
+            lock.lock();
+            _loading = false;
+            if (!_discard)
+            {
+                _batch.values = std::move(batch.values);
+                _loaded = true;
+            }
+            _discard = false;
+        }
+    }
+
+} // namespace OM3D
@@ -0,0 +1,71 @@
+#ifndef HEIGHTTILELOADER_H
+#define HEIGHTTILELOADER_H
+
+#include <HeightTileFile.h>
+
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace OM3D
+{
+
+    // Reads the regions of a heightfield on a background thread, so that paging its tiles in never stalls the render
+    // thread. Reads are requested in batches, one at a time: the tiles of the whole batch are prefetched before they
+    // are read, and after it the tiles around the windows the next batches will likely read.
+    class HeightTileLoader : NonCopyable
+    {
+    public:
+        // Region of texels texel_size wide, see HeightTileFile::read_region()
+        struct Read
+        {
+            glm::ivec2 origin = {};
+            glm::uvec2 size = {};
+            float texel_size = 1.0f;
+        };
+
+        HeightTileLoader(std::unique_ptr<HeightTileFile> file);
+        ~HeightTileLoader();
+
+        const HeightTileFile& file() const { return *_file; }
+
+        // Whether a batch is requested and its values haven't been taken yet
+        bool is_busy() const;
+
+        // Queues a batch of reads, values are normalized with scale_bias. The prefetched regions are only paged in
+        void request(std::vector<Read> reads, std::vector<Read> prefetched, const glm::vec2& scale_bias);
+        // Values of every read of the batch once it is loaded, in the order of the request
+        bool take_values(std::vector<std::vector<u16>>& values);
+        // Drops the requested batch, a batch being read is discarded once done
+        void cancel();
+
+    private:
+        struct Batch
+        {
+            std::vector<Read> reads;
+            std::vector<Read> prefetched;
+            glm::vec2 scale_bias = {};
+            std::vector<std::vector<u16>> values;
+        };
+
+        // Body of the loader thread, returns when the loader is destroyed
+        void load_batches();
+
+        std::unique_ptr<HeightTileFile> _file;
+
+        std::thread _loader;
+        mutable std::mutex _mutex;
+        std::condition_variable _condition;
+        Batch _batch;
+        bool _requested = false;
+        bool _loading = false;
+        bool _loaded = false;
+        bool _discard = false;
+        bool _stop = false;
+    };
+
+} // namespace OM3D
+
+#endif // HEIGHTTILELOADER_H
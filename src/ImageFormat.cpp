@@ -19,12 +19,20 @@ namespace OM3D
                 return ImageFormatGL{GL_RGB, GL_SRGB8, GL_UNSIGNED_BYTE};
             case ImageFormat::RG16_UNORM:
                 return ImageFormatGL{GL_RG, GL_RG16, GL_UNSIGNED_SHORT};
+            case ImageFormat::RG16_FLOAT:
+                return ImageFormatGL{GL_RG, GL_RG16F, GL_FLOAT};
+            case ImageFormat::R16_UNORM:
+                return ImageFormatGL{GL_RED, GL_R16, GL_UNSIGNED_SHORT};
+            case ImageFormat::R16_FLOAT:
+                return ImageFormatGL{GL_RED, GL_R16F, GL_FLOAT};
             case ImageFormat::RGBA16_FLOAT:
                 return ImageFormatGL{GL_RGBA, GL_RGBA16F, GL_FLOAT};
             case ImageFormat::Depth32_FLOAT:
                 return ImageFormatGL{GL_DEPTH_COMPONENT, GL_DEPTH_COMPONENT32F, GL_FLOAT};
             case ImageFormat::R32_FLOAT:
                 return ImageFormatGL{GL_RED, GL_R32F, GL_FLOAT};
+            case ImageFormat::R32_UINT:
+                return ImageFormatGL{GL_RED_INTEGER, GL_R32UI, GL_UNSIGNED_INT};
             case ImageFormat::RGBA32_FLOAT:
                 return ImageFormatGL{GL_RGBA, GL_RGBA32F, GL_FLOAT};
         }
@@ -32,4 +40,33 @@ namespace OM3D
         FATAL("Unknown image format");
     }
 
+    u32 bytes_per_texel(ImageFormat format)
+    {
+        switch (format)
+        {
+            case ImageFormat::R16_UNORM:
+            case ImageFormat::R16_FLOAT:
+                return 2;
+            case ImageFormat::RGB8_UNORM:
+            case ImageFormat::RGB8_sRGB:
+                return 3;
+            case ImageFormat::RGBA8_UNORM:
+            case ImageFormat::RGBA8_sRGB:
+            case ImageFormat::RG16_UNORM:
+            case ImageFormat::RG16_FLOAT:
+            case ImageFormat::R32_FLOAT:
+            case ImageFormat::R32_UINT:
+            case ImageFormat::Depth32_FLOAT:
+                return 4;
+            case ImageFormat::RGBA16_FLOAT:
+                return 8;
+            case ImageFormat::RGBA32_FLOAT:
+                return 16;
+        }
+
+        FATAL("Unknown image format");
+    }
+
+    bool is_integer(ImageFormat format) { return format == ImageFormat::R32_UINT; }
+
 } // namespace OM3D
@@ -14,8 +14,12 @@ namespace OM3D
         RGB8_sRGB,
 
         RG16_UNORM,
+        RG16_FLOAT,
 
+        R16_UNORM,
+        R16_FLOAT,
         R32_FLOAT,
+        R32_UINT,
         RGBA16_FLOAT,
         RGBA32_FLOAT,
         Depth32_FLOAT
@@ -30,6 +34,9 @@ namespace OM3D
     };
 
     ImageFormatGL image_format_to_gl(ImageFormat format);
+    u32 bytes_per_texel(ImageFormat format);
+    // Integer formats can't be filtered and are read with usampler/isampler
+    bool is_integer(ImageFormat format);
 
 } // namespace OM3D
 
@@ -0,0 +1,76 @@
+#include "LightClusters.h"
+
+#include <glad/gl.h>
+
+namespace OM3D
+{
+
+    LightClusters::LightClusters() : _cull_program(Program::from_file("light_cull.comp"))
+    {
+        _counter_buffer = std::make_unique<TypedBuffer<u32>>(nullptr, 1);
+    }
+
+    void LightClusters::set_depth_range(float near, float far)
+    {
+        DEBUG_ASSERT(near > 0.0f && far > near);
+        _near = near;
+        _far = far;
+    }
+
+    void LightClusters::resize(glm::uvec2 screen_size)
+    {
+        _screen_size = screen_size;
+
+        _tiles = (screen_size + glm::uvec2(tile_size - 1)) / tile_size;
+
+        // Buffers only grow, so that the screen size can change every frame (dynamic resolution)
+        if (cluster_count() > _capacity)
+        {
+            _capacity = cluster_count();
+
+            // Each cluster stores an (offset, count) pair
+            _cluster_buffer = std::make_unique<ByteBuffer>(nullptr, _capacity * sizeof(glm::uvec2));
+            _index_buffer = std::make_unique<TypedBuffer<u32>>(nullptr, _capacity * average_lights_per_cluster);
+        }
+    }
+
+    void LightClusters::update(const Scene& scene)
+    {
+        DEBUG_ASSERT(_cluster_buffer && _index_buffer);
+
+        const Camera& camera = scene.camera();
+        _view = camera.view_matrix();
+
+        _counter_buffer->clear();
+
+        _cull_program->bind();
+        set_common_uniforms(*_cull_program);
+        _cull_program->set_uniform(HASH("cluster_inv_proj"), glm::inverse(camera.projection_matrix()));
+        _cull_program->set_uniform(HASH("cluster_screen_size"), glm::vec2(_screen_size));
+        _cull_program->set_uniform(HASH("light_count"), u32(scene.point_lights().size()));
+
+        _cluster_buffer->bind(BufferUsage::Storage, 3);
+        _index_buffer->bind(BufferUsage::Storage, 4);
+        _counter_buffer->bind(BufferUsage::Storage, 5);
+
+        glDispatchCompute(_tiles.x, _tiles.y, 1);
+    }
+
+    void LightClusters::bind(Program& program) const
+    {
+        DEBUG_ASSERT(_cluster_buffer && _index_buffer);
+
+        set_common_uniforms(program);
+        _cluster_buffer->bind(BufferUsage::Storage, 3);
+        _index_buffer->bind(BufferUsage::Storage, 4);
+    }
+
+    void LightClusters::set_common_uniforms(Program& program) const
+    {
+        program.set_uniform(HASH("cluster_view"), _view);
+        program.set_uniform(HASH("cluster_tiles"), _tiles);
+        program.set_uniform(HASH("cluster_near"), _near);
+        program.set_uniform(HASH("cluster_far"), _far);
+    }
+
+} // namespace OM3D
@@ -0,0 +1,68 @@
+#ifndef LIGHTCLUSTERS_H
+#define LIGHTCLUSTERS_H
+
+#include <Program.h>
+#include <Scene.h>
+#include <TypedBuffer.h>
+
+#include <glm/vec2.hpp>
+
+#include <memory>
+
+namespace OM3D
+{
+
+    // Assigns point lights to a froxel grid (screen tiles x exponential depth slices)
+    // so that deferred shading only loops over the lights affecting each pixel.
+    class LightClusters : NonMovable
+    {
+    public:
+        // Must match clusters.glsl
+        static constexpr u32 tile_size = 64;
+        static constexpr u32 slice_count = 24;
+        static constexpr u32 max_lights_per_cluster = 256;
+
+        // Average number of light indices allocated per cluster
+        static constexpr u32 average_lights_per_cluster = 64;
+
+        LightClusters();
+
+        // Set the screen size, the cluster buffers are reallocated if they are too small
+        void resize(glm::uvec2 screen_size);
+
+        // Expects the scene point lights to be bound (Scene::bind_buffer_pl).
+        // Results are written to storage buffers, a barrier is needed before reading them.
+        void update(const Scene& scene);
+
+        // Bind cluster buffers and set the cluster uniforms of a shading program
+        void bind(Program& program) const;
+
+        glm::uvec2 tile_count() const { return _tiles; }
+        u32 cluster_count() const { return _tiles.x * _tiles.y * slice_count; }
+
+        void set_depth_range(float near, float far);
+
+        ByteBuffer& cluster_buffer() { return *_cluster_buffer; }
+        ByteBuffer& index_buffer() { return *_index_buffer; }
+
+    private:
+        void set_common_uniforms(Program& program) const;
+
+        std::shared_ptr<Program> _cull_program;
+
+        std::unique_ptr<ByteBuffer> _cluster_buffer;
+        std::unique_ptr<TypedBuffer<u32>> _index_buffer;
+        std::unique_ptr<TypedBuffer<u32>> _counter_buffer;
+
+        glm::uvec2 _screen_size = {};
+        glm::uvec2 _tiles = {};
+        u32 _capacity = 0;
+        glm::mat4 _view = glm::mat4(1.0f);
+
+        float _near = 0.1f;
+        float _far = 1000.0f;
+    };
+
+} // namespace OM3D
+
+#endif // LIGHTCLUSTERS_H
@@ -35,6 +35,32 @@ namespace OM3D
 
     bool Material::is_opaque() const { return _blend_mode == BlendMode::None; }
 
+    bool Material::is_alpha_tested() const { return _alpha_test; }
+
+    const Texture* Material::texture(u32 slot) const
+    {
+        for (const auto& [s, tex]: _textures)
+        {
+            if (s == slot)
+            {
+                return tex.get();
+            }
+        }
+        return nullptr;
+    }
+
+    const UniformValue* Material::stored_uniform(u32 name_hash) const
+    {
+        for (const auto& [h, v]: _uniforms)
+        {
+            if (h == name_hash)
+            {
+                return &v;
+            }
+        }
+        return nullptr;
+    }
+
     void Material::set_stored_uniform(u32 name_hash, UniformValue value)
     {
         for (auto& [h, v]: _uniforms)
@@ -68,13 +94,20 @@ namespace OM3D
                 break;
 
             case BlendMode::Additive:
-                glEnable(GL_CULL_FACE);
-                glCullFace(GL_FRONT);
-                glFrontFace(GL_CCW);
+                // Additive materials are full-screen light passes, which would be culled by front face culling
+                glDisable(GL_CULL_FACE);
 
                 glEnable(GL_BLEND);
                 glBlendFunc(GL_ONE, GL_ONE);
                 break;
+
+            case BlendMode::WeightedBlended:
+                glDisable(GL_CULL_FACE);
+
+                glEnable(GL_BLEND);
+                glBlendFunci(0, GL_ONE, GL_ONE);
+                glBlendFunci(1, GL_ZERO, GL_ONE_MINUS_SRC_COLOR);
+                break;
         }
 
         switch (_depth_test_mode)
@@ -117,6 +150,25 @@ namespace OM3D
         _program->bind();
     }
 
+    void Material::bind_alpha_mask(Program& program) const
+    {
+        for (const auto& texture: _textures)
+        {
+            if (texture.first == 0u)
+            {
+                texture.second->bind(0);
+            }
+        }
+
+        for (const auto& [h, v]: _uniforms)
+        {
+            if (h == HASH("alpha_cutoff"))
+            {
+                program.set_uniform(h, v);
+            }
+        }
+    }
+
     Material Material::textured_pbr_material(bool alpha_test)
     {
         Material material;
@@ -126,7 +178,26 @@ namespace OM3D
         {
             defines.emplace_back("ALPHA_TEST");
         }
+        material._alpha_test = alpha_test;
+        material._program = Program::from_files("lit.frag", "basic.vert", defines);
+
+        material.set_texture(0u, default_white_texture());
+        material.set_texture(1u, default_normal_texture());
+        material.set_texture(2u, default_metal_rough_texture());
+        material.set_texture(3u, default_white_texture());
+
+        return material;
+    }
+
+    Material Material::transparent_material()
+    {
+        Material material;
+
+        const std::vector<std::string> defines = {"WEIGHTED_OIT"};
         material._program = Program::from_files("lit.frag", "basic.vert", defines);
+        material.set_blend_mode(BlendMode::WeightedBlended);
+        // Tested against the opaque depth, transparent surfaces don't occlude each other
+        material.set_depth_write(false);
 
         material.set_texture(0u, default_white_texture());
         material.set_texture(1u, default_normal_texture());
@@ -145,6 +216,7 @@ namespace OM3D
         {
             defines.emplace_back("ALPHA_TEST");
         }
+        material._alpha_test = alpha_test;
         material._program = Program::from_files("gbuffer.frag", "gbuffer.vert", defines);
 
         material.set_texture(0u, default_white_texture());
@@ -155,12 +227,17 @@ namespace OM3D
         return material;
     }
 
-    Material Material::point_light_material()
+    Material Material::point_light_material(bool debug_heatmap)
     {
         Material material;
 
-        material._program = Program::from_files("pl.frag", "screen.vert");
-        material.set_blend_mode(BlendMode::Additive);
+        std::vector<std::string> defines;
+        if (debug_heatmap)
+        {
+            defines.emplace_back("CLUSTER_HEATMAP");
+        }
+        material._program = Program::from_files("pl.frag", "screen.vert", defines);
+        material.set_blend_mode(debug_heatmap ? BlendMode::Alpha : BlendMode::Additive);
         material.set_depth_test_mode(DepthTestMode::None);
         material.set_depth_write(false);
 
@@ -15,6 +15,9 @@ namespace OM3D
         None,
         Alpha,
         Additive,
+        // Weighted blended order-independent transparency: accumulation in the first attachment, revealage in the
+        // second
+        WeightedBlended,
     };
 
     enum class DepthTestMode
@@ -39,6 +42,11 @@ namespace OM3D
         void set_texture(u32 slot, std::shared_ptr<Texture> tex);
 
         bool is_opaque() const;
+        bool is_alpha_tested() const;
+
+        // nullptr if no texture or uniform was set
+        const Texture* texture(u32 slot) const;
+        const UniformValue* stored_uniform(u32 name_hash) const;
 
         // Uniform will be stored inside the material and reset every time its bound
         void set_stored_uniform(u32 name_hash, UniformValue value);
@@ -50,11 +58,18 @@ namespace OM3D
             _program->set_uniform(FWD(args)...);
         }
 
+        Program& program() const { return *_program; }
+
         void bind() const;
 
+        // Only binds what a depth only alpha test needs: the base color texture and the alpha cutoff
+        void bind_alpha_mask(Program& program) const;
+
         static Material textured_pbr_material(bool alpha_test = false);
+        // Forward shaded transparent surfaces, rendered with weighted blended OIT
+        static Material transparent_material();
         static Material gbuffer_material(bool alpha_test = false);
-        static Material point_light_material();
+        static Material point_light_material(bool debug_heatmap = false);
 
     private:
         std::shared_ptr<Program> _program;
@@ -65,6 +80,7 @@ namespace OM3D
         DepthTestMode _depth_test_mode = DepthTestMode::Standard;
         bool _depth_write = true;
         bool _double_sided = false;
+        bool _alpha_test = false;
     };
 
 } // namespace OM3D
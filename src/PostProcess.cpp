@@ -0,0 +1,122 @@
+#include "PostProcess.h"
+
+#include <graphics.h>
+
+#include <glad/gl.h>
+
+#include <iostream>
+#include <vector>
+
+namespace OM3D
+{
+
+    static constexpr u32 neutral_lut_size = 16;
+
+    const char* PostProcess::tone_mapping_name(ToneMapping tone_mapping)
+    {
+        switch (tone_mapping)
+        {
+            case ToneMapping::ACES:
+                return "ACES";
+            case ToneMapping::Reinhard:
+                return "Reinhard";
+            case ToneMapping::None:
+                return "None";
+            case ToneMapping::Count:
+                break;
+        }
+
+        FATAL("Unknown tone mapping operator");
+    }
+
+    PostProcess::PostProcess()
+    {
+        TextureData data;
+        data.format = ImageFormat::RGBA8_UNORM;
+        data.size = glm::uvec2(neutral_lut_size * neutral_lut_size, neutral_lut_size);
+        data.data = std::make_unique<u8[]>(data.size.x * data.size.y * 4);
+        for (u32 y = 0; y != data.size.y; ++y)
+        {
+            for (u32 x = 0; x != data.size.x; ++x)
+            {
+                u8* texel = &data.data[(y * data.size.x + x) * 4];
+                texel[0] = u8((x % neutral_lut_size) * 255 / (neutral_lut_size - 1));
+                texel[1] = u8(y * 255 / (neutral_lut_size - 1));
+                texel[2] = u8((x / neutral_lut_size) * 255 / (neutral_lut_size - 1));
+                texel[3] = 255;
+            }
+        }
+        _lut = std::make_unique<Texture>(data);
+    }
+
+    bool PostProcess::load_color_grading_lut(const std::string& file_name)
+    {
+        auto res = TextureData::from_file(file_name);
+        if (!res.is_ok)
+        {
+            std::cerr << "Unable to load color grading LUT (" << file_name << ")" << std::endl;
+            return false;
+        }
+
+        const glm::uvec2 size = res.value.size;
+        if (size.y < 2 || size.x != size.y * size.y)
+        {
+            std::cerr << "Invalid color grading LUT size (" << size.x << "x" << size.y << "), expected N²xN"
+                      << std::endl;
+            return false;
+        }
+
+        _lut = std::make_unique<Texture>(res.value);
+        return true;
+    }
+
+    void PostProcess::render(const Texture& hdr, glm::uvec2 source_size, const Settings& settings)
+    {
+        const u32 variant =
+                (u32(settings.tone_mapping) * 2 + u32(settings.color_grading)) * 2 + u32(settings.dithering);
+        std::shared_ptr<Program>& program = _programs[variant];
+        if (!program)
+        {
+            std::vector<std::string> defines;
+            switch (settings.tone_mapping)
+            {
+                case ToneMapping::ACES:
+                    defines.emplace_back("TONE_MAPPING_ACES");
+                    break;
+                case ToneMapping::Reinhard:
+                    defines.emplace_back("TONE_MAPPING_REINHARD");
+                    break;
+                default:
+                    break;
+            }
+            if (settings.color_grading)
+            {
+                defines.emplace_back("COLOR_GRADING");
+            }
+            if (settings.dithering)
+            {
+                defines.emplace_back("DITHERING");
+            }
+            program = Program::from_files("post.frag", "screen.vert", defines);
+        }
+
+        glBindFramebuffer(GL_FRAMEBUFFER, 0);
+        glDisable(GL_DEPTH_TEST); // In case glfw gives us a depth buffer
+        glDisable(GL_BLEND);
+
+        program->bind();
+        program->set_uniform(HASH("exposure"), settings.exposure);
+        program->set_uniform(HASH("auto_exposure"), u32(settings.auto_exposure));
+        program->set_uniform(HASH("source_size"), source_size);
+        program->set_uniform(HASH("upscale_filter"), settings.upscale_filter);
+
+        hdr.bind(0);
+        if (settings.color_grading)
+        {
+            _lut->bind(1);
+        }
+
+        draw_full_screen_triangle();
+    }
+
+} // namespace OM3D
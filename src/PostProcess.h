@@ -0,0 +1,66 @@
+#ifndef POSTPROCESS_H
+#define POSTPROCESS_H
+
+#include <Program.h>
+#include <Texture.h>
+
+#include <glm/vec2.hpp>
+
+#include <array>
+#include <memory>
+#include <string>
+
+namespace OM3D
+{
+
+    // Final full screen pass, from the HDR image to the screen: upscaling, exposure, tone mapping, color grading and
+    // dithering are fused in a single shader writing the default framebuffer.
+    // The enabled steps are compiled in (one program per combination, created on first use and kept).
+    class PostProcess : NonMovable
+    {
+    public:
+        enum class ToneMapping : u32
+        {
+            ACES,
+            Reinhard,
+            None,
+
+            Count,
+        };
+
+        struct Settings
+        {
+            ToneMapping tone_mapping = ToneMapping::ACES;
+            // Applied after tone mapping, in sRGB
+            bool color_grading = false;
+            // Breaks banding in smooth gradients (e.g. the sky) by adding noise below the 8 bit quantization step
+            bool dithering = true;
+
+            // Manual exposure, used unless auto_exposure is set (the exposure storage buffer must then be bound)
+            float exposure = 1.0f;
+            bool auto_exposure = false;
+
+            // 0 = bilinear, 1 = edge-aware
+            u32 upscale_filter = 0;
+        };
+
+        static const char* tone_mapping_name(ToneMapping tone_mapping);
+
+        PostProcess();
+
+        // Draws the top left source_size texels of hdr to the whole viewport of the default framebuffer
+        void render(const Texture& hdr, glm::uvec2 source_size, const Settings& settings);
+
+        // Strip of N slices of NxN texels (N² x N), e.g. 256x16. Neutral (identity) LUT by default.
+        bool load_color_grading_lut(const std::string& file_name);
+
+    private:
+        static constexpr u32 variant_count = u32(ToneMapping::Count) * 2 * 2;
+
+        std::array<std::shared_ptr<Program>, variant_count> _programs;
+        std::unique_ptr<Texture> _lut;
+    };
+
+} // namespace OM3D
+
+#endif // POSTPROCESS_H
@@ -240,8 +240,15 @@ namespace OM3D
 
             glGetActiveUniform(_handle.get(), i, sizeof(name), &len, &discard, &type, name);
 
+            // Arrays are reported as "name[0]", refer to them by their name only
+            std::string_view hashed_name(name, len);
+            if (ends_with(hashed_name, "[0]"))
+            {
+                hashed_name.remove_suffix(3);
+            }
+
             _uniform_locations.emplace_back(
-                    UniformLocationInfo{str_hash(name), glGetUniformLocation(_handle.get(), name)});
+                    UniformLocationInfo{str_hash(hashed_name), glGetUniformLocation(_handle.get(), name)});
         }
 
         std::sort(_uniform_locations.begin(), _uniform_locations.end());
@@ -367,6 +374,14 @@ namespace OM3D
         }
     }
 
+    void Program::set_uniform(u32 name_hash, glm::uvec2 value)
+    {
+        if (const int loc = find_location(name_hash); loc >= 0)
+        {
+            glProgramUniform2ui(_handle.get(), loc, value.x, value.y);
+        }
+    }
+
     void Program::set_uniform(u32 name_hash, glm::vec3 value)
     {
         if (const int loc = find_location(name_hash); loc >= 0)
@@ -422,6 +437,23 @@ namespace OM3D
         std::visit([name_hash, this](const auto& v) { set_uniform(name_hash, v); }, value);
     }
 
+    void Program::set_uniform(u32 name_hash, Span<const glm::vec4> values)
+    {
+        if (const int loc = find_location(name_hash); loc >= 0)
+        {
+            glProgramUniform4fv(_handle.get(), loc, int(values.size()), reinterpret_cast<const float*>(values.data()));
+        }
+    }
+
+    void Program::set_uniform(u32 name_hash, Span<const glm::mat4> values)
+    {
+        if (const int loc = find_location(name_hash); loc >= 0)
+        {
+            glProgramUniformMatrix4fv(_handle.get(), loc, int(values.size()), false,
+                                      reinterpret_cast<const float*>(values.data()));
+        }
+    }
+
     void Program::set_uniform(u32 name_hash, Frustum value)
     {
         // Set each vec3 component of the Frustum struct
@@ -61,6 +61,7 @@ namespace OM3D
         void set_uniform(u32 name_hash, i32 value); // For sampler uniforms
         void set_uniform(u32 name_hash, float value);
         void set_uniform(u32 name_hash, glm::vec2 value);
+        void set_uniform(u32 name_hash, glm::uvec2 value);
         void set_uniform(u32 name_hash, glm::vec3 value);
         void set_uniform(u32 name_hash, glm::vec4 value);
         void set_uniform(u32 name_hash, const glm::mat2& value);
@@ -69,6 +70,10 @@ namespace OM3D
         void set_uniform(u32 name_hash, u64 value);
 
         void set_uniform(u32 name_hash, const UniformValue& value);
+
+        // Uniform arrays
+        void set_uniform(u32 name_hash, Span<const glm::vec4> values);
+        void set_uniform(u32 name_hash, Span<const glm::mat4> values);
         void set_uniform(u32 name_hash, Frustum value);
 
         template<typename T>
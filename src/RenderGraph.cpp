@@ -0,0 +1,468 @@
+#include "RenderGraph.h"
+
+#include <TimestampQuery.h>
+
+#include <glad/gl.h>
+
+#include <glm/common.hpp>
+
+#include <algorithm>
+
+namespace OM3D
+{
+
+    // Number of frames a pooled texture is kept around without being used (e.g. when a debug view is toggled)
+    static constexpr u64 pool_texture_lifetime = 8;
+
+    static bool is_incoherent_write(RenderGraph::Access access)
+    {
+        return access == RenderGraph::Access::ImageStore || access == RenderGraph::Access::StorageWrite;
+    }
+
+    static bool is_attachment(RenderGraph::Access access)
+    {
+        return access == RenderGraph::Access::ColorAttachment || access == RenderGraph::Access::DepthAttachment;
+    }
+
+    // Barrier making incoherent writes visible to a given access
+    static u32 barrier_bits(RenderGraph::Access access)
+    {
+        switch (access)
+        {
+            case RenderGraph::Access::Sampled:
+                return GL_TEXTURE_FETCH_BARRIER_BIT;
+
+            case RenderGraph::Access::ColorAttachment:
+            case RenderGraph::Access::DepthAttachment:
+                return GL_FRAMEBUFFER_BARRIER_BIT;
+
+            case RenderGraph::Access::ImageLoad:
+            case RenderGraph::Access::ImageStore:
+                return GL_SHADER_IMAGE_ACCESS_BARRIER_BIT;
+
+            case RenderGraph::Access::StorageRead:
+            case RenderGraph::Access::StorageWrite:
+                return GL_SHADER_STORAGE_BARRIER_BIT;
+
+            case RenderGraph::Access::Uniform:
+                return GL_UNIFORM_BARRIER_BIT;
+        }
+
+        FATAL("Unknown access value");
+    }
+
+    // Pooled textures are allocated in steps of this many pixels and used through a viewport of the requested size,
+    // so resizing the window only reallocates render targets when it crosses a step
+    static constexpr u32 size_class_granularity = 256;
+
+    static RenderGraph::TextureDesc size_class(const RenderGraph::TextureDesc& desc)
+    {
+        const glm::uvec2 size = glm::max(desc.size, desc.max_size);
+        const glm::uvec2 steps = (size + (size_class_granularity - 1)) / size_class_granularity;
+        return {steps * size_class_granularity, desc.format};
+    }
+
+    static u64 texture_bytes(const RenderGraph::TextureDesc& desc)
+    {
+        return u64(desc.size.x) * u64(desc.size.y) * bytes_per_texel(desc.format);
+    }
+
+
+    RenderGraph::Resource RenderGraph::PassBuilder::create_texture(const std::string& name, const TextureDesc& desc)
+    {
+        DEBUG_ASSERT(desc.size.x > 0 && desc.size.y > 0);
+
+        ResourceNode& node = _graph._resources.emplace_back();
+        node.name = name;
+        node.desc = desc;
+        return Resource{u32(_graph._resources.size() - 1)};
+    }
+
+    void RenderGraph::PassBuilder::read(Resource resource, Access access)
+    {
+        DEBUG_ASSERT(resource.index < _graph._resources.size());
+        _graph._passes[_pass].usages.push_back({resource.index, access, false});
+    }
+
+    void RenderGraph::PassBuilder::write(Resource resource, Access access)
+    {
+        DEBUG_ASSERT(resource.index < _graph._resources.size());
+        DEBUG_ASSERT(access != Access::Sampled && access != Access::Uniform);
+        _graph._passes[_pass].usages.push_back({resource.index, access, true});
+    }
+
+    void RenderGraph::PassBuilder::set_side_effect() { _graph._passes[_pass].side_effect = true; }
+
+
+    Texture& RenderGraph::PassContext::texture(Resource resource) const { return _graph.texture(resource.index); }
+
+    ByteBuffer& RenderGraph::PassContext::buffer(Resource resource) const
+    {
+        DEBUG_ASSERT(resource.index < _graph._resources.size());
+        ByteBuffer* buffer = _graph._resources[resource.index].imported_buffer;
+        DEBUG_ASSERT(buffer);
+        return *buffer;
+    }
+
+    glm::uvec2 RenderGraph::PassContext::size(Resource resource) const { return _graph.size(resource.index); }
+
+    void RenderGraph::PassContext::bind_framebuffer(bool clear_depth, bool clear_color) const
+    {
+        _graph.pass_framebuffer(_pass).bind(clear_depth, clear_color);
+
+        // Pooled textures can be larger than requested
+        const glm::uvec2 viewport = _graph.pass_size(_pass);
+        glViewport(0, 0, viewport.x, viewport.y);
+    }
+
+
+    void RenderGraph::reset()
+    {
+        _passes.clear();
+        _resources.clear();
+        _frame_framebuffers.clear();
+        _compiled = false;
+    }
+
+    RenderGraph::Resource RenderGraph::import_texture(const std::string& name, Texture& texture)
+    {
+        ResourceNode& node = _resources.emplace_back();
+        node.name = name;
+        node.imported_texture = &texture;
+        return Resource{u32(_resources.size() - 1)};
+    }
+
+    RenderGraph::Resource RenderGraph::import_buffer(const std::string& name, ByteBuffer& buffer)
+    {
+        ResourceNode& node = _resources.emplace_back();
+        node.name = name;
+        node.imported_buffer = &buffer;
+        return Resource{u32(_resources.size() - 1)};
+    }
+
+    void RenderGraph::add_pass(const std::string& name, const SetupFunc& setup, const ExecuteFunc& execute)
+    {
+        DEBUG_ASSERT(!_compiled);
+
+        Pass& pass = _passes.emplace_back();
+        pass.name = name;
+        pass.execute = execute;
+
+        PassBuilder builder(*this, u32(_passes.size() - 1));
+        setup(builder);
+    }
+
+    void RenderGraph::compile()
+    {
+        DEBUG_ASSERT(!_compiled);
+
+        ++_frame;
+
+        // Passes are declared in execution order: walk them backward and keep the ones producing something needed
+        std::vector<bool> needed(_resources.size(), false);
+        for (auto it = _passes.rbegin(); it != _passes.rend(); ++it)
+        {
+            Pass& pass = *it;
+            const auto is_needed = [&](const Usage& usage) { return usage.write && needed[usage.resource]; };
+            pass.culled = !pass.side_effect && std::none_of(pass.usages.begin(), pass.usages.end(), is_needed);
+            if (pass.culled)
+            {
+                continue;
+            }
+
+            for (const Usage& usage: pass.usages)
+            {
+                // Attachments are also read: blending, depth test, or simply keeping what isn't overwritten
+                if (!usage.write || is_attachment(usage.access))
+                {
+                    needed[usage.resource] = true;
+                }
+            }
+        }
+
+        for (u32 i = 0; i != _passes.size(); ++i)
+        {
+            if (_passes[i].culled)
+            {
+                continue;
+            }
+
+            for (const Usage& usage: _passes[i].usages)
+            {
+                ResourceNode& node = _resources[usage.resource];
+                node.first_pass = std::min(node.first_pass, i);
+                node.last_pass = std::max(node.last_pass, i);
+            }
+        }
+
+        allocate_transients();
+        compute_barriers();
+
+        _compiled = true;
+    }
+
+    void RenderGraph::allocate_transients()
+    {
+        std::vector<bool> in_use(_pool.size(), false);
+
+        _requested_bytes = 0;
+        for (u32 i = 0; i != _passes.size(); ++i)
+        {
+            if (_passes[i].culled)
+            {
+                continue;
+            }
+
+            for (ResourceNode& node: _resources)
+            {
+                if (node.imported_texture || node.imported_buffer || node.first_pass != i)
+                {
+                    continue;
+                }
+
+                const TextureDesc allocated_desc = size_class(node.desc);
+                _requested_bytes += texture_bytes(allocated_desc);
+
+                for (u32 p = 0; p != _pool.size(); ++p)
+                {
+                    if (!in_use[p] && _pool[p].desc == allocated_desc)
+                    {
+                        node.pool_index = p;
+                        break;
+                    }
+                }
+
+                if (node.pool_index == u32(-1))
+                {
+                    PooledTexture& pooled = _pool.emplace_back();
+                    pooled.desc = allocated_desc;
+                    pooled.texture =
+                            std::make_unique<Texture>(allocated_desc.size, allocated_desc.format, WrapMode::Clamp);
+                    in_use.push_back(false);
+                    node.pool_index = u32(_pool.size() - 1);
+                }
+
+                in_use[node.pool_index] = true;
+                _pool[node.pool_index].last_used_frame = _frame;
+            }
+
+            // Textures whose last use is this pass can be reused by the following ones
+            for (const ResourceNode& node: _resources)
+            {
+                if (node.pool_index != u32(-1) && node.last_pass == i)
+                {
+                    in_use[node.pool_index] = false;
+                }
+            }
+        }
+
+        // Drop textures that haven't been used for a while (e.g. after a resize)
+        const auto is_stale = [&](const PooledTexture& pooled)
+        { return pooled.last_used_frame + pool_texture_lifetime < _frame; };
+        if (std::any_of(_pool.begin(), _pool.end(), is_stale))
+        {
+            // Indices and GL names are about to change
+            _framebuffers.clear();
+
+            std::vector<u32> remap(_pool.size(), u32(-1));
+            std::vector<PooledTexture> kept;
+            for (u32 p = 0; p != _pool.size(); ++p)
+            {
+                if (!is_stale(_pool[p]))
+                {
+                    remap[p] = u32(kept.size());
+                    kept.push_back(std::move(_pool[p]));
+                }
+            }
+            _pool = std::move(kept);
+
+            for (ResourceNode& node: _resources)
+            {
+                if (node.pool_index != u32(-1))
+                {
+                    node.pool_index = remap[node.pool_index];
+                }
+            }
+        }
+
+        _allocated_bytes = 0;
+        for (const PooledTexture& pooled: _pool)
+        {
+            if (pooled.last_used_frame == _frame)
+            {
+                _allocated_bytes += texture_bytes(pooled.desc);
+            }
+        }
+    }
+
+    const Framebuffer& RenderGraph::pass_framebuffer(u32 pass_index)
+    {
+        Pass& pass = _passes[pass_index];
+        if (pass.framebuffer)
+        {
+            return *pass.framebuffer;
+        }
+
+        Texture* depth = nullptr;
+        std::vector<Texture*> colors;
+        bool imported = false;
+        for (const Usage& usage: pass.usages)
+        {
+            if (!is_attachment(usage.access))
+            {
+                continue;
+            }
+
+            Texture* tex = &texture(usage.resource);
+            imported |= _resources[usage.resource].imported_texture != nullptr;
+            if (usage.access == Access::DepthAttachment)
+            {
+                depth = tex;
+            }
+            else if (std::find(colors.begin(), colors.end(), tex) == colors.end())
+            {
+                colors.push_back(tex);
+            }
+        }
+
+        ALWAYS_ASSERT(depth || !colors.empty(), "Pass has no attachment");
+
+        if (imported)
+        {
+            // Imported textures can be destroyed without the graph knowing: don't cache their framebuffers
+            pass.framebuffer = _frame_framebuffers.emplace_back(std::make_unique<Framebuffer>(depth, colors)).get();
+            return *pass.framebuffer;
+        }
+
+        std::vector<u32> key;
+        key.push_back(depth ? depth->id() : 0);
+        for (const Texture* color: colors)
+        {
+            key.push_back(color->id());
+        }
+
+        auto it = _framebuffers.find(key);
+        if (it == _framebuffers.end())
+        {
+            it = _framebuffers.emplace(std::move(key), Framebuffer(depth, colors)).first;
+        }
+        pass.framebuffer = &it->second;
+        return *pass.framebuffer;
+    }
+
+    void RenderGraph::compute_barriers()
+    {
+        // For resources last written by an image store or a storage buffer write: barriers issued since
+        std::vector<bool> incoherent(_resources.size(), false);
+        std::vector<u32> synchronized(_resources.size(), 0);
+
+        for (Pass& pass: _passes)
+        {
+            pass.barriers = 0;
+            if (pass.culled)
+            {
+                continue;
+            }
+
+            for (const Usage& usage: pass.usages)
+            {
+                const u32 bits = barrier_bits(usage.access);
+                if (incoherent[usage.resource] && (synchronized[usage.resource] & bits) != bits)
+                {
+                    pass.barriers |= bits;
+                }
+            }
+
+            // A barrier applies to every resource written before it
+            for (u32 r = 0; r != _resources.size(); ++r)
+            {
+                synchronized[r] |= pass.barriers;
+            }
+
+            for (const Usage& usage: pass.usages)
+            {
+                if (usage.write && is_incoherent_write(usage.access))
+                {
+                    incoherent[usage.resource] = true;
+                    synchronized[usage.resource] = 0;
+                }
+            }
+        }
+    }
+
+    void RenderGraph::execute()
+    {
+        DEBUG_ASSERT(_compiled);
+
+        for (u32 i = 0; i != _passes.size(); ++i)
+        {
+            const Pass& pass = _passes[i];
+            if (pass.culled)
+            {
+                continue;
+            }
+
+            PROFILE_GPU(pass.name.c_str());
+            glPushDebugGroup(GL_DEBUG_SOURCE_APPLICATION, 0, -1, pass.name.c_str());
+
+            if (pass.barriers)
+            {
+                glMemoryBarrier(pass.barriers);
+            }
+
+            pass.execute(PassContext(*this, i));
+
+            glPopDebugGroup();
+        }
+    }
+
+    std::vector<RenderGraph::PassInfo> RenderGraph::passes() const
+    {
+        std::vector<PassInfo> infos;
+        for (const Pass& pass: _passes)
+        {
+            infos.push_back({pass.name, pass.culled});
+        }
+        return infos;
+    }
+
+    u32 RenderGraph::transient_texture_count() const
+    {
+        return u32(std::count_if(_resources.begin(), _resources.end(),
+                                 [](const ResourceNode& node) { return node.pool_index != u32(-1); }));
+    }
+
+    glm::uvec2 RenderGraph::size(u32 resource) const
+    {
+        DEBUG_ASSERT(resource < _resources.size());
+        const ResourceNode& node = _resources[resource];
+        return node.imported_texture ? node.imported_texture->size() : node.desc.size;
+    }
+
+    glm::uvec2 RenderGraph::pass_size(u32 pass_index) const
+    {
+        for (const Usage& usage: _passes[pass_index].usages)
+        {
+            if (is_attachment(usage.access))
+            {
+                return size(usage.resource);
+            }
+        }
+
+        FATAL("Pass has no attachment");
+    }
+
+    Texture& RenderGraph::texture(u32 resource) const
+    {
+        DEBUG_ASSERT(resource < _resources.size());
+        const ResourceNode& node = _resources[resource];
+        if (node.imported_texture)
+        {
+            return *node.imported_texture;
+        }
+
+        ALWAYS_ASSERT(node.pool_index != u32(-1), "Transient texture used by a culled pass only");
+        return *_pool[node.pool_index].texture;
+    }
+
+} // namespace OM3D
@@ -0,0 +1,207 @@
+#ifndef RENDERGRAPH_H
+#define RENDERGRAPH_H
+
+#include <ByteBuffer.h>
+#include <Framebuffer.h>
+#include <ImageFormat.h>
+#include <Texture.h>
+
+#include <glm/vec2.hpp>
+
+#include <functional>
+#include <map>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace OM3D
+{
+
+    // Description of the passes of a frame and of the resources they use.
+    // Passes are added in execution order along with what they read and write, the graph then:
+    //  - culls the passes whose results are never used (unless they have side effects),
+    //  - allocates transient textures from a pool, resources whose lifetimes don't overlap share the same texture
+    //    (OpenGL has no placed resources, so memory is aliased at the texture level). Textures are allocated by size
+    //    class so that resizing the window doesn't reallocate them every frame,
+    //  - issues the memory barriers needed after incoherent writes (image stores and storage buffers).
+    // The graph is rebuilt every frame, the transient texture pool and the framebuffers are kept between frames.
+    class RenderGraph : NonMovable
+    {
+    public:
+        struct TextureDesc
+        {
+            glm::uvec2 size = {};
+            ImageFormat format = ImageFormat::RGBA8_UNORM;
+            // Size the texture is allocated for when larger than size, so that rendering at a varying resolution
+            // (e.g. dynamic resolution) doesn't reallocate it
+            glm::uvec2 max_size = {};
+
+            bool operator==(const TextureDesc& other) const
+            {
+                return size == other.size && format == other.format && max_size == other.max_size;
+            }
+        };
+
+        enum class Access
+        {
+            Sampled,
+            ColorAttachment,
+            DepthAttachment,
+            ImageLoad,
+            ImageStore,
+            StorageRead,
+            StorageWrite,
+            Uniform,
+        };
+
+        // Resource handle, only valid for the frame it was created in
+        struct Resource
+        {
+            u32 index = u32(-1);
+
+            bool is_valid() const { return index != u32(-1); }
+        };
+
+        class PassBuilder
+        {
+        public:
+            // Transient texture, its content is undefined before the first write of the frame
+            Resource create_texture(const std::string& name, const TextureDesc& desc);
+
+            void read(Resource resource, Access access = Access::Sampled);
+            void write(Resource resource, Access access);
+
+            // The pass is never culled (e.g. it presents to the screen)
+            void set_side_effect();
+
+        private:
+            friend class RenderGraph;
+
+            PassBuilder(RenderGraph& graph, u32 pass) : _graph(graph), _pass(pass) {}
+
+            RenderGraph& _graph;
+            u32 _pass;
+        };
+
+        class PassContext
+        {
+        public:
+            // Transient textures may be larger than requested: only the top left size(resource) texels are used
+            Texture& texture(Resource resource) const;
+            glm::uvec2 size(Resource resource) const;
+
+            ByteBuffer& buffer(Resource resource) const;
+
+            // Binds a framebuffer made of the attachments of the pass (depth and colors in declaration order) and sets
+            // the viewport to their requested size. Passes managing their own framebuffers never create one.
+            void bind_framebuffer(bool clear_depth, bool clear_color) const;
+
+        private:
+            friend class RenderGraph;
+
+            PassContext(RenderGraph& graph, u32 pass) : _graph(graph), _pass(pass) {}
+
+            RenderGraph& _graph;
+            u32 _pass;
+        };
+
+        using SetupFunc = std::function<void(PassBuilder&)>;
+        using ExecuteFunc = std::function<void(const PassContext&)>;
+
+        struct PassInfo
+        {
+            std::string name;
+            bool culled = false;
+        };
+
+        RenderGraph() = default;
+
+        // Forget the passes and resources of the previous frame
+        void reset();
+
+        Resource import_texture(const std::string& name, Texture& texture);
+        Resource import_buffer(const std::string& name, ByteBuffer& buffer);
+
+        // Setup is called immediately, execute is called by execute() if the pass isn't culled
+        void add_pass(const std::string& name, const SetupFunc& setup, const ExecuteFunc& execute);
+
+        void compile();
+        void execute();
+
+        // Passes in execution order, culled ones included
+        std::vector<PassInfo> passes() const;
+
+        // Memory transient textures would use without aliasing and memory actually allocated for them
+        u64 requested_transient_bytes() const { return _requested_bytes; }
+        u64 allocated_transient_bytes() const { return _allocated_bytes; }
+        u32 transient_texture_count() const;
+        u32 pooled_texture_count() const { return u32(_pool.size()); }
+
+    private:
+        struct Usage
+        {
+            u32 resource;
+            Access access;
+            bool write;
+        };
+
+        struct Pass
+        {
+            std::string name;
+            ExecuteFunc execute;
+            std::vector<Usage> usages;
+            bool side_effect = false;
+
+            bool culled = false;
+            u32 barriers = 0;
+            const Framebuffer* framebuffer = nullptr;
+        };
+
+        struct ResourceNode
+        {
+            std::string name;
+
+            // Transient textures
+            TextureDesc desc;
+            u32 pool_index = u32(-1);
+
+            // Imported resources
+            Texture* imported_texture = nullptr;
+            ByteBuffer* imported_buffer = nullptr;
+
+            u32 first_pass = u32(-1);
+            u32 last_pass = 0;
+        };
+
+        struct PooledTexture
+        {
+            TextureDesc desc;
+            std::unique_ptr<Texture> texture;
+            u64 last_used_frame = 0;
+        };
+
+        Texture& texture(u32 resource) const;
+        glm::uvec2 size(u32 resource) const;
+        glm::uvec2 pass_size(u32 pass_index) const;
+        void allocate_transients();
+        const Framebuffer& pass_framebuffer(u32 pass_index);
+        void compute_barriers();
+
+        std::vector<Pass> _passes;
+        std::vector<ResourceNode> _resources;
+        bool _compiled = false;
+
+        std::vector<PooledTexture> _pool;
+        // Keyed by the GL names of the attachments, depth first
+        std::map<std::vector<u32>, Framebuffer> _framebuffers;
+        // Framebuffers with imported attachments, rebuilt every frame
+        std::vector<std::unique_ptr<Framebuffer>> _frame_framebuffers;
+
+        u64 _frame = 0;
+        u64 _requested_bytes = 0;
+        u64 _allocated_bytes = 0;
+    };
+
+} // namespace OM3D
+
+#endif // RENDERGRAPH_H
@@ -1,7 +1,12 @@
 #include "Scene.h"
 
 #include <TypedBuffer.h>
+
+#include <glad/gl.h>
+
+#include <algorithm>
 #include <iostream>
+#include <map>
 
 namespace OM3D
 {
@@ -9,12 +14,36 @@ namespace OM3D
     Scene::Scene()
     {
         _sky_material.set_program(Program::from_files("sky.frag", "screen.vert"));
-        _sky_material.set_depth_test_mode(DepthTestMode::None);
+        // The sky triangle is at depth 0 (reverse-Z far plane): only the pixels no geometry covered pass the test
+        _sky_material.set_depth_test_mode(DepthTestMode::Equal);
+        _sky_material.set_depth_write(false);
+
+        const std::array<std::string, 1> alpha_test_defines = {"ALPHA_TEST"};
+        _depth_program = Program::from_files("depth.frag", "depth.vert");
+        _depth_alpha_test_program = Program::from_files("depth.frag", "depth.vert", alpha_test_defines);
+
+        const std::array<std::string, 1> visibility_defines = {"VISIBILITY"};
+        const std::array<std::string, 2> visibility_alpha_test_defines = {"VISIBILITY", "ALPHA_TEST"};
+        _visibility_program = Program::from_files("visibility.frag", "depth.vert", visibility_defines);
+        _visibility_alpha_test_program =
+                Program::from_files("visibility.frag", "depth.vert", visibility_alpha_test_defines);
 
         _envmap = std::make_shared<Texture>(Texture::empty_cubemap(4, ImageFormat::RGBA8_UNORM));
     }
 
-    void Scene::add_object(SceneObject obj) { _objects.emplace_back(std::move(obj)); }
+    void Scene::add_object(SceneObject obj)
+    {
+        _objects.emplace_back(std::move(obj));
+        _batches_dirty = true;
+        ++_geometry_version;
+    }
+
+    void Scene::clear_object()
+    {
+        _objects.clear();
+        _batches_dirty = true;
+        ++_geometry_version;
+    }
 
     void Scene::add_light(PointLight obj) { _point_lights.emplace_back(std::move(obj)); }
 
@@ -36,11 +65,16 @@ namespace OM3D
         const float alt = glm::radians(altitude);
         const float azi = glm::radians(azimuth);
         // Convert from polar to cartesian
-        _sun_direction = glm::vec3(sin(azi) * cos(alt), sin(alt), cos(azi) * cos(alt));
+        const glm::vec3 direction = glm::vec3(sin(azi) * cos(alt), sin(alt), cos(azi) * cos(alt));
+        if (direction != _sun_direction)
+        {
+            _sun_direction = direction;
+            ++_sun_version;
+        }
         _sun_color = color;
     }
 
-    void Scene::set_light_view_proj(const glm::mat4& m) { _light_view_proj = m; }
+    glm::vec3 Scene::sun_direction() const { return glm::normalize(_sun_direction); }
 
     void Scene::bind_buffer() const
     {
@@ -54,7 +88,6 @@ namespace OM3D
             mapping[0].camera.view_proj = _camera.view_proj_matrix();
             mapping[0].camera.inv_view_proj = glm::inverse(_camera.view_proj_matrix());
             mapping[0].camera.position = _camera.position();
-            mapping[0].light_view_proj = _light_view_proj;
             mapping[0].point_light_count = u32(_point_lights.size());
             mapping[0].sun_color = _sun_color;
             mapping[0].sun_dir = glm::normalize(_sun_direction);
@@ -73,7 +106,7 @@ namespace OM3D
 
     void Scene::bind_buffer_pl() const
     {
-        if (!_point_light_buffer)
+        if (!_point_light_buffer || _point_light_buffer->element_count() < _point_lights.size())
         {
             // std::max with 1 to prevent error if 0 point light in the scene
             _point_light_buffer = std::make_unique<TypedBuffer<shader::PointLight>>(
@@ -92,100 +125,424 @@ namespace OM3D
         _point_light_buffer->bind(BufferUsage::Storage, 1);
     }
 
+    void Scene::build_batches() const
+    {
+        _batches.clear();
+
+        std::map<std::pair<const StaticMesh*, const Material*>, u32> batch_indices;
+        for (const bool opaque: {true, false})
+        {
+            for (u32 i = 0; i != _objects.size(); ++i)
+            {
+                const SceneObject& obj = _objects[i];
+                if (!obj.mesh() || !obj.material_ptr() || obj.material().is_opaque() != opaque)
+                {
+                    continue;
+                }
+
+                const auto key = std::pair{obj.mesh().get(), obj.material_ptr().get()};
+                const auto [it, inserted] = batch_indices.emplace(key, u32(_batches.size()));
+                if (inserted)
+                {
+                    InstanceBatch& batch = _batches.emplace_back();
+                    batch.mesh = key.first;
+                    batch.material = key.second;
+                }
+                _batches[it->second].objects.push_back(i);
+            }
+        }
+
+        _batches_dirty = false;
+        _visibility_dirty = true;
+        // Instance ranges need to be rebuilt even if the camera didn't move
+        _instances_view = glm::mat4(0.0f);
+    }
+
+    // Culling only depends on the view, the field of view and the aspect ratio: a jittered projection (TAA) doesn't
+    // invalidate the visible instances
+    static glm::vec2 culling_fov_ratio(const Camera& camera) { return glm::vec2(camera.fov(), camera.ratio()); }
+
+    void Scene::update_instances() const
+    {
+        if (_batches_dirty)
+        {
+            build_batches();
+        }
+        else if (_instances_view == _camera.view_matrix() && _instances_fov_ratio == culling_fov_ratio(_camera))
+        {
+            // Nothing moved since the last upload: visible ranges are still valid
+            return;
+        }
+
+        const Frustum frustum = _camera.build_frustum();
+        const glm::vec3 camera_pos = _camera.position();
+
+        std::vector<glm::mat4> transforms;
+        std::vector<u32> batch_indices;
+        transforms.reserve(_objects.size());
+        batch_indices.reserve(_objects.size());
+        for (u32 b = 0; b != _batches.size(); ++b)
+        {
+            InstanceBatch& batch = _batches[b];
+            batch.instance_offset = u32(transforms.size());
+            for (const u32 index: batch.objects)
+            {
+                const SceneObject& obj = _objects[index];
+                if (!obj.is_culled(frustum, camera_pos))
+                {
+                    transforms.push_back(obj.transform());
+                    batch_indices.push_back(b);
+                }
+            }
+            batch.instance_count = u32(transforms.size()) - batch.instance_offset;
+        }
+
+        if (!_instance_buffer || _instance_buffer->element_count() < transforms.size())
+        {
+            // Size for the whole scene so the buffer is only reallocated when objects are added
+            const size_t capacity = std::max({transforms.size(), _objects.size(), size_t(1)});
+            _instance_buffer = std::make_unique<TypedBuffer<glm::mat4>>(nullptr, capacity);
+            _instance_batch_buffer = std::make_unique<TypedBuffer<u32>>(nullptr, capacity);
+        }
+
+        if (!transforms.empty())
+        {
+            auto mapping = _instance_buffer->map(AccessType::WriteOnly);
+            std::copy(transforms.begin(), transforms.end(), mapping.data());
+
+            auto batch_mapping = _instance_batch_buffer->map(AccessType::WriteOnly);
+            std::copy(batch_indices.begin(), batch_indices.end(), batch_mapping.data());
+        }
+
+        _instances_view = _camera.view_matrix();
+        _instances_fov_ratio = culling_fov_ratio(_camera);
+    }
+
     void Scene::render() const
     {
         bind_buffer();
 
         bind_buffer_pl();
 
-        // Render the sky
+        // Render every opaque object, one instanced draw per (mesh, material) pair
+        update_instances();
+        _instance_buffer->bind(BufferUsage::Storage, 2);
+
+        draw_batches(false);
+    }
+
+    void Scene::render_sky() const
+    {
+        bind_buffer();
+
         _sky_material.bind();
         _sky_material.set_uniform(HASH("intensity"), _ibl_intensity);
         draw_full_screen_triangle();
+    }
+
+    bool Scene::has_transparent_objects() const
+    {
+        if (_batches_dirty)
+        {
+            build_batches();
+        }
+
+        return std::any_of(_batches.begin(), _batches.end(),
+                           [](const InstanceBatch& batch) { return !batch.material->is_opaque(); });
+    }
+
+    void Scene::render_transparent() const
+    {
+        bind_buffer();
+
+        bind_buffer_pl();
+
+        update_instances();
+        _instance_buffer->bind(BufferUsage::Storage, 2);
+
+        draw_batches(true);
+    }
 
-        // Render every object
+    void Scene::draw_batches(bool transparent) const
+    {
+        for (const InstanceBatch& batch: _batches)
         {
-            // Opaque first
-            Frustum frustum = _camera.build_frustum();
-            for (const SceneObject& obj: _objects)
+            if (!batch.instance_count || batch.material->is_opaque() == transparent)
             {
-                if (obj.material().is_opaque())
-                {
-                    // Check frustum culling
-                    const BoundingSphere bs = obj.mesh()->bounding_sphere();
-                    glm::vec3 bsWS = obj.transform() * glm::vec4(bs.center, 1.0f);
-
-                    bool is_culled = false;
-
-                    if (glm::dot(frustum._near_normal, bsWS - _camera.position()) < -bs.radius)
-                    {
-                        is_culled = true;
-                    }
-                    else if (glm::dot(frustum._top_normal, bsWS - _camera.position()) < -bs.radius)
-                    {
-                        is_culled = true;
-                    }
-                    else if (glm::dot(frustum._bottom_normal, bsWS - _camera.position()) < -bs.radius)
-                    {
-                        is_culled = true;
-                    }
-                    else if (glm::dot(frustum._right_normal, bsWS - _camera.position()) < -bs.radius)
-                    {
-                        is_culled = true;
-                    }
-                    else if (glm::dot(frustum._left_normal, bsWS - _camera.position()) < -bs.radius)
-                    {
-                        is_culled = true;
-                    }
-
-                    if (is_culled)
-                    {
-                        continue;
-                    }
-                    obj.render();
-                }
+                continue;
+            }
+
+            batch.material->set_uniform(HASH("instance_offset"), batch.instance_offset);
+            batch.material->bind();
+            batch.mesh->draw_instanced(batch.instance_count);
+        }
+    }
+
+    bool Scene::supports_visibility_buffer() const
+    {
+        if (!bindless_enabled())
+        {
+            return false;
+        }
+
+        // Draw IDs (visible instances + 1) and triangle IDs have to fit in 32 bits
+        if (_objects.size() >= (1u << (32 - VISIBILITY_TRIANGLE_BITS)) - 1)
+        {
+            return false;
+        }
+
+        if (_batches_dirty)
+        {
+            build_batches();
+        }
+
+        const auto fits = [](const InstanceBatch& batch)
+        { return batch.mesh->index_buffer().element_count() / 3 <= (1u << VISIBILITY_TRIANGLE_BITS); };
+        return std::all_of(_batches.begin(), _batches.end(), fits);
+    }
+
+    void Scene::build_visibility_data() const
+    {
+        if (!_visibility_resolve_program)
+        {
+            _visibility_resolve_program = Program::from_files("visibility_resolve.frag", "screen.vert");
+        }
+
+        // Offsets of each opaque mesh in the merged buffers
+        std::map<const StaticMesh*, std::pair<u32, u32>> mesh_offsets;
+        size_t vertex_count = 0;
+        size_t index_count = 0;
+        for (const InstanceBatch& batch: _batches)
+        {
+            if (!batch.material->is_opaque())
+            {
+                continue;
+            }
+
+            if (mesh_offsets.emplace(batch.mesh, std::pair{u32(vertex_count), u32(index_count)}).second)
+            {
+                vertex_count += batch.mesh->vertex_buffer().element_count();
+                index_count += batch.mesh->index_buffer().element_count();
+            }
+        }
+
+        _visibility_vertices =
+                std::make_unique<ByteBuffer>(nullptr, std::max(vertex_count, size_t(1)) * sizeof(Vertex));
+        _visibility_indices = std::make_unique<ByteBuffer>(nullptr, std::max(index_count, size_t(1)) * sizeof(u32));
+        for (const auto& [mesh, offsets]: mesh_offsets)
+        {
+            _visibility_vertices->copy_from(mesh->vertex_buffer(), offsets.first * sizeof(Vertex));
+            _visibility_indices->copy_from(mesh->index_buffer(), offsets.second * sizeof(u32));
+        }
+
+        const auto handle = [](const Texture* texture, const std::shared_ptr<Texture>& fallback)
+        {
+            const u64 bindless = (texture ? texture : fallback.get())->bindless_handle();
+            return glm::uvec2(u32(bindless), u32(bindless >> 32));
+        };
+
+        std::vector<shader::VisibilityBatch> batches(std::max(_batches.size(), size_t(1)));
+        for (size_t i = 0; i != _batches.size(); ++i)
+        {
+            const InstanceBatch& batch = _batches[i];
+            if (!batch.material->is_opaque())
+            {
+                continue;
+            }
+
+            const Material& material = *batch.material;
+            shader::VisibilityBatch& data = batches[i];
+            data.albedo_texture = handle(material.texture(0), default_white_texture());
+            data.normal_texture = handle(material.texture(1), default_normal_texture());
+            data.metal_rough_texture = handle(material.texture(2), default_metal_rough_texture());
+            data.first_vertex = mesh_offsets[batch.mesh].first;
+            data.first_index = mesh_offsets[batch.mesh].second;
+
+            const auto uniform = [&](u32 name_hash, auto fallback)
+            {
+                const UniformValue* value = material.stored_uniform(name_hash);
+                const auto* typed = value ? std::get_if<decltype(fallback)>(value) : nullptr;
+                return typed ? *typed : fallback;
+            };
+            data.base_color_factor = uniform(HASH("base_color_factor"), glm::vec3(1.0f));
+            data.metal_rough_factor = uniform(HASH("metal_rough_factor"), glm::vec2(1.0f));
+            data.alpha_cutoff = uniform(HASH("alpha_cutoff"), 0.0f);
+        }
+
+        _visibility_batches = std::make_unique<TypedBuffer<shader::VisibilityBatch>>(batches);
+        _visibility_dirty = false;
+    }
+
+    void Scene::render_visibility() const
+    {
+        update_instances();
+        _instance_buffer->bind(BufferUsage::Storage, 2);
+
+        // Depth comes from the Z-prepass: only the visible triangle of each pixel passes the test
+        glEnable(GL_DEPTH_TEST);
+        glDepthFunc(GL_GEQUAL);
+        glDepthMask(GL_FALSE);
+        glEnable(GL_CULL_FACE);
+        glCullFace(GL_BACK);
+        glFrontFace(GL_CCW);
+        glDisable(GL_BLEND);
+
+        _visibility_program->set_uniform(HASH("view_proj"), _camera.view_proj_matrix());
+        _visibility_alpha_test_program->set_uniform(HASH("view_proj"), _camera.view_proj_matrix());
+
+        for (const InstanceBatch& batch: _batches)
+        {
+            if (!batch.material->is_opaque())
+            {
+                break;
+            }
+
+            if (!batch.instance_count)
+            {
+                continue;
             }
 
-            // Transparent after
-            for (const SceneObject& obj: _objects)
+            if (batch.material->is_alpha_tested())
+            {
+                _visibility_alpha_test_program->set_uniform(HASH("instance_offset"), batch.instance_offset);
+                batch.material->bind_alpha_mask(*_visibility_alpha_test_program);
+                _visibility_alpha_test_program->bind();
+                batch.mesh->draw_instanced(batch.instance_count);
+            }
+            else
             {
+                _visibility_program->set_uniform(HASH("instance_offset"), batch.instance_offset);
+                _visibility_program->bind();
+                batch.mesh->draw_positions_instanced(batch.instance_count);
+            }
+        }
+
+        glDepthMask(GL_TRUE);
+    }
+
+    void Scene::render_from_visibility(const Texture& visibility) const
+    {
+        if (_visibility_dirty)
+        {
+            build_visibility_data();
+        }
+
+        bind_buffer();
+
+        bind_buffer_pl();
+
+        // Opaque objects: one full screen pass evaluating the material of the visible triangle
+        update_instances();
+        _instance_buffer->bind(BufferUsage::Storage, 2);
+        _instance_batch_buffer->bind(BufferUsage::Storage, 6);
+        _visibility_batches->bind(BufferUsage::Storage, 7);
+        _visibility_vertices->bind(BufferUsage::Storage, 8);
+        _visibility_indices->bind(BufferUsage::Storage, 9);
+
+        glDisable(GL_DEPTH_TEST);
+        glDepthMask(GL_FALSE);
+        glDisable(GL_BLEND);
+
+        _visibility_resolve_program->bind();
+        visibility.bind(0);
+        draw_full_screen_triangle();
+
+        glDepthMask(GL_TRUE);
+    }
 
-                if (!obj.material().is_opaque())
+    void Scene::render_depth() const
+    {
+        update_instances();
+        _instance_buffer->bind(BufferUsage::Storage, 2);
+
+        draw_depth_batches(_camera.view_proj_matrix(), true);
+    }
+
+    void Scene::render_depth(const glm::mat4& view_proj) const
+    {
+        if (_batches_dirty)
+        {
+            build_batches();
+        }
+
+        const std::array<glm::vec4, 6> planes = Camera::frustum_planes(view_proj);
+
+        std::vector<glm::mat4> transforms;
+        transforms.reserve(_objects.size());
+        for (InstanceBatch& batch: _batches)
+        {
+            batch.depth_instance_offset = u32(transforms.size());
+            for (const u32 index: batch.objects)
+            {
+                const SceneObject& obj = _objects[index];
+                if (!obj.is_culled(planes))
                 {
-                    // Check frustum culling
-                    const BoundingSphere bs = obj.mesh()->bounding_sphere();
-                    glm::vec3 bsWS = obj.transform() * glm::vec4(bs.center, 1.0f);
-
-                    bool is_culled = false;
-
-                    if (glm::dot(frustum._near_normal, bsWS - _camera.position()) < -bs.radius)
-                    {
-                        is_culled = true;
-                    }
-                    else if (glm::dot(frustum._top_normal, bsWS - _camera.position()) < -bs.radius)
-                    {
-                        is_culled = true;
-                    }
-                    else if (glm::dot(frustum._bottom_normal, bsWS - _camera.position()) < -bs.radius)
-                    {
-                        is_culled = true;
-                    }
-                    else if (glm::dot(frustum._right_normal, bsWS - _camera.position()) < -bs.radius)
-                    {
-                        is_culled = true;
-                    }
-                    else if (glm::dot(frustum._left_normal, bsWS - _camera.position()) < -bs.radius)
-                    {
-                        is_culled = true;
-                    }
-
-                    if (is_culled)
-                    {
-                        continue;
-                    }
-                    obj.render();
+                    transforms.push_back(obj.transform());
                 }
             }
+            batch.depth_instance_count = u32(transforms.size()) - batch.depth_instance_offset;
+        }
+
+        if (!_depth_instance_buffer || _depth_instance_buffer->element_count() < transforms.size())
+        {
+            const size_t capacity = std::max({transforms.size(), _objects.size(), size_t(1)});
+            _depth_instance_buffer = std::make_unique<TypedBuffer<glm::mat4>>(nullptr, capacity);
+        }
+
+        if (!transforms.empty())
+        {
+            // Called several times per frame (once per shadow cascade): don't wait for the previous draws
+            auto mapping = _depth_instance_buffer->map(AccessType::WriteDiscard);
+            std::copy(transforms.begin(), transforms.end(), mapping.data());
+        }
+
+        _depth_instance_buffer->bind(BufferUsage::Storage, 2);
+        draw_depth_batches(view_proj, false);
+    }
+
+    void Scene::draw_depth_batches(const glm::mat4& view_proj, bool camera_instances) const
+    {
+        glEnable(GL_DEPTH_TEST);
+        // We are using reverse-Z
+        glDepthFunc(GL_GEQUAL);
+        glDepthMask(GL_TRUE);
+        glEnable(GL_CULL_FACE);
+        glCullFace(GL_BACK);
+        glFrontFace(GL_CCW);
+        glDisable(GL_BLEND);
+
+        _depth_program->set_uniform(HASH("view_proj"), view_proj);
+        _depth_alpha_test_program->set_uniform(HASH("view_proj"), view_proj);
+
+        for (const InstanceBatch& batch: _batches)
+        {
+            if (!batch.material->is_opaque())
+            {
+                // Transparent batches come last and don't write depth
+                break;
+            }
+
+            const u32 offset = camera_instances ? batch.instance_offset : batch.depth_instance_offset;
+            const u32 count = camera_instances ? batch.instance_count : batch.depth_instance_count;
+            if (!count)
+            {
+                continue;
+            }
+
+            if (batch.material->is_alpha_tested())
+            {
+                _depth_alpha_test_program->set_uniform(HASH("instance_offset"), offset);
+                batch.material->bind_alpha_mask(*_depth_alpha_test_program);
+                _depth_alpha_test_program->bind();
+                // Alpha tested materials need texture coordinates
+                batch.mesh->draw_instanced(count);
+            }
+            else
+            {
+                _depth_program->set_uniform(HASH("instance_offset"), offset);
+                _depth_program->bind();
+                batch.mesh->draw_positions_instanced(count);
+            }
         }
     }
 
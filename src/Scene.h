@@ -23,10 +23,33 @@ namespace OM3D
 
         void bind_buffer() const;
         void bind_buffer_pl() const;
+        // Opaque objects, the sky and the transparent objects are drawn separately
         void render() const;
 
+        // Depth only rendering of the opaque objects: position only vertex stream, no sky and no material binds
+        // (except the base color of alpha tested materials). Expects the target framebuffer to be bound.
+        void render_depth() const;
+        // Same for another view (e.g. a shadow cascade), objects are culled against its frustum
+        void render_depth(const glm::mat4& view_proj) const;
+
+        // Visibility buffer pipeline, an alternative to render() that evaluates opaque materials once per pixel.
+        // render_visibility() writes the draw and triangle IDs of the opaque objects (R32_UINT) and expects their depth
+        // to be in the bound framebuffer already (Z-prepass). render_from_visibility() then fills the G-buffer like
+        // render() would, by fetching the triangles from the visibility buffer.
+        bool supports_visibility_buffer() const;
+        void render_visibility() const;
+        void render_from_visibility(const Texture& visibility) const;
+
+        // Sky radiance on the pixels left at the far plane, expects a framebuffer with the scene depth to be bound
+        void render_sky() const;
+
+        // Transparent objects, with a weighted blended OIT material: expects a framebuffer with the opaque depth,
+        // the accumulation and the revealage targets to be bound, in that order
+        bool has_transparent_objects() const;
+        void render_transparent() const;
+
         void add_object(SceneObject obj);
-        void clear_object() { _objects.clear(); }
+        void clear_object();
         void add_light(PointLight obj);
 
         Span<const SceneObject> objects() const;
@@ -38,16 +61,58 @@ namespace OM3D
         void set_envmap(std::shared_ptr<Texture> env);
         void set_ibl_intensity(float intensity);
 
-        void set_light_view_proj(const glm::mat4& m);
-
         void set_sun(float altitude, float azimuth, glm::vec3 color = glm::vec3(1.0f));
+        glm::vec3 sun_direction() const;
+
+        // Incremented every time the sun direction or the scene objects change, used to invalidate cached shadows
+        u32 sun_version() const { return _sun_version; }
+        u32 geometry_version() const { return _geometry_version; }
 
     private:
+        // Objects sharing the same mesh and material, drawn with a single instanced call
+        struct InstanceBatch
+        {
+            const StaticMesh* mesh = nullptr;
+            const Material* material = nullptr;
+            std::vector<u32> objects;
+
+            // Range of visible instances in the instance buffer for the current frame
+            u32 instance_offset = 0;
+            u32 instance_count = 0;
+
+            // Same for the last render_depth(view_proj)
+            u32 depth_instance_offset = 0;
+            u32 depth_instance_count = 0;
+        };
+
+        void build_batches() const;
+        void update_instances() const;
+        void draw_depth_batches(const glm::mat4& view_proj, bool camera_instances) const;
+        void draw_batches(bool transparent) const;
+        void build_visibility_data() const;
+
         std::vector<SceneObject> _objects;
         std::vector<PointLight> _point_lights;
 
         mutable std::unique_ptr<TypedBuffer<shader::FrameData>> _frame_data_buffer;
         mutable std::unique_ptr<TypedBuffer<shader::PointLight>> _point_light_buffer;
+        mutable std::unique_ptr<TypedBuffer<glm::mat4>> _instance_buffer;
+        // Visible instances of render_depth(view_proj), kept apart so the camera ones stay valid
+        mutable std::unique_ptr<TypedBuffer<glm::mat4>> _depth_instance_buffer;
+        // Batch index of each visible instance, for the visibility buffer
+        mutable std::unique_ptr<TypedBuffer<u32>> _instance_batch_buffer;
+
+        // Vertices and indices of the opaque meshes merged in single buffers, and material data for each batch
+        mutable std::unique_ptr<ByteBuffer> _visibility_vertices;
+        mutable std::unique_ptr<ByteBuffer> _visibility_indices;
+        mutable std::unique_ptr<TypedBuffer<shader::VisibilityBatch>> _visibility_batches;
+        mutable bool _visibility_dirty = true;
+
+        // Opaque batches first, then transparent ones
+        mutable std::vector<InstanceBatch> _batches;
+        mutable bool _batches_dirty = true;
+        mutable glm::mat4 _instances_view = glm::mat4(0.0f);
+        mutable glm::vec2 _instances_fov_ratio = {};
 
         glm::vec3 _sun_direction = glm::vec3(0.2f, 1.0f, 0.1f);
         glm::vec3 _sun_color = glm::vec3(1.0f);
@@ -56,8 +121,17 @@ namespace OM3D
         float _ibl_intensity = 1.0f;
         Material _sky_material;
 
+        std::shared_ptr<Program> _depth_program;
+        std::shared_ptr<Program> _depth_alpha_test_program;
+        std::shared_ptr<Program> _visibility_program;
+        std::shared_ptr<Program> _visibility_alpha_test_program;
+        // Created on first use, needs bindless textures
+        mutable std::shared_ptr<Program> _visibility_resolve_program;
+
         Camera _camera;
-        glm::mat4 _light_view_proj = glm::mat4(1.0f);
+
+        u32 _sun_version = 0;
+        u32 _geometry_version = 0;
     };
 
 } // namespace OM3D
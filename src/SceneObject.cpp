@@ -2,6 +2,8 @@
 
 #include <glm/gtc/matrix_transform.hpp>
 
+#include <algorithm>
+
 namespace OM3D
 {
 
@@ -9,34 +11,53 @@ namespace OM3D
         _mesh(std::move(mesh)), _material(std::move(material))
     {}
 
-    void SceneObject::render() const
-    {
-        if (!_material || !_mesh)
-        {
-            return;
-        }
-
-        _material->set_uniform(HASH("model"), transform());
-        _material->bind();
-        _mesh->draw();
-    }
-
     const Material& SceneObject::material() const
     {
         DEBUG_ASSERT(_material);
         return *_material;
     }
 
+    const std::shared_ptr<Material>& SceneObject::material_ptr() const { return _material; }
+
     void SceneObject::set_transform(const glm::mat4& tr) { _transform = tr; }
 
     const glm::mat4& SceneObject::transform() const { return _transform; }
 
     const std::shared_ptr<StaticMesh>& SceneObject::mesh() const { return _mesh; }
 
-    void SceneObject::render_depth_only(Program& program) const
+    BoundingSphere SceneObject::world_bounding_sphere() const
     {
-        program.set_uniform(HASH("transform"), _transform);
-        _mesh->draw();
+        const BoundingSphere bs = _mesh->bounding_sphere();
+
+        // Bounding sphere radius is in object space, scale it to world space
+        const float scale = std::max({glm::length(glm::vec3(_transform[0])), glm::length(glm::vec3(_transform[1])),
+                                      glm::length(glm::vec3(_transform[2]))});
+
+        return {glm::vec3(_transform * glm::vec4(bs.center, 1.0f)), bs.radius * scale};
+    }
+
+    bool SceneObject::is_culled(const Frustum& frustum, const glm::vec3& camera_pos) const
+    {
+        const BoundingSphere bs = world_bounding_sphere();
+        const glm::vec3 center = bs.center - camera_pos;
+        const float radius = bs.radius;
+
+        return glm::dot(frustum._near_normal, center) < -radius || glm::dot(frustum._top_normal, center) < -radius ||
+               glm::dot(frustum._bottom_normal, center) < -radius || glm::dot(frustum._right_normal, center) < -radius ||
+               glm::dot(frustum._left_normal, center) < -radius;
+    }
+
+    bool SceneObject::is_culled(Span<const glm::vec4> planes) const
+    {
+        const BoundingSphere bs = world_bounding_sphere();
+        for (const glm::vec4& plane: planes)
+        {
+            if (glm::dot(glm::vec3(plane), bs.center) + plane.w < -bs.radius)
+            {
+                return true;
+            }
+        }
+        return false;
     }
 
 } // namespace OM3D
@@ -1,6 +1,7 @@
 #ifndef SCENEOBJECT_H
 #define SCENEOBJECT_H
 
+#include <Camera.h>
 #include <Material.h>
 #include <StaticMesh.h>
 
@@ -17,18 +18,20 @@ namespace OM3D
     public:
         SceneObject(std::shared_ptr<StaticMesh> mesh = nullptr, std::shared_ptr<Material> material = nullptr);
 
-        void render() const;
-
         const Material& material() const;
+        const std::shared_ptr<Material>& material_ptr() const;
 
         void set_transform(const glm::mat4& tr);
         const glm::mat4& transform() const;
 
         const std::shared_ptr<StaticMesh>& mesh() const;
 
-        void render_depth_only(Program& program) const;
+        bool is_culled(const Frustum& frustum, const glm::vec3& camera_pos) const;
+        bool is_culled(Span<const glm::vec4> planes) const;
 
     private:
+        BoundingSphere world_bounding_sphere() const;
+
         glm::mat4 _transform = glm::mat4(1.0f);
 
         std::shared_ptr<StaticMesh> _mesh;
@@ -6,6 +6,7 @@
 #include <utils.h>
 
 #include <iostream>
+#include <map>
 
 #ifdef __GNUC__
 #pragma GCC diagnostic push
@@ -397,6 +398,8 @@ namespace OM3D
 
         std::unordered_map<int, std::shared_ptr<Texture>> textures;
         std::unordered_map<int, std::shared_ptr<Material>> materials;
+        // Nodes referencing the same mesh share their StaticMesh so they can be drawn instanced
+        std::map<std::pair<int, size_t>, std::shared_ptr<StaticMesh>> meshes;
         std::unordered_map<int, glm::mat4> node_transforms;
         std::vector<std::pair<int, int>> light_nodes;
 
@@ -436,6 +439,7 @@ namespace OM3D
         }
 
         const std::string emissive_strength_ext_name = "KHR_materials_emissive_strength";
+        const std::shared_ptr<Material> default_material = std::make_shared<Material>(Material::gbuffer_material());
 
         for (auto [node_index, node_transform]: node_transforms)
         {
@@ -448,7 +452,6 @@ namespace OM3D
 
             const tinygltf::Mesh& mesh = gltf.meshes[node.mesh];
 
-            const std::shared_ptr<Material> default_material = std::make_shared<Material>(Material::gbuffer_material());
             for (size_t j = 0; j != mesh.primitives.size(); ++j)
             {
                 const tinygltf::Primitive& prim = mesh.primitives[j];
@@ -458,15 +461,21 @@ namespace OM3D
                     continue;
                 }
 
-                auto mesh = build_mesh_data(gltf, prim);
-                if (!mesh.is_ok)
+                auto& static_mesh = meshes[{node.mesh, j}];
+                if (!static_mesh)
                 {
-                    return {false, {}};
-                }
+                    auto mesh = build_mesh_data(gltf, prim);
+                    if (!mesh.is_ok)
+                    {
+                        return {false, {}};
+                    }
 
-                if (mesh.value.vertices[0].tangent_bitangent_sign == glm::vec4(0.0f))
-                {
-                    compute_tangents(mesh.value);
+                    if (mesh.value.vertices[0].tangent_bitangent_sign == glm::vec4(0.0f))
+                    {
+                        compute_tangents(mesh.value);
+                    }
+
+                    static_mesh = std::make_shared<StaticMesh>(mesh.value);
                 }
 
                 std::shared_ptr<Material> material = default_material;
@@ -529,9 +538,7 @@ namespace OM3D
                         }
                         else
                         {
-                            mat = std::make_shared<Material>(Material::textured_pbr_material(false));
-                            mat->set_blend_mode(BlendMode::Alpha);
-                            mat->set_depth_test_mode(DepthTestMode::None);
+                            mat = std::make_shared<Material>(Material::transparent_material());
                         }
 
                         if (albedo)
@@ -588,7 +595,7 @@ namespace OM3D
                     material = mat;
                 }
 
-                auto scene_object = SceneObject(std::make_shared<StaticMesh>(mesh.value), std::move(material));
+                auto scene_object = SceneObject(static_mesh, std::move(material));
                 scene_object.set_transform(node_transform);
                 scene->add_object(std::move(scene_object));
             }
@@ -0,0 +1,195 @@
+#include "ShadowCascades.h"
+
+#include <glad/gl.h>
+
+#include <cmath>
+
+namespace OM3D
+{
+
+    // Distance before the cascades where objects can still cast shadows into them
+    static constexpr float caster_margin = 250.0f;
+
+    // Extra radius given to cached cascades so that the camera can move before they need to be rendered again
+    static constexpr float cache_margin = 1.25f;
+
+    static constexpr float split_near = 0.1f;
+
+    static glm::mat3 light_rotation(const glm::vec3& sun_dir)
+    {
+        const glm::vec3 up = std::abs(sun_dir.y) > 0.99f ? glm::vec3(0.0f, 0.0f, 1.0f) : glm::vec3(0.0f, 1.0f, 0.0f);
+        return glm::mat3(glm::lookAt(glm::vec3(0.0f), -sun_dir, up));
+    }
+
+    ShadowCascades::ShadowCascades(u32 resolution) :
+        _resolution(resolution),
+        _shadow_map(glm::uvec2(resolution), max_cascades, ImageFormat::Depth32_FLOAT, WrapMode::Clamp)
+    {
+        _shadow_map.set_shadow_parameters();
+        for (u32 i = 0; i != max_cascades; ++i)
+        {
+            _cascades[i].framebuffer = Framebuffer(&_shadow_map, i);
+        }
+
+        _data_buffer = std::make_unique<TypedBuffer<shader::ShadowData>>(nullptr, 1);
+    }
+
+    void ShadowCascades::set_cascade_count(u32 count)
+    {
+        DEBUG_ASSERT(count > 0 && count <= max_cascades);
+        if (count != _cascade_count)
+        {
+            _cascade_count = count;
+            invalidate();
+        }
+    }
+
+    void ShadowCascades::set_split_lambda(float lambda)
+    {
+        DEBUG_ASSERT(lambda >= 0.0f && lambda <= 1.0f);
+        if (lambda != _split_lambda)
+        {
+            _split_lambda = lambda;
+            invalidate();
+        }
+    }
+
+    void ShadowCascades::set_max_distance(float distance)
+    {
+        DEBUG_ASSERT(distance > split_near);
+        if (distance != _max_distance)
+        {
+            _max_distance = distance;
+            invalidate();
+        }
+    }
+
+    void ShadowCascades::set_first_cached_cascade(u32 index)
+    {
+        if (index != _first_cached)
+        {
+            _first_cached = index;
+            invalidate();
+        }
+    }
+
+    void ShadowCascades::invalidate()
+    {
+        for (Cascade& cascade: _cascades)
+        {
+            cascade.valid = false;
+        }
+    }
+
+    void ShadowCascades::render(const Scene& scene, const Terrain& terrain, Program& terrain_program)
+    {
+        if (scene.sun_version() != _sun_version || scene.geometry_version() != _geometry_version ||
+            terrain.generation() != _terrain_generation)
+        {
+            _sun_version = scene.sun_version();
+            _geometry_version = scene.geometry_version();
+            _terrain_generation = terrain.generation();
+            invalidate();
+        }
+
+        const Camera& camera = scene.camera();
+        const glm::mat3 rotation = light_rotation(glm::normalize(scene.sun_direction()));
+
+        const float tan_half_fov = std::tan(camera.fov() * 0.5f);
+        const glm::vec2 tan_half_extent = glm::vec2(tan_half_fov * camera.ratio(), tan_half_fov);
+
+        float splits[max_cascades] = {};
+        float slice_near = split_near;
+        for (u32 i = 0; i != _cascade_count; ++i)
+        {
+            // Practical split scheme: blend of logarithmic and uniform splits
+            const float t = float(i + 1) / float(_cascade_count);
+            const float log_split = split_near * std::pow(_max_distance / split_near, t);
+            const float uniform_split = split_near + (_max_distance - split_near) * t;
+            const float slice_far = glm::mix(uniform_split, log_split, _split_lambda);
+            splits[i] = slice_far;
+
+            // The bounding sphere of the slice only depends on its depth range, not on the camera orientation.
+            // Cached cascades are centered on the camera instead and reach the far corners of the slice in every
+            // direction, so that turning never invalidates them
+            const bool cached = i >= _first_cached;
+            const float center_depth = cached ? 0.0f : (slice_near + slice_far) * 0.5f;
+            const glm::vec3 far_corner = glm::vec3(tan_half_extent * slice_far, slice_far - center_depth);
+            const glm::vec3 center = camera.position() + camera.forward() * center_depth;
+            const float radius = std::ceil(glm::length(far_corner) * 16.0f) / 16.0f;
+
+            Cascade& cascade = _cascades[i];
+            cascade.rendered = false;
+
+            if (cached && cascade.valid && glm::distance(center, cascade.center) + radius <= cascade.radius)
+            {
+                slice_near = slice_far;
+                continue;
+            }
+
+            fit_cascade(cascade, center, cached ? radius * cache_margin : radius, rotation);
+            render_cascade(cascade, scene, terrain, terrain_program);
+            cascade.valid = true;
+            cascade.rendered = true;
+
+            slice_near = slice_far;
+        }
+
+        {
+            auto mapping = _data_buffer->map(AccessType::WriteOnly);
+            mapping[0].camera_view = camera.view_matrix();
+            for (u32 i = 0; i != max_cascades; ++i)
+            {
+                mapping[0].cascade_view_proj[i] = _cascades[i].view_proj;
+                mapping[0].cascade_splits[i] = i < _cascade_count ? splits[i] : 0.0f;
+                mapping[0].cascade_texel_sizes[i] = _cascades[i].texel_size;
+            }
+            mapping[0].cascade_count = _cascade_count;
+        }
+    }
+
+    void ShadowCascades::fit_cascade(Cascade& cascade, const glm::vec3& center, float radius,
+                                     const glm::mat3& light_rotation) const
+    {
+        cascade.radius = radius;
+        cascade.texel_size = 2.0f * radius / float(_resolution);
+
+        // Snap the center to texel increments so that moving the camera doesn't make the shadow edges shimmer
+        glm::vec3 light_center = light_rotation * center;
+        light_center.x = std::floor(light_center.x / cascade.texel_size) * cascade.texel_size;
+        light_center.y = std::floor(light_center.y / cascade.texel_size) * cascade.texel_size;
+        cascade.center = glm::transpose(light_rotation) * light_center;
+
+        const glm::mat4 view = glm::translate(glm::mat4(1.0f), -light_center) * glm::mat4(light_rotation);
+        const glm::mat4 proj =
+                Camera::orthographic(-radius, radius, -radius, radius, -(radius + caster_margin), radius);
+        cascade.view_proj = proj * view;
+    }
+
+    void ShadowCascades::render_cascade(const Cascade& cascade, const Scene& scene, const Terrain& terrain,
+                                        Program& terrain_program) const
+    {
+        cascade.framebuffer.bind(true, false);
+
+        // Casters between the sun and the near plane are flattened on it instead of being clipped
+        glEnable(GL_DEPTH_CLAMP);
+        // Reverse-Z: push depth away from the light
+        glEnable(GL_POLYGON_OFFSET_FILL);
+        glPolygonOffset(-1.5f, -2.0f);
+
+        scene.render_depth(cascade.view_proj);
+
+        terrain_program.bind();
+        terrain.render(terrain_program, scene.camera(), cascade.view_proj);
+
+        glDisable(GL_POLYGON_OFFSET_FILL);
+        glDisable(GL_DEPTH_CLAMP);
+    }
+
+    void ShadowCascades::bind() const
+    {
+        _data_buffer->bind(BufferUsage::Uniform, 2);
+        _shadow_map.bind(6);
+    }
+
+} // namespace OM3D
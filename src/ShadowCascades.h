@@ -0,0 +1,97 @@
+#ifndef SHADOWCASCADES_H
+#define SHADOWCASCADES_H
+
+#include <Framebuffer.h>
+#include <Program.h>
+#include <Scene.h>
+#include <Terrain.h>
+#include <Texture.h>
+#include <TypedBuffer.h>
+#include <shader_structs.h>
+
+#include <array>
+#include <memory>
+
+namespace OM3D
+{
+
+    // Sun shadows rendered into one layer of a depth texture array per cascade.
+    // Cascades are fitted to a bounding sphere of their slice of the camera frustum and snapped to shadow map texels
+    // so that shadows do not shimmer when the camera moves or rotates.
+    // Far cascades are fitted to a sphere around the camera with some margin, and only re-rendered when the sun, the
+    // scene or the terrain change, or when the camera moves out of the margin.
+    class ShadowCascades : NonMovable
+    {
+    public:
+        // Must match MAX_SHADOW_CASCADES in structs.glsl
+        static constexpr u32 max_cascades = 4;
+
+        static constexpr u32 default_resolution = 2048;
+
+        ShadowCascades(u32 resolution = default_resolution);
+
+        // Renders the cascades that need it, expects a depth program for the terrain patches
+        void render(const Scene& scene, const Terrain& terrain, Program& terrain_program);
+
+        // Bind the shadow data uniform buffer and the shadow map for shading
+        void bind() const;
+
+        Texture& shadow_map() { return _shadow_map; }
+
+        u32 cascade_count() const { return _cascade_count; }
+        void set_cascade_count(u32 count);
+
+        // Blend between logarithmic (1) and uniform (0) cascade splits
+        float split_lambda() const { return _split_lambda; }
+        void set_split_lambda(float lambda);
+
+        float max_distance() const { return _max_distance; }
+        void set_max_distance(float distance);
+
+        // Index of the first cascade allowed to reuse its previous content (max_cascades to disable caching)
+        u32 first_cached_cascade() const { return _first_cached; }
+        void set_first_cached_cascade(u32 index);
+
+        // Whether a cascade was re-rendered during the last call to render()
+        bool was_rendered(u32 cascade) const { return _cascades[cascade].rendered; }
+
+    private:
+        struct Cascade
+        {
+            Framebuffer framebuffer;
+            glm::mat4 view_proj = glm::mat4(1.0f);
+
+            // Area covered by the shadow map, in world space
+            glm::vec3 center = {};
+            float radius = 0.0f;
+            float texel_size = 0.0f;
+
+            bool valid = false;
+            bool rendered = false;
+        };
+
+        void invalidate();
+        void fit_cascade(Cascade& cascade, const glm::vec3& center, float radius, const glm::mat3& light_rotation) const;
+        void render_cascade(const Cascade& cascade, const Scene& scene, const Terrain& terrain,
+                            Program& terrain_program) const;
+
+        u32 _resolution = 0;
+
+        Texture _shadow_map;
+        std::array<Cascade, max_cascades> _cascades;
+        std::unique_ptr<TypedBuffer<shader::ShadowData>> _data_buffer;
+
+        u32 _cascade_count = max_cascades;
+        float _split_lambda = 0.75f;
+        float _max_distance = 500.0f;
+        u32 _first_cached = 2;
+
+        // State the cached cascades were rendered with
+        u32 _sun_version = u32(-1);
+        u32 _geometry_version = u32(-1);
+        u32 _terrain_generation = u32(-1);
+    };
+
+} // namespace OM3D
+
+#endif // SHADOWCASCADES_H
@@ -33,11 +33,23 @@ namespace OM3D
         StaticMesh(const MeshData& data);
 
         void draw() const;
+        void draw_instanced(u32 instance_count) const;
+
+        // Only feeds vertex positions (attribute 0), for depth only passes
+        void draw_positions_instanced(u32 instance_count) const;
 
         const BoundingSphere& bounding_sphere() const;
 
+        // Raw buffers, for passes that fetch vertices themselves (visibility buffer)
+        const TypedBuffer<Vertex>& vertex_buffer() const { return _vertex_buffer; }
+        const TypedBuffer<u32>& index_buffer() const { return _index_buffer; }
+
     private:
+        void bind_attributes() const;
+        void bind_positions() const;
+
         TypedBuffer<Vertex> _vertex_buffer;
+        TypedBuffer<glm::vec3> _position_buffer;
         TypedBuffer<u32> _index_buffer;
         BoundingSphere _bounding_sphere;
     };
@@ -0,0 +1,127 @@
+#include "TemporalAA.h"
+
+#include <graphics.h>
+
+#include <algorithm>
+#include <cmath>
+
+namespace OM3D
+{
+
+    static float halton(u32 index, u32 base)
+    {
+        float result = 0.0f;
+        float fraction = 1.0f;
+        for (; index; index /= base)
+        {
+            fraction /= float(base);
+            result += fraction * float(index % base);
+        }
+        return result;
+    }
+
+    TemporalAA::TemporalAA() : _resolve_program(Program::from_files("taa.frag", "screen.vert"))
+    {
+        _data_buffer = std::make_unique<TypedBuffer<shader::TemporalData>>(nullptr, 1);
+    }
+
+    void TemporalAA::set_enabled(bool enabled)
+    {
+        if (enabled != _enabled)
+        {
+            _enabled = enabled;
+            _history_valid = false;
+        }
+    }
+
+    void TemporalAA::set_blend_factor(float factor)
+    {
+        DEBUG_ASSERT(factor > 0.0f && factor <= 1.0f);
+        _blend_factor = factor;
+    }
+
+    void TemporalAA::begin_frame(Camera& camera, glm::uvec2 render_size, glm::uvec2 output_size)
+    {
+        _projection = camera.projection_matrix();
+        _view_proj = _projection * camera.view_matrix();
+        if (!_has_prev_frame)
+        {
+            _prev_view_proj = _view_proj;
+        }
+        _resolved = false;
+
+        if (_enabled)
+        {
+            if (!_history[0] || _history[0]->size() != output_size)
+            {
+                for (auto& history: _history)
+                {
+                    history = std::make_unique<Texture>(output_size, ImageFormat::RGBA16_FLOAT, WrapMode::Clamp);
+                }
+                _history_valid = false;
+            }
+
+            // Scale the sequence length with the upsampling ratio so that every output pixel receives samples
+            const glm::vec2 ratio = glm::vec2(output_size) / glm::vec2(render_size);
+            _phase_count = std::clamp(u32(std::ceil(8.0f * ratio.x * ratio.y)), 8u, 64u);
+
+            // Halton(2, 3) sequence, skipping the first point which is at the origin
+            const u32 phase = _frame_index++ % _phase_count + 1;
+            _jitter = glm::vec2(halton(phase, 2), halton(phase, 3)) - 0.5f;
+
+            // Offset in clip space so that it applies after the perspective divide
+            const glm::vec2 ndc_offset = 2.0f * _jitter / glm::vec2(render_size);
+            camera.set_proj(glm::translate(glm::mat4(1.0f), glm::vec3(ndc_offset, 0.0f)) * _projection);
+        }
+        else
+        {
+            _jitter = {};
+        }
+
+        {
+            auto mapping = _data_buffer->map(AccessType::WriteOnly);
+            mapping[0].view_proj = _view_proj;
+            mapping[0].prev_view_proj = _prev_view_proj;
+            mapping[0].reprojection = _prev_view_proj * glm::inverse(_view_proj);
+            mapping[0].jitter = _jitter;
+        }
+    }
+
+    void TemporalAA::end_frame(Camera& camera)
+    {
+        camera.set_proj(_projection);
+
+        _prev_view_proj = _view_proj;
+        _has_prev_frame = true;
+
+        if (_resolved)
+        {
+            _current = 1 - _current;
+        }
+        // The history is stale if the resolve was skipped (e.g. the pass was culled)
+        _history_valid = _resolved;
+    }
+
+    void TemporalAA::bind() const { _data_buffer->bind(BufferUsage::Uniform, 3); }
+
+    void TemporalAA::resolve(const Texture& color, const Texture& depth, const Texture& motion, glm::uvec2 render_size)
+    {
+        DEBUG_ASSERT(_enabled);
+
+        _resolve_program->bind();
+        _resolve_program->set_uniform(HASH("render_size"), render_size);
+        _resolve_program->set_uniform(HASH("blend_factor"), _history_valid ? _blend_factor : 1.0f);
+        _resolve_program->set_uniform(HASH("sharp_history"), u32(_sharp_history));
+
+        color.bind(0);
+        depth.bind(1);
+        motion.bind(2);
+        history().bind(3);
+        bind();
+
+        draw_full_screen_triangle();
+
+        _resolved = true;
+    }
+
+} // namespace OM3D
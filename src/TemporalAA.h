@@ -0,0 +1,83 @@
+#ifndef TEMPORALAA_H
+#define TEMPORALAA_H
+
+#include <Camera.h>
+#include <Program.h>
+#include <Texture.h>
+#include <TypedBuffer.h>
+#include <shader_structs.h>
+
+#include <array>
+#include <memory>
+
+namespace OM3D
+{
+
+    // Temporal anti-aliasing and upsampling.
+    // The scene is rendered with a sub-pixel jitter that changes every frame, possibly below the output resolution.
+    // The resolve reprojects a history kept at the output resolution using the motion vectors written to the G-buffer,
+    // clamps it to the neighborhood of the current samples to reject stale content and blends the new samples in.
+    class TemporalAA : NonMovable
+    {
+    public:
+        TemporalAA();
+
+        // Jitters the camera projection and uploads the temporal data, end_frame() restores the projection.
+        // The temporal data is also needed without TAA (motion vectors are always written by the G-buffer shaders).
+        void begin_frame(Camera& camera, glm::uvec2 render_size, glm::uvec2 output_size);
+        void end_frame(Camera& camera);
+
+        // Bind the temporal data uniform buffer
+        void bind() const;
+
+        // Resolve into the bound framebuffer, which should be next_history().
+        // Color, depth and motion are sampled in the top left render_size texels.
+        void resolve(const Texture& color, const Texture& depth, const Texture& motion, glm::uvec2 render_size);
+
+        // Accumulated frames, at the output resolution
+        Texture& history() { return *_history[_current]; }
+        Texture& next_history() { return *_history[1 - _current]; }
+
+        // Drop the accumulated frames (e.g. after a camera cut)
+        void reset_history() { _history_valid = false; }
+
+        bool enabled() const { return _enabled; }
+        void set_enabled(bool enabled);
+
+        // Weight of the current frame in the history
+        float blend_factor() const { return _blend_factor; }
+        void set_blend_factor(float factor);
+
+        // Use a Catmull-Rom filter instead of a bilinear one to sample the history, sharper at the cost of 9 taps
+        bool sharp_history() const { return _sharp_history; }
+        void set_sharp_history(bool sharp) { _sharp_history = sharp; }
+
+        // Number of different jitter offsets, more when upsampling so that every output pixel gets samples
+        u32 jitter_phase_count() const { return _phase_count; }
+
+    private:
+        std::shared_ptr<Program> _resolve_program;
+        std::unique_ptr<TypedBuffer<shader::TemporalData>> _data_buffer;
+
+        std::array<std::unique_ptr<Texture>, 2> _history;
+        u32 _current = 0;
+        bool _history_valid = false;
+        bool _resolved = false;
+
+        glm::mat4 _projection = glm::mat4(1.0f);
+        glm::mat4 _view_proj = glm::mat4(1.0f);
+        glm::mat4 _prev_view_proj = glm::mat4(1.0f);
+        glm::vec2 _jitter = {};
+        bool _has_prev_frame = false;
+
+        u32 _frame_index = 0;
+        u32 _phase_count = 8;
+
+        bool _enabled = true;
+        float _blend_factor = 0.1f;
+        bool _sharp_history = true;
+    };
+
+} // namespace OM3D
+
+#endif // TEMPORALAA_H
@@ -1,187 +1,1045 @@
 #include "Terrain.h"
 #include <glad/gl.h>
+#include <glm/gtc/type_precision.hpp>
+#include <algorithm>
+#include <cmath>
 #include <iostream>
+#include <limits>
+#include <optional>
 
 namespace OM3D
 {
 
+    // Fraction of a LOD range over which vertices morph into the next LOD
+    static constexpr float morph_region = 0.3f;
+
+    // LOD ranges are scaled by the height range of the blocks of the min/max pyramid relative to this slope, down to
+    // min_lod_scale for flat blocks. Must match lod_scale() in terrain.glsl
+    static constexpr float lod_reference_slope = 0.25f;
+    static constexpr float min_lod_scale = 0.5f;
+    // Scaled LOD ranges below twice the size of their nodes could make neighboring nodes differ by more than one LOD
+    static constexpr float min_lod_distance_ratio = 2.0f / min_lod_scale;
+
+    static bool intersects_sphere(const glm::vec3& aabb_min, const glm::vec3& aabb_max, const glm::vec3& center,
+                                  float radius)
+    {
+        const glm::vec3 closest = glm::clamp(center, aabb_min, aabb_max);
+        const glm::vec3 delta = closest - center;
+        return glm::dot(delta, delta) <= radius * radius;
+    }
+
+    static bool is_culled(const glm::vec3& aabb_min, const glm::vec3& aabb_max, const std::array<glm::vec4, 6>& planes)
+    {
+        for (const glm::vec4& plane: planes)
+        {
+            // Corner of the box the furthest along the plane normal
+            const glm::vec3 p = glm::mix(aabb_min, aabb_max, glm::step(glm::vec3(0.0f), glm::vec3(plane)));
+            if (glm::dot(glm::vec3(plane), p) + plane.w < 0.0f)
+            {
+                return true;
+            }
+        }
+        return false;
+    }
+
+    // Floor division, for texel and node coordinates that can be negative
+    static glm::ivec2 floor_div(const glm::vec2& value, float divisor)
+    {
+        return glm::ivec2(glm::floor(value / divisor));
+    }
+
+    // Size of the material textures, missing or mismatched ones are replaced by constants
+    static constexpr u32 material_texture_size = 2048;
+
+    struct MaterialFiles
+    {
+        std::string albedo;
+        std::string normal;
+        // Either an AO/roughness/metalness map or separate ones, empty when missing
+        std::string packed_arm;
+        std::string ao;
+        std::string roughness;
+        std::string metallic;
+        glm::u8vec3 fallback_albedo = glm::u8vec3(128);
+    };
+
+    static const std::string material_directory = "../../textures/";
+
+    static std::optional<TextureData> load_material_texture(const std::string& file)
+    {
+        if (file.empty())
+        {
+            return std::nullopt;
+        }
+
+        auto result = TextureData::from_file(material_directory + file);
+        if (!result.is_ok)
+        {
+            std::cerr << "Failed to load texture: " << file << std::endl;
+            return std::nullopt;
+        }
+        if (result.value.size != glm::uvec2(material_texture_size))
+        {
+            std::cerr << "Terrain texture " << file << " is not " << material_texture_size << "x"
+                      << material_texture_size << std::endl;
+            return std::nullopt;
+        }
+        return std::move(result.value);
+    }
+
+    // Channel of an RGBA8 texel, or the fallback when the texture is missing
+    static u8 texel_channel(const std::optional<TextureData>& texture, size_t texel, u32 channel, u8 fallback)
+    {
+        return texture ? texture->data[texel * 4 + channel] : fallback;
+    }
+
+    static TextureData empty_material_texture(ImageFormat format)
+    {
+        TextureData data;
+        data.size = glm::uvec2(material_texture_size);
+        data.format = format;
+        data.data = std::make_unique<u8[]>(size_t(material_texture_size) * material_texture_size * 4);
+        return data;
+    }
+
     Terrain::Terrain() {}
 
-    void Terrain::init(std::shared_ptr<Program> compute_program, std::shared_ptr<Texture> heightmap)
+    Terrain::~Terrain()
+    {
+        if (_vao)
+            glDeleteVertexArrays(1, &_vao);
+        if (_bounds_fence)
+            glDeleteSync(_bounds_fence);
+    }
+
+    void Terrain::init(std::shared_ptr<Program> compute_program)
     {
         _compute_program = std::move(compute_program);
-        _heightmap = std::move(heightmap);
+        _surface_program = Program::from_file("terrain_surface.comp");
+        _bounds_program = Program::from_file("terrain_bounds.comp");
+        _bake_program = Program::from_file("terrain_rvt_bake.comp");
+
+        // Repeat makes bilinear filtering wrap around with the toroidal addressing
+        _clipmap = std::make_unique<Texture>(glm::uvec2(clipmap_resolution), clipmap_levels, ImageFormat::R16_UNORM,
+                                             WrapMode::Repeat);
+        glTextureParameteri(_clipmap->id(), GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+        glTextureParameteri(_clipmap->id(), GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+        _normal_clipmap = std::make_unique<Texture>(glm::uvec2(clipmap_resolution), clipmap_levels,
+                                                    ImageFormat::RGBA8_UNORM, WrapMode::Repeat);
+        glTextureParameteri(_normal_clipmap->id(), GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+        glTextureParameteri(_normal_clipmap->id(), GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+        _splat_clipmap = std::make_unique<Texture>(glm::uvec2(clipmap_resolution), clipmap_levels,
+                                                   ImageFormat::RGBA8_UNORM, WrapMode::Repeat);
+        glTextureParameteri(_splat_clipmap->id(), GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+        glTextureParameteri(_splat_clipmap->id(), GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+
+        _bounds = std::make_unique<Texture>(glm::uvec2(clipmap_resolution / 2), clipmap_levels,
+                                            ImageFormat::RG16_UNORM, WrapMode::Repeat, bounds_mip_count);
+        // Patches filter the last mip to scale their LOD ranges (see terrain.glsl)
+        glTextureParameteri(_bounds->id(), GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_NEAREST);
+        glTextureParameteri(_bounds->id(), GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+        const u32 blocks = clipmap_resolution / bounds_block_size;
+        _bounds_readback = std::make_unique<ByteBuffer>(
+                nullptr, blocks * blocks * clipmap_levels * bytes_per_texel(ImageFormat::RG16_UNORM));
+
+        _height_mirror.set_scale_bias(height_scale_bias());
+
+        load_materials();
+        _virtual_texture = std::make_unique<TerrainVirtualTexture>();
+
+        glCreateVertexArrays(1, &_vao);
+    }
+
+    void Terrain::load_materials()
+    {
+        // Must match the layers of the splat map (see terrain_surface.comp)
+        const std::array<MaterialFiles, 4> materials = {{
+                {"moss_ground_02_2k/moss_groud_02_Base_Color_2k.png",
+                 "moss_ground_02_2k/moss_groud_02_Normal_gl_2k.png",
+                 "moss_ground_02_2k/moss_groud_02_ao_r_m_h_2k.png", "", "", "", glm::u8vec3(90, 110, 60)},
+                {"grass_01_2k/grass_01_color_2k.png", "grass_01_2k/grass_01_normal_gl_2k.png", "",
+                 "grass_01_2k/grass_01_ambient_occlusion_2k.png", "grass_01_2k/grass_01_roughness_2k.png", "",
+                 glm::u8vec3(70, 100, 50)},
+                {"cliff_rocks_02_2k/cliff_rocks_02_baseColor_2k.png", "",
+                 "cliff_rocks_02_2k/cliff_rocks_02_ao_r_m_h_2k.png", "", "", "", glm::u8vec3(120, 115, 110)},
+                {"snow_01_2k/snow_01_color_2k.png", "snow_01_2k/snow_01_normal_gl_2k.png", "",
+                 "snow_01_2k/snow_01_ambient_occlusion_2k.png", "snow_01_2k/snow_01_roughness_2k.png", "",
+                 glm::u8vec3(230, 235, 240)},
+        }};
+
+        std::vector<TextureData> albedo_layers;
+        std::vector<TextureData> normal_layers;
+        for (const MaterialFiles& files: materials)
+        {
+            const std::optional<TextureData> albedo = load_material_texture(files.albedo);
+            const std::optional<TextureData> normal = load_material_texture(files.normal);
+            const std::optional<TextureData> packed_arm = load_material_texture(files.packed_arm);
+            const std::optional<TextureData> ao = load_material_texture(files.ao);
+            const std::optional<TextureData> roughness = load_material_texture(files.roughness);
+            const std::optional<TextureData> metallic = load_material_texture(files.metallic);
+
+            TextureData albedo_roughness = empty_material_texture(ImageFormat::RGBA8_sRGB);
+            TextureData normal_ao_metal = empty_material_texture(ImageFormat::RGBA8_UNORM);
+            const size_t texel_count = size_t(material_texture_size) * material_texture_size;
+            for (size_t i = 0; i != texel_count; ++i)
+            {
+                u8* albedo_texel = albedo_roughness.data.get() + i * 4;
+                albedo_texel[0] = texel_channel(albedo, i, 0, files.fallback_albedo.r);
+                albedo_texel[1] = texel_channel(albedo, i, 1, files.fallback_albedo.g);
+                albedo_texel[2] = texel_channel(albedo, i, 2, files.fallback_albedo.b);
+                albedo_texel[3] = texel_channel(roughness, i, 0, texel_channel(packed_arm, i, 1, 255));
+
+                u8* normal_texel = normal_ao_metal.data.get() + i * 4;
+                normal_texel[0] = texel_channel(normal, i, 0, 128);
+                normal_texel[1] = texel_channel(normal, i, 1, 128);
+                normal_texel[2] = texel_channel(ao, i, 0, texel_channel(packed_arm, i, 0, 255));
+                normal_texel[3] = texel_channel(metallic, i, 0, texel_channel(packed_arm, i, 2, 0));
+            }
+
+            albedo_layers.push_back(std::move(albedo_roughness));
+            normal_layers.push_back(std::move(normal_ao_metal));
+        }
+
+        _material_albedo = std::make_unique<Texture>(albedo_layers);
+        _material_normal = std::make_unique<Texture>(normal_layers);
+    }
+
+    void Terrain::set_noise_frequency(float frequency)
+    {
+        DEBUG_ASSERT(frequency > 0.0f);
+        _noise_frequency = frequency;
+        _generator = nullptr;
+        if (!_heightfield)
+        {
+            // Every texel changes, there is nothing to track
+            invalidate();
+        }
+    }
+
+    void Terrain::set_height_scale(float scale)
+    {
+        DEBUG_ASSERT(scale > 0.0f);
+        if (scale == _height_scale)
+        {
+            return;
+        }
+
+        const float ratio = scale / _height_scale;
+        _height_scale = scale;
+        if (_heightfield)
+        {
+            // Heightfields are stored with their own range, the scale applies to the noise once it is unloaded
+            return;
+        }
+        _height_mirror.set_scale_bias(height_scale_bias());
+
+        // Heights are proportional to the scale, the pending readback is converted with the new one
+        for (glm::vec2& bounds: _block_bounds)
+        {
+            bounds *= ratio;
+        }
+        _height_mirror.update_bounds();
+        // Offsets are in world units, their normalized values change
+        _edits.mark_dirty();
+        _surface_dirty = true;
+        if (_virtual_texture)
+        {
+            _virtual_texture->invalidate();
+        }
+        ++_generation;
+    }
+
+    bool Terrain::load_heightfield(const std::string& file_name)
+    {
+        auto result = HeightTileFile::open(file_name);
+        if (!result.is_ok)
+        {
+            std::cerr << "Failed to open heightfield: " << file_name << std::endl;
+            return false;
+        }
+
+        _heightfield = std::make_unique<HeightTileLoader>(std::move(result.value));
+        _height_mirror.set_scale_bias(height_scale_bias());
+        _generator = nullptr;
+        invalidate();
+        return true;
+    }
+
+    void Terrain::unload_heightfield()
+    {
+        if (_heightfield)
+        {
+            _heightfield = nullptr;
+            _height_mirror.set_scale_bias(height_scale_bias());
+            invalidate();
+        }
+    }
+
+    void Terrain::add_stamp(const glm::vec2& center, float radius, float height)
+    {
+        _edits.add_stamp(center, radius, height);
+        ++_generation;
+    }
+
+    void Terrain::clear_edits()
+    {
+        if (!_edits.empty())
+        {
+            _edits.clear();
+            ++_generation;
+        }
+    }
+
+    void Terrain::invalidate()
+    {
+        _clipmap_valid = false;
+        _height_mirror.clear();
+        _loading_regions.clear();
+        if (_heightfield)
+        {
+            _heightfield->cancel();
+        }
+        _block_bounds.clear();
+        if (_bounds_fence)
+        {
+            glDeleteSync(_bounds_fence);
+            _bounds_fence = nullptr;
+        }
+        if (_virtual_texture)
+        {
+            _virtual_texture->invalidate();
+        }
+        ++_generation;
+    }
+
+    void Terrain::update(const glm::vec3& camera_pos)
+    {
+        if (!_compute_program || !_clipmap)
+        {
+            return;
+        }
 
-        // Load terrain material textures
-        auto load_texture = [](const std::string& path) -> std::shared_ptr<Texture>
+        // Created when the noise is needed, so never while a heightfield is loaded
+        if (!_heightfield && !_generator)
         {
-            auto result = TextureData::from_file(path);
-            if (result.is_ok)
+            _generator = std::make_unique<TerrainGenerator>(
+                    TerrainGenerator::Settings{_noise_frequency, clipmap_texel_size});
+        }
+
+        std::array<glm::ivec2, clipmap_levels> origins = {};
+        for (u32 level = 0; level != clipmap_levels; ++level)
+        {
+            // Windows are snapped to even texels so that every level is aligned on the texels of the next one
+            const float texel_size = clipmap_texel_size * float(1u << level);
+            origins[level] = floor_div(glm::vec2(camera_pos.x, camera_pos.z), texel_size * 2.0f) * 2 -
+                             glm::ivec2(i32(clipmap_resolution) / 2);
+        }
+
+        if (_heightfield)
+        {
+            stream_heightfield(origins);
+        }
+        else
+        {
+            std::vector<Region> regions = window_regions(origins);
+            _level_origins = origins;
+            _clipmap_valid = true;
+
+            // Edited tiles are generated on the CPU only
+            const size_t first_edited_region = regions.size();
+            for (u32 level = 0; level != clipmap_levels; ++level)
+            {
+                add_edited_regions(level, origins[level], regions);
+            }
+
+            if (!regions.empty())
             {
-                return std::make_shared<Texture>(result.value);
+                for (size_t i = 0; i != first_edited_region; ++i)
+                {
+                    generate_heights(regions[i]);
+                }
+                // Uploads overwrite the edited texels of the generated regions
+                glMemoryBarrier(GL_TEXTURE_UPDATE_BARRIER_BIT | GL_TEXTURE_FETCH_BARRIER_BIT);
+                write_regions(regions, first_edited_region, first_edited_region, {});
             }
-            std::cerr << "Failed to load texture: " << path << std::endl;
-            return nullptr;
-        };
+        }
 
-        _grass_albedo = load_texture("../../textures/moss_ground_02_2k/moss_groud_02_Base_Color_2k.png");
-        _forest_albedo = load_texture("../../textures/grass_01_2k/grass_01_color_2k.png");
-        _rocks_albedo = load_texture("../../textures/cliff_rocks_02_2k/cliff_rocks_02_baseColor_2k.png");
-        _snow_albedo = load_texture("../../textures/snow_01_2k/snow_01_color_2k.png");
+        if (_surface_dirty)
+        {
+            for (u32 level = 0; level != clipmap_levels; ++level)
+            {
+                generate_surface({level, _level_origins[level], glm::uvec2(clipmap_resolution)});
+            }
+            glMemoryBarrier(GL_TEXTURE_FETCH_BARRIER_BIT);
+            _surface_dirty = false;
+        }
+        read_back_bounds();
 
-        generate_grid_mesh(512);
-        update();
+        if (_virtual_texture_enabled && _clipmap_valid)
+        {
+            update_virtual_texture(camera_pos);
+        }
     }
 
-    void Terrain::update()
+    std::vector<Terrain::Region> Terrain::window_regions(const std::array<glm::ivec2, clipmap_levels>& origins) const
     {
-        if (!_compute_program || !_heightmap)
+        const i32 resolution = i32(clipmap_resolution);
+        std::vector<Region> regions;
+        for (u32 level = 0; level != clipmap_levels; ++level)
+        {
+            const glm::ivec2 origin = origins[level];
+            const glm::ivec2 prev_origin = _level_origins[level];
+            const glm::ivec2 delta = origin - prev_origin;
+            if (!_clipmap_valid || std::abs(delta.x) >= resolution || std::abs(delta.y) >= resolution)
+            {
+                regions.push_back({level, origin, glm::uvec2(clipmap_resolution)});
+                continue;
+            }
+
+            // Columns and rows that entered the window, they overwrite the ones that left it
+            if (delta.x != 0)
+            {
+                const i32 first = delta.x > 0 ? prev_origin.x + resolution : origin.x;
+                regions.push_back({level, glm::ivec2(first, origin.y), glm::uvec2(std::abs(delta.x), resolution)});
+            }
+            if (delta.y != 0)
+            {
+                const i32 first = delta.y > 0 ? prev_origin.y + resolution : origin.y;
+                regions.push_back({level, glm::ivec2(origin.x, first), glm::uvec2(resolution, std::abs(delta.y))});
+            }
+        }
+        return regions;
+    }
+
+    void Terrain::stream_heightfield(const std::array<glm::ivec2, clipmap_levels>& origins)
+    {
+        // Windows only move once the loader has read the texels that enter them. Until then the previous windows are
+        // kept, and the terrain that left the finer ones uses the coarser levels that still cover it
+        std::vector<std::vector<u16>> values;
+        if (_heightfield->take_values(values))
+        {
+            _level_origins = _loading_origins;
+            _clipmap_valid = true;
+            // Pages baked while the windows lagged behind used coarser levels, they are baked again too
+            write_regions(_loading_regions, 0, 0, std::move(values));
+            _loading_regions.clear();
+        }
+        if (_heightfield->is_busy())
+        {
+            return;
+        }
+
+        std::vector<Region> regions = window_regions(origins);
+        for (u32 level = 0; level != clipmap_levels; ++level)
+        {
+            add_edited_regions(level, origins[level], regions);
+        }
+        if (regions.empty())
+        {
+            return;
+        }
+
+        std::vector<HeightTileLoader::Read> reads;
+        for (const Region& region: regions)
+        {
+            reads.push_back({region.origin, region.size, clipmap_texel_size * float(1u << region.level)});
+        }
+        // The tiles around the windows are the ones the next scrolls read
+        const i32 margin = i32(clipmap_resolution / 8);
+        std::vector<HeightTileLoader::Read> prefetched;
+        for (u32 level = 0; level != clipmap_levels; ++level)
+        {
+            prefetched.push_back({origins[level] - margin, glm::uvec2(clipmap_resolution + 2 * margin),
+                                  clipmap_texel_size * float(1u << level)});
+        }
+        _heightfield->request(std::move(reads), std::move(prefetched), height_scale_bias());
+
+        _loading_regions = std::move(regions);
+        _loading_origins = origins;
+    }
+
+    void Terrain::write_regions(const std::vector<Region>& regions, size_t first_invalidated_region,
+                                size_t first_uploaded_region, std::vector<std::vector<u16>> loaded_values)
+    {
+        update_mirror(regions, first_uploaded_region, loaded_values);
+
+        for (const Region& region: regions)
+        {
+            generate_surface(region);
+        }
+        glMemoryBarrier(GL_TEXTURE_FETCH_BARRIER_BIT);
+
+        build_bounds(regions);
+
+        // Normals and weights reach two texels around the heights
+        for (size_t i = first_invalidated_region; i != regions.size(); ++i)
+        {
+            const float texel_size = clipmap_texel_size * float(1u << regions[i].level);
+            const glm::ivec2 last = regions[i].origin + glm::ivec2(regions[i].size) - 1;
+            _virtual_texture->invalidate(glm::vec2(regions[i].origin - 2) * texel_size,
+                                         glm::vec2(last + 2) * texel_size);
+        }
+    }
+
+    void Terrain::update_virtual_texture(const glm::vec3& camera_pos)
+    {
+        // Pages can only be final where the last level has heights
+        const u32 last_level = clipmap_levels - 1;
+        const float last_texel_size = clipmap_texel_size * float(1u << last_level);
+        const glm::vec2 coverage_min = glm::vec2(_level_origins[last_level]) * last_texel_size;
+        const glm::vec2 coverage_max = coverage_min + float(clipmap_resolution - 1) * last_texel_size;
+
+        const std::vector<TerrainVirtualTexture::Page> pages =
+                _virtual_texture->update(camera_pos, coverage_min, coverage_max);
+        if (pages.empty())
         {
             return;
         }
 
-        // Dispatch Compute - generate heightmap centered at origin
+        std::array<glm::vec4, RVT_MAX_BAKES> bake_pages = {};
+        for (size_t i = 0; i != pages.size(); ++i)
+        {
+            const float page_size = TerrainVirtualTexture::page_size(pages[i].mip);
+            bake_pages[i] = glm::vec4(glm::vec2(pages[i].coord) * page_size, page_size / float(RVT_PAGE_SIZE),
+                                      float(pages[i].layer));
+        }
+
+        _bake_program->bind();
+        _bake_program->set_uniform(HASH("u_bake_pages"), bake_pages);
+        set_clipmap_uniforms(*_bake_program);
+        bind_textures();
+        _virtual_texture->albedo_pages().bind_as_image(0, AccessType::WriteOnly);
+        _virtual_texture->normal_pages().bind_as_image(1, AccessType::WriteOnly);
+
+        const u32 groups = (TerrainVirtualTexture::physical_page_size + 7) / 8;
+        glDispatchCompute(groups, groups, u32(pages.size()));
+        glMemoryBarrier(GL_TEXTURE_FETCH_BARRIER_BIT);
+    }
+
+    void Terrain::add_edited_regions(u32 level, const glm::ivec2& window_origin, std::vector<Region>& regions)
+    {
+        std::vector<glm::ivec2> tiles = _edits.take_dirty_tiles(level);
+        std::sort(tiles.begin(), tiles.end(),
+                  [](const glm::ivec2& a, const glm::ivec2& b) { return a.y != b.y ? a.y < b.y : a.x < b.x; });
+
+        const i32 tile_size = i32(TerrainEdits::tile_size);
+        const glm::ivec2 window_last = window_origin + i32(clipmap_resolution) - 1;
+        for (size_t i = 0; i != tiles.size();)
+        {
+            // Consecutive tiles of a row are merged into one region
+            size_t end = i + 1;
+            while (end != tiles.size() && tiles[end] == tiles[end - 1] + glm::ivec2(1, 0))
+            {
+                ++end;
+            }
+
+            const glm::ivec2 first = glm::max(tiles[i] * tile_size, window_origin);
+            const glm::ivec2 last = glm::min((tiles[end - 1] + 1) * tile_size - 1, window_last);
+            if (glm::all(glm::lessThanEqual(first, last)))
+            {
+                regions.push_back({level, first, glm::uvec2(last - first + 1)});
+            }
+            i = end;
+        }
+    }
+
+    void Terrain::upload_heights(const Region& region, const u16* values) const
+    {
+        const i32 resolution = i32(clipmap_resolution);
+        glPixelStorei(GL_UNPACK_ALIGNMENT, 2);
+        glPixelStorei(GL_UNPACK_ROW_LENGTH, GLint(region.size.x));
+
+        // Split where the region wraps around the toroidal storage
+        for (i32 y = 0; y < i32(region.size.y);)
+        {
+            const i32 storage_y = (((region.origin.y + y) % resolution) + resolution) % resolution;
+            const i32 rows = std::min(i32(region.size.y) - y, resolution - storage_y);
+            for (i32 x = 0; x < i32(region.size.x);)
+            {
+                const i32 storage_x = (((region.origin.x + x) % resolution) + resolution) % resolution;
+                const i32 columns = std::min(i32(region.size.x) - x, resolution - storage_x);
+                glTextureSubImage3D(_clipmap->id(), 0, storage_x, storage_y, GLint(region.level), columns, rows, 1,
+                                    GL_RED, GL_UNSIGNED_SHORT, values + size_t(y) * region.size.x + size_t(x));
+                x += columns;
+            }
+            y += rows;
+        }
+
+        glPixelStorei(GL_UNPACK_ROW_LENGTH, 0);
+        glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+    }
+
+    void Terrain::generate_heights(const Region& region) const
+    {
         _compute_program->bind();
-        _compute_program->set_uniform(HASH("u_camera_pos"), glm::vec2(0.0f, 0.0f));
-        _compute_program->set_uniform(HASH("u_scale"), _size);
+        // Integer texel coordinates, exact as floats for any reasonable world size
+        _compute_program->set_uniform(HASH("u_region_origin"), glm::vec2(region.origin));
+        _compute_program->set_uniform(HASH("u_region_size"), region.size);
+        _compute_program->set_uniform(HASH("u_level"), region.level);
+        _compute_program->set_uniform(HASH("u_texel_size"), clipmap_texel_size * float(1u << region.level));
         _compute_program->set_uniform(HASH("u_noise_freq_scale"), _noise_frequency);
-        _compute_program->set_uniform(HASH("u_height_scale"), _height_scale);
 
-        // Bind image
-        glBindImageTexture(0, _heightmap->id(), 0, GL_FALSE, 0, GL_WRITE_ONLY, GL_R32F);
+        _clipmap->bind_as_image(0, AccessType::WriteOnly);
+        glDispatchCompute((region.size.x + 15) / 16, (region.size.y + 15) / 16, 1);
+    }
+
+    void Terrain::generate_surface(const Region& region) const
+    {
+        // The texels next to the region had one of their neighbors replaced, they are updated too
+        const glm::ivec2 window_first = _level_origins[region.level];
+        const glm::ivec2 window_last = window_first + i32(clipmap_resolution) - 1;
+        const glm::ivec2 first = glm::max(region.origin - 1, window_first);
+        const glm::ivec2 last = glm::min(region.origin + glm::ivec2(region.size), window_last);
+        const glm::uvec2 size = glm::uvec2(last - first + 1);
 
-        glm::uvec2 size = _heightmap->size();
+        _surface_program->bind();
+        _surface_program->set_uniform(HASH("u_region_origin"), glm::vec2(first));
+        _surface_program->set_uniform(HASH("u_region_size"), size);
+        _surface_program->set_uniform(HASH("u_level"), region.level);
+        _surface_program->set_uniform(HASH("u_texel_size"), clipmap_texel_size * float(1u << region.level));
+        _surface_program->set_uniform(HASH("u_height_scale_bias"), height_scale_bias());
+
+        _clipmap->bind(0);
+        _normal_clipmap->bind_as_image(0, AccessType::WriteOnly);
+        _splat_clipmap->bind_as_image(1, AccessType::WriteOnly);
         glDispatchCompute((size.x + 15) / 16, (size.y + 15) / 16, 1);
+    }
+
+    void Terrain::build_bounds(const std::vector<Region>& regions)
+    {
+        _bounds_program->bind();
+        _clipmap->bind(0);
+        _bounds->bind(1);
+
+        for (u32 mip = 0; mip != bounds_mip_count; ++mip)
+        {
+            _bounds_program->set_uniform(HASH("u_source_mip"), mip);
+            _bounds->bind_as_image(0, AccessType::WriteOnly, mip);
+
+            // Texels of the mip covering the regions, a region never covers more than the whole mip
+            const float texels_per_bound = float(2u << mip);
+            const glm::uvec2 mip_size = glm::uvec2(clipmap_resolution >> (mip + 1));
+            for (const Region& region: regions)
+            {
+                const glm::ivec2 first = floor_div(glm::vec2(region.origin), texels_per_bound);
+                const glm::ivec2 last =
+                        floor_div(glm::vec2(region.origin + glm::ivec2(region.size) - 1), texels_per_bound);
+                const glm::uvec2 size = glm::min(glm::uvec2(last - first + 1), mip_size);
+                _bounds_program->set_uniform(HASH("u_region_origin"), glm::vec2(first));
+                _bounds_program->set_uniform(HASH("u_region_size"), size);
+                _bounds_program->set_uniform(HASH("u_level"), region.level);
+                glDispatchCompute((size.x + 7) / 8, (size.y + 7) / 8, 1);
+            }
+            glMemoryBarrier(GL_TEXTURE_FETCH_BARRIER_BIT);
+        }
 
-        glMemoryBarrier(GL_SHADER_IMAGE_ACCESS_BARRIER_BIT);
+        _bounds_dirty = true;
     }
 
-    void Terrain::set_common_uniforms(Program& program, const Camera& camera) const
+    void Terrain::read_back_bounds()
     {
-        // Keep terrain fixed at world origin instead of following camera
-        program.set_uniform(HASH("u_camera_pos_xz"), glm::vec2(0.0f, 0.0f));
-        program.set_uniform(HASH("u_view_proj"), camera.view_proj_matrix());
-        program.set_uniform(HASH("u_model_view"), camera.view_matrix() * glm::mat4(1.0f));
-        program.set_uniform(HASH("u_terrain_size"), _size);
-        program.set_uniform(HASH("u_height_scale"), _height_scale);
-        program.set_uniform(HASH("u_max_dist"), _size * 2.0f);
-        program.set_uniform(HASH("u_model"), glm::mat4(1.0f));
-        program.set_uniform(HASH("u_frustum"), camera.build_frustum());
-        program.set_uniform(HASH("u_tesselation_factor"), _tesselation_factor);
+        if (_bounds_fence)
+        {
+            // Never wait for the GPU, the previous bounds are used in the meantime
+            if (glClientWaitSync(_bounds_fence, 0, 0) == GL_TIMEOUT_EXPIRED)
+            {
+                return;
+            }
+            glDeleteSync(_bounds_fence);
+            _bounds_fence = nullptr;
+
+            const u32 block_count = u32(_bounds_readback->byte_size() / sizeof(glm::u16vec2));
+            const glm::vec2 scale_bias = height_scale_bias();
+            auto mapping = _bounds_readback->map_bytes(AccessType::ReadOnly);
+            const glm::u16vec2* values = reinterpret_cast<const glm::u16vec2*>(mapping.data());
+            _block_bounds.resize(block_count);
+            for (u32 i = 0; i != block_count; ++i)
+            {
+                _block_bounds[i] = glm::vec2(values[i]) / 65535.0f * scale_bias.x + scale_bias.y;
+            }
+            _block_bounds_origins = _readback_origins;
+        }
+
+        if (_bounds_dirty)
+        {
+            glMemoryBarrier(GL_TEXTURE_UPDATE_BARRIER_BIT);
+            _bounds_readback->bind(BufferUsage::PixelPack);
+            glGetTextureImage(_bounds->id(), bounds_mip_count - 1, GL_RG, GL_UNSIGNED_SHORT,
+                              GLsizei(_bounds_readback->byte_size()), nullptr);
+            glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+            _bounds_fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+
+            _readback_origins = _level_origins;
+            _bounds_dirty = false;
+        }
     }
 
-    void Terrain::render(Program& program, const Camera& camera) const
+    void Terrain::update_mirror(const std::vector<Region>& regions, size_t first_uploaded_region,
+                                std::vector<std::vector<u16>>& loaded_values)
     {
-        if (!_heightmap || _vao == 0 || _index_count == 0)
+        std::vector<u16> generated;
+        for (size_t i = 0; i != regions.size(); ++i)
         {
-            return;
+            const Region& region = regions[i];
+            std::vector<u16>& values = loaded_values.empty() ? generated : loaded_values[i];
+            if (loaded_values.empty())
+            {
+                generated.resize(size_t(region.size.x) * region.size.y);
+                _generator->generate(region.level, region.origin, region.size, generated.data());
+#ifdef OM3D_DEBUG
+                // Whole levels are only generated after invalidations
+                if (i < first_uploaded_region && region.size == glm::uvec2(clipmap_resolution))
+                {
+                    check_generated_heights(region, generated.data());
+                }
+#endif
+            }
+
+            // The GPU generates heights without the edits
+            const bool edited = _edits.is_edited(region.level, region.origin, region.size);
+            if (edited)
+            {
+                _edits.apply(region.level, region.origin, region.size, height_scale_bias(), values.data());
+            }
+            if (edited || i >= first_uploaded_region)
+            {
+                upload_heights(region, values.data());
+            }
+
+            _height_mirror.write_region(region.level, region.origin, region.size, values.data());
+        }
+        for (u32 level = 0; level != clipmap_levels; ++level)
+        {
+            _height_mirror.set_window(level, _level_origins[level]);
         }
+        _height_mirror.update_bounds();
+    }
 
-        glEnable(GL_DEPTH_TEST);
-        glDepthFunc(GL_GEQUAL); // Reverse-Z
-        glDepthMask(GL_TRUE);
-        glEnable(GL_CULL_FACE);
-        glCullFace(GL_BACK);
+    void Terrain::check_generated_heights(const Region& region, const u16* values) const
+    {
+        // First texels of the region, up to where they wrap around the storage
+        const glm::ivec2 storage = region.origin & i32(clipmap_resolution - 1);
+        const glm::uvec2 size = glm::min(glm::uvec2(64), glm::uvec2(i32(clipmap_resolution) - storage));
+        std::vector<u16> gpu_values(size_t(size.x) * size.y);
+        glPixelStorei(GL_PACK_ALIGNMENT, 2);
+        glGetTextureSubImage(_clipmap->id(), 0, storage.x, storage.y, GLint(region.level), GLsizei(size.x),
+                             GLsizei(size.y), 1, GL_RED, GL_UNSIGNED_SHORT, GLsizei(gpu_values.size() * sizeof(u16)),
+                             gpu_values.data());
+        glPixelStorei(GL_PACK_ALIGNMENT, 4);
 
-        // Bind heightmap texture
-        _heightmap->bind(0);
+        i32 max_difference = 0;
+        for (u32 y = 0; y != size.y; ++y)
+        {
+            for (u32 x = 0; x != size.x; ++x)
+            {
+                const i32 gpu_value = i32(gpu_values[size_t(y) * size.x + x]);
+                const i32 cpu_value = i32(values[size_t(y) * region.size.x + x]);
+                max_difference = std::max(max_difference, std::abs(gpu_value - cpu_value));
+            }
+        }
+        if (max_difference > 1)
+        {
+            std::cerr << "Terrain level " << region.level << " differs by " << max_difference
+                      << " steps between the GPU and the CPU" << std::endl;
+        }
+    }
 
-        // Bind terrain material textures
-        if (_grass_albedo)
-            _grass_albedo->bind(1);
-        if (_forest_albedo)
-            _forest_albedo->bind(2);
-        if (_rocks_albedo)
-            _rocks_albedo->bind(3);
-        if (_snow_albedo)
-            _snow_albedo->bind(4);
+    void Terrain::heights(Span<const glm::vec2> positions, Span<float> heights) const
+    {
+        _height_mirror.heights(positions, heights);
+    }
 
-        // Set terrain-specific uniforms
-        set_common_uniforms(program, camera);
+    void Terrain::raycast(Span<const TerrainRay> rays, Span<TerrainHit> hits) const
+    {
+        _height_mirror.raycast(rays, hits);
+    }
 
-        // Set sampler uniforms for terrain textures (must use i32, not u32)
-        program.set_uniform(HASH("u_grass_albedo"), 1);
-        program.set_uniform(HASH("u_forest_albedo"), 2);
-        program.set_uniform(HASH("u_rocks_albedo"), 3);
-        program.set_uniform(HASH("u_snow_albedo"), 4);
+    glm::vec2 Terrain::height_scale_bias() const
+    {
+        if (_heightfield)
+        {
+            // The range of the file, so that its values are only rounded once (by the filtering)
+            const glm::vec2 range = _heightfield->file().height_range();
+            return glm::vec2(range.y > range.x ? range.y - range.x : 1.0f, range.x);
+        }
+        return glm::vec2(2.0f * _height_scale, -_height_scale);
+    }
 
-        // Save previous VAO state
-        GLint prev_vao = 0;
-        glGetIntegerv(GL_VERTEX_ARRAY_BINDING, &prev_vao);
+    Terrain::NodeBounds Terrain::node_bounds(const glm::vec2& origin, float size) const
+    {
+        const glm::vec2 scale_bias = height_scale_bias();
+        const NodeBounds full_range = {glm::vec2(scale_bias.y, scale_bias.y + scale_bias.x), 1.0f};
+        if (_block_bounds.empty())
+        {
+            return full_range;
+        }
 
-        // Draw terrain patches
-        glBindVertexArray(_vao);
-        glPatchParameteri(GL_PATCH_VERTICES, 4);
-        // glPolygonMode(GL_FRONT_AND_BACK, GL_LINE);
-        glDrawElements(GL_PATCHES, _index_count, GL_UNSIGNED_INT, nullptr);
-        // glPolygonMode(GL_FRONT_AND_BACK, GL_FILL); // restore to normal
+        const i32 resolution = i32(clipmap_resolution);
+        const i32 blocks = resolution / i32(bounds_block_size);
+        NodeBounds bounds = {glm::vec2(std::numeric_limits<float>::max(), std::numeric_limits<float>::lowest()),
+                             min_lod_scale};
+        bool contained = false;
+        for (u32 level = 0; level != clipmap_levels; ++level)
+        {
+            // Texels the vertices of the node can sample, bilinear filtering reaches one texel further
+            const float texel_size = clipmap_texel_size * float(1u << level);
+            const glm::ivec2 first = floor_div(origin, texel_size) - 1;
+            const glm::ivec2 last = floor_div(origin + size, texel_size) + 1;
 
-        // Restore previous VAO
-        glBindVertexArray(prev_vao);
+            // Only the vertices inside the window of a level sample it
+            const glm::ivec2 window_first = glm::max(first, _level_origins[level]);
+            const glm::ivec2 window_last = glm::min(last, _level_origins[level] + resolution - 1);
+            if (glm::any(glm::greaterThan(window_first, window_last)))
+            {
+                continue;
+            }
+
+            // Texels outside of the read back window may not be generated yet
+            const glm::ivec2 readback_origin = _block_bounds_origins[level];
+            if (glm::any(glm::lessThan(window_first, readback_origin)) ||
+                glm::any(glm::greaterThan(window_last, readback_origin + resolution - 1)))
+            {
+                return full_range;
+            }
+
+            // Blocks partially outside of the window also hold stale heights, which only loosens the bounds
+            const glm::ivec2 first_block = floor_div(glm::vec2(window_first), float(bounds_block_size));
+            const glm::ivec2 last_block = floor_div(glm::vec2(window_last), float(bounds_block_size));
+            // The LOD scale is filtered between blocks, which reaches the neighboring ones
+            const float inv_slope_height = 1.0f / (float(bounds_block_size) * texel_size * lod_reference_slope);
+            for (i32 y = first_block.y - 1; y <= last_block.y + 1; ++y)
+            {
+                for (i32 x = first_block.x - 1; x <= last_block.x + 1; ++x)
+                {
+                    const glm::ivec2 block = ((glm::ivec2(x, y) % blocks) + blocks) % blocks;
+                    const glm::vec2 block_bounds = _block_bounds[(level * blocks + block.y) * blocks + block.x];
+                    const float lod_scale =
+                            std::clamp((block_bounds.y - block_bounds.x) * inv_slope_height, min_lod_scale, 1.0f);
+                    bounds.lod_scale = std::max(bounds.lod_scale, lod_scale);
+
+                    const bool margin = x < first_block.x || x > last_block.x || y < first_block.y || y > last_block.y;
+                    if (!margin)
+                    {
+                        bounds.heights = glm::vec2(std::min(bounds.heights.x, block_bounds.x),
+                                                   std::max(bounds.heights.y, block_bounds.y));
+                    }
+                }
+            }
+
+            // Vertices of a node inside the window sample this level or blend it with the next one
+            if (contained)
+            {
+                return bounds;
+            }
+            contained = window_first == first && window_last == last;
+        }
+
+        return contained ? bounds : full_range;
     }
 
-    void Terrain::generate_grid_mesh(u32 grid_size)
+    void Terrain::set_target_quad_pixels(float pixels)
     {
-        if (_vao)
-            glDeleteVertexArrays(1, &_vao);
-        if (_vbo)
-            glDeleteBuffers(1, &_vbo);
-        if (_ibo)
-            glDeleteBuffers(1, &_ibo);
+        DEBUG_ASSERT(pixels > 0.0f);
+        _target_quad_pixels = pixels;
+    }
+
+    void Terrain::set_viewport_height(u32 height)
+    {
+        _viewport_height = std::max(height, 1u);
+    }
+
+    void Terrain::update_lod_ranges(Selection& selection, const Camera& camera) const
+    {
+        // Ranges at which the quads of each LOD project to the target size: a quad of size s at distance d covers
+        // s * projection_scale / d pixels, and nodes are patch_grid_size quads wide
+        const float projection_scale = float(_viewport_height) / (2.0f * std::tan(camera.fov() * 0.5f));
+        const float distance_ratio =
+                std::max(projection_scale / (_target_quad_pixels * float(patch_grid_size)), min_lod_distance_ratio);
+
+        float prev_range = 0.0f;
+        for (u32 lod = 0; lod != lod_count; ++lod)
+        {
+            const float range = leaf_node_size * float(1u << lod) * distance_ratio;
+            selection.lod_ranges[lod] = range;
+            selection.morph_ranges[lod] = glm::vec4(glm::mix(range, prev_range, morph_region), range, 0.0f, 0.0f);
+            prev_range = range;
+        }
+
+        // Roots are selected wherever the clipmap has heights
+        selection.lod_ranges[lod_count - 1] = std::numeric_limits<float>::max();
+        selection.morph_ranges[lod_count - 1] =
+                glm::vec4(std::numeric_limits<float>::max() * 0.5f, std::numeric_limits<float>::max(), 0.0f, 0.0f);
+    }
+
+    bool Terrain::select_node(Selection& selection, u32 lod, glm::ivec2 coord) const
+    {
+        const float node_size = leaf_node_size * float(1u << lod);
+        const glm::vec2 origin = glm::vec2(coord) * node_size;
+
+        const NodeBounds bounds = node_bounds(origin, node_size);
+        const glm::vec3 aabb_min = glm::vec3(origin.x, bounds.heights.x, origin.y);
+        const glm::vec3 aabb_max = glm::vec3(origin.x + node_size, bounds.heights.y, origin.y + node_size);
 
-        std::vector<Vertex> vertices;
-        std::vector<u32> indices;
+        // Vertices divide their distance by their LOD scale: scaling the ranges by the largest scale of the node never
+        // selects a LOD coarser than one of its vertices expects
+        const float lod_scale = bounds.lod_scale;
 
-        float step = 1.0f / float(grid_size);
+        // Out of the range of this LOD: the parent covers the area
+        if (!intersects_sphere(aabb_min, aabb_max, selection.camera_pos, selection.lod_ranges[lod] * lod_scale))
+        {
+            return false;
+        }
+
+        if (is_culled(aabb_min, aabb_max, selection.planes))
+        {
+            return true;
+        }
 
-        for (u32 z = 0; z <= grid_size; ++z)
+        if (lod == 0 ||
+            !intersects_sphere(aabb_min, aabb_max, selection.camera_pos, selection.lod_ranges[lod - 1] * lod_scale))
         {
-            for (u32 x = 0; x <= grid_size; ++x)
+            selection.full_nodes.push_back({origin, node_size, lod});
+            return true;
+        }
+
+        for (u32 i = 0; i != 4; ++i)
+        {
+            const glm::ivec2 child = coord * 2 + glm::ivec2(i & 1, i >> 1);
+            if (!select_node(selection, lod - 1, child))
             {
-                Vertex v;
-                v.uv = glm::vec2(float(x) / grid_size, float(z) / grid_size);
-                v.position = glm::vec3((float(x) * step - 0.5f) * _size, 0.0f, (float(z) * step - 0.5f) * _size);
-                v.normal = glm::vec3(0.0f, 1.0f, 0.0f);
-                vertices.push_back(v);
+                const float child_size = node_size * 0.5f;
+                selection.quarter_nodes.push_back({origin + glm::vec2(i & 1, i >> 1) * child_size, child_size, lod});
             }
         }
+        return true;
+    }
+
+    void Terrain::bind_textures() const
+    {
+        _clipmap->bind(0);
+        _normal_clipmap->bind(1);
+        _splat_clipmap->bind(2);
+        _material_albedo->bind(3);
+        _material_normal->bind(4);
+        _bounds->bind(5);
+    }
+
+    void Terrain::set_common_uniforms(Program& program, const Camera& camera, const glm::mat4& view_proj) const
+    {
+        program.set_uniform(HASH("u_view_proj"), view_proj);
+        program.set_uniform(HASH("u_lod_camera_pos"), camera.position());
+        program.set_uniform(HASH("u_morph_ranges"), _selection.morph_ranges);
+        program.set_uniform(HASH("u_lod_scale_params"),
+                            glm::vec3(float(bounds_mip_count - 1),
+                                      1.0f / (float(bounds_block_size) * lod_reference_slope), min_lod_scale));
+        set_clipmap_uniforms(program);
+    }
+
+    void Terrain::set_clipmap_uniforms(Program& program) const
+    {
+        std::array<glm::vec4, MAX_CLIPMAP_LEVELS> levels = {};
+        for (u32 level = 0; level != clipmap_levels; ++level)
+        {
+            const float texel_size = clipmap_texel_size * float(1u << level);
+            levels[level] = glm::vec4(glm::vec2(_level_origins[level]) * texel_size, texel_size, 0.0f);
+        }
+        program.set_uniform(HASH("u_clipmap_levels"), levels);
+        program.set_uniform(HASH("u_clipmap_level_count"), clipmap_levels);
+        program.set_uniform(HASH("u_clipmap_resolution"), clipmap_resolution);
+        program.set_uniform(HASH("u_height_scale_bias"), height_scale_bias());
+    }
+
+    void Terrain::render(Program& program, const Camera& camera) const
+    {
+        render(program, camera, camera.view_proj_matrix());
+    }
+
+    void Terrain::render(Program& program, const Camera& camera, const glm::mat4& view_proj) const
+    {
+        if (!_clipmap_valid)
+        {
+            return;
+        }
+
+        // LODs are selected for the camera, culling is done for the rendered view
+        _selection.camera_pos = camera.position();
+        _selection.planes = Camera::frustum_planes(view_proj);
+        update_lod_ranges(_selection, camera);
+        _selection.full_nodes.clear();
+        _selection.quarter_nodes.clear();
 
-        for (u32 z = 0; z < grid_size; ++z)
+        // Roots fully inside the outermost clipmap level
+        const u32 last_level = clipmap_levels - 1;
+        const float last_texel_size = clipmap_texel_size * float(1u << last_level);
+        const glm::vec2 area_min = glm::vec2(_level_origins[last_level] + 1) * last_texel_size;
+        const glm::vec2 area_max = area_min + float(clipmap_resolution - 2) * last_texel_size;
+        const float root_size = leaf_node_size * float(1u << (lod_count - 1));
+        const glm::ivec2 first_root = glm::ivec2(glm::ceil(area_min / root_size));
+        const glm::ivec2 end_root = glm::ivec2(glm::floor(area_max / root_size));
+        for (i32 y = first_root.y; y < end_root.y; ++y)
         {
-            for (u32 x = 0; x < grid_size; ++x)
+            for (i32 x = first_root.x; x < end_root.x; ++x)
             {
-                u32 start = z * (grid_size + 1) + x;
-                indices.push_back(start);
-                indices.push_back(start + 1);
-                indices.push_back(start + (grid_size + 1) + 1);
-                indices.push_back(start + (grid_size + 1));
+                select_node(_selection, lod_count - 1, glm::ivec2(x, y));
             }
         }
 
-        _index_count = u32(indices.size());
+        const u32 full_count = u32(_selection.full_nodes.size());
+        const u32 quarter_count = u32(_selection.quarter_nodes.size());
+        _drawn_patches = full_count + quarter_count;
+        if (!_drawn_patches)
+        {
+            return;
+        }
+
+        if (!_node_buffer || _node_buffer->element_count() < _drawn_patches)
+        {
+            _node_buffer = std::make_unique<TypedBuffer<shader::TerrainNode>>(nullptr, _drawn_patches * 2);
+        }
+        {
+            // Also used by the previous render of the frame: don't wait for it
+            auto mapping = _node_buffer->map(AccessType::WriteDiscard);
+            std::copy(_selection.full_nodes.begin(), _selection.full_nodes.end(), mapping.data());
+            std::copy(_selection.quarter_nodes.begin(), _selection.quarter_nodes.end(), mapping.data() + full_count);
+        }
 
-        glCreateBuffers(1, &_vbo);
-        glNamedBufferData(_vbo, vertices.size() * sizeof(Vertex), vertices.data(), GL_STATIC_DRAW);
+        glEnable(GL_DEPTH_TEST);
+        glDepthFunc(GL_GEQUAL); // Reverse-Z
+        glDepthMask(GL_TRUE);
+        glEnable(GL_CULL_FACE);
+        glCullFace(GL_BACK);
+        glFrontFace(GL_CCW);
 
-        glCreateBuffers(1, &_ibo);
-        glNamedBufferData(_ibo, indices.size() * sizeof(u32), indices.data(), GL_STATIC_DRAW);
+        bind_textures();
 
-        glCreateVertexArrays(1, &_vao);
+        // Set terrain-specific uniforms
+        set_common_uniforms(program, camera, view_proj);
+        _virtual_texture->bind(program, _virtual_texture_enabled);
 
-        glVertexArrayVertexBuffer(_vao, 0, _vbo, 0, sizeof(Vertex));
-        glVertexArrayElementBuffer(_vao, _ibo);
+        _node_buffer->bind(BufferUsage::Storage, 14);
 
-        glEnableVertexArrayAttrib(_vao, 0);
-        glVertexArrayAttribFormat(_vao, 0, 3, GL_FLOAT, GL_FALSE, offsetof(Vertex, position));
-        glVertexArrayAttribBinding(_vao, 0, 0);
+        // Save previous VAO state
+        GLint prev_vao = 0;
+        glGetIntegerv(GL_VERTEX_ARRAY_BINDING, &prev_vao);
+        glBindVertexArray(_vao);
 
-        glEnableVertexArrayAttrib(_vao, 1);
-        glVertexArrayAttribFormat(_vao, 1, 3, GL_FLOAT, GL_FALSE, offsetof(Vertex, normal));
-        glVertexArrayAttribBinding(_vao, 1, 0);
+        // Two triangles per quad
+        if (full_count)
+        {
+            program.set_uniform(HASH("u_node_offset"), 0u);
+            program.set_uniform(HASH("u_grid_size"), patch_grid_size);
+            glDrawArraysInstanced(GL_TRIANGLES, 0, patch_grid_size * patch_grid_size * 6, full_count);
+        }
+        if (quarter_count)
+        {
+            const u32 quarter_grid_size = patch_grid_size / 2;
+            program.set_uniform(HASH("u_node_offset"), full_count);
+            program.set_uniform(HASH("u_grid_size"), quarter_grid_size);
+            glDrawArraysInstanced(GL_TRIANGLES, 0, quarter_grid_size * quarter_grid_size * 6, quarter_count);
+        }
 
-        glEnableVertexArrayAttrib(_vao, 2);
-        glVertexArrayAttribFormat(_vao, 2, 2, GL_FLOAT, GL_FALSE, offsetof(Vertex, uv));
-        glVertexArrayAttribBinding(_vao, 2, 0);
+        // Restore previous VAO
+        glBindVertexArray(prev_vao);
     }
 
 } // namespace OM3D
@@ -1,62 +1,255 @@
 #ifndef TERRAIN_H
 #define TERRAIN_H
 
+#include <ByteBuffer.h>
 #include <Camera.h>
+#include <HeightClipmap.h>
+#include <HeightTileLoader.h>
 #include <Program.h>
+#include <TerrainEdits.h>
+#include <TerrainGenerator.h>
+#include <TerrainVirtualTexture.h>
 #include <Texture.h>
 #include <TypedBuffer.h>
-#include <Vertex.h>
+#include <shader_structs.h>
 
 #include <glad/gl.h>
 #include <glm/glm.hpp>
+
+#include <array>
 #include <memory>
+#include <vector>
 
 namespace OM3D
 {
 
-    class Terrain
+    // Procedural terrain of unbounded size rendered with CDLOD (Continuous Distance-Dependent Level of Detail,
+    // Strugar 2010).
+    // Heights are stored in a clipmap: a stack of fixed size levels centered on the camera, each covering twice the
+    // area of the previous one at half the resolution. When the camera moves, only the strips of texels that enter a
+    // level are generated, and written over the ones that left it (toroidal addressing), so memory is constant.
+    // Patches sample the finest level covering them and blend towards the next one near its border.
+    // Heights are stored as 16 bit normalized values with a scale and a bias. Normals and slopes are computed with them
+    // into a second clipmap, so that shading fetches per pixel normals, and the weights of the material layers (splat
+    // map) into a third one: pixels only blend their two heaviest layers, whose textures are packed in arrays.
+    // A min/max pyramid of every level is built on the GPU and its coarsest mip is read back asynchronously to bound
+    // the nodes of the quadtree. The same heights are also generated on the CPU (see TerrainGenerator.h) into a copy of
+    // the clipmap for height and ray queries (see HeightClipmap.h).
+    // Sculpted edits (see TerrainEdits.h) are tracked in tiles: only the dirty tiles of a level are regenerated, on the
+    // CPU with their offsets, and uploaded before their normals, splat weights and min/max blocks are rebuilt.
+    // Heights can also come from a tiled heightfield file (see HeightTileFile.h) instead of the noise: the regions are
+    // then read from its tiles on a loader thread (see HeightTileLoader.h) and uploaded once they are all loaded, the
+    // windows lagging behind the camera in the meantime. The clipmap stays the GPU cache of the dataset.
+    // Shading reads the blended materials from a runtime virtual texture (see TerrainVirtualTexture.h), whose pages
+    // are baked from the clipmaps and invalidated where the terrain is edited.
+    // Geometry is a quadtree of square nodes around the camera. Every render, the tree is walked on the CPU: nodes are
+    // frustum culled and a LOD is selected by distance to the camera. Selected nodes are drawn as instanced grid
+    // patches of the same resolution, generated from gl_VertexID, and the vertices of a patch morph into the grid of
+    // the next LOD as they approach its range so that there are no cracks nor popping.
+    // LOD ranges are where the quads of a LOD project to a target number of pixels, so they follow the resolution and
+    // the field of view. They shrink where the terrain is flat (by the height range of the blocks of the min/max
+    // pyramid): distances are divided by a scale that varies continuously over the terrain, so morphing stays seamless.
+    class Terrain : NonMovable
     {
     public:
+        // Quads per side of a patch
+        static constexpr u32 patch_grid_size = 32;
+        // World size of the finest nodes
+        static constexpr float leaf_node_size = 32.0f;
+        // LODs of the quadtree, the roots are leaf_node_size * 2^(lod_count - 1) wide
+        static constexpr u32 lod_count = 8;
+
+        // Must be at most MAX_CLIPMAP_LEVELS
+        static constexpr u32 clipmap_levels = 6;
+        // Must be a power of two, shaders wrap texels with a mask
+        static constexpr u32 clipmap_resolution = 1024;
+        // World size of a texel of the finest level
+        static constexpr float clipmap_texel_size = 1.0f;
+        // Mips of the min/max pyramid, the last one is read back and covers blocks of clipmap texels
+        static constexpr u32 bounds_mip_count = 5;
+        static constexpr u32 bounds_block_size = 1u << bounds_mip_count;
+
         Terrain();
+        ~Terrain();
 
         // Called once at startup
-        void init(std::shared_ptr<Program> compute_program, std::shared_ptr<Texture> heightmap);
+        void init(std::shared_ptr<Program> compute_program);
+
+        // Scrolls the clipmap levels to the camera, generating the texels that entered them
+        void update(const glm::vec3& camera_pos);
+        // Regenerates every level (e.g. after changing the generation parameters)
+        void invalidate();
+
+        // Generation parameters, changing the frequency regenerates every level. The stored heights don't depend on
+        // the scale: changing it only rebuilds the normals and material weights, and the edited tiles
+        float noise_frequency() const { return _noise_frequency; }
+        void set_noise_frequency(float frequency);
+        void set_height_scale(float scale);
+
+        // Replaces the noise by a heightfield file (see HeightTileFile.h), whose heights are stored with its own
+        // range instead of the height scale. The noise settings are kept for when it is unloaded
+        bool load_heightfield(const std::string& file_name);
+        void unload_heightfield();
+        bool has_heightfield() const { return _heightfield != nullptr; }
 
-        // Regenerates heightmap (call once or when needed)
-        void update();
+        // Sculpting, see TerrainEdits::add_stamp(). Only the tiles under the stamp are regenerated
+        void add_stamp(const glm::vec2& center, float radius, float height);
+        void clear_edits();
 
         // Single render method - expects program to already be bound
         // Sets terrain-specific uniforms and draws
         void render(Program& program, const Camera& camera) const;
+        // Draws the terrain for another view (e.g. a shadow cascade), LODs still follow the camera
+        void render(Program& program, const Camera& camera, const glm::mat4& view_proj) const;
 
         // Getters for terrain resources (needed for external program setup)
-        const Texture& heightmap() const { return *_heightmap; }
-        float size() const { return _size; }
+        const Texture& clipmap() const { return *_clipmap; }
         float height_scale() const { return _height_scale; }
-        void set_tesselation_factor(float factor) { _tesselation_factor = factor; }
+
+        // Size the quads of the patches aim for on screen, in pixels of a viewport of the given height
+        float target_quad_pixels() const { return _target_quad_pixels; }
+        void set_target_quad_pixels(float pixels);
+        void set_viewport_height(u32 height);
+
+        bool virtual_texture_enabled() const { return _virtual_texture_enabled; }
+        void set_virtual_texture_enabled(bool enabled) { _virtual_texture_enabled = enabled; }
+        const TerrainVirtualTexture& virtual_texture() const { return *_virtual_texture; }
+
+        // Patches drawn by the last call to render()
+        u32 drawn_patches() const { return _drawn_patches; }
+
+        // Incremented every time the terrain changes (scrolling the clipmap doesn't change it)
+        u32 generation() const { return _generation; }
+
+        // Queries against the CPU copy of the clipmap, which only covers its area: heights are NaN outside of it
+        void heights(Span<const glm::vec2> positions, Span<float> heights) const;
+        void raycast(Span<const TerrainRay> rays, Span<TerrainHit> hits) const;
 
     private:
-        void generate_grid_mesh(u32 grid_size);
-        void set_common_uniforms(Program& program, const Camera& camera) const;
+        struct Selection
+        {
+            glm::vec3 camera_pos = {};
+            std::array<glm::vec4, 6> planes = {};
+
+            // Whole nodes, drawn with patch_grid_size quads per side
+            std::vector<shader::TerrainNode> full_nodes;
+            // Quarters of nodes whose other children have a finer LOD, drawn with half as many quads
+            std::vector<shader::TerrainNode> quarter_nodes;
+
+            // LOD 0 holds the leaves
+            std::array<float, MAX_TERRAIN_LODS> lod_ranges = {};
+            // (morph start, morph end) of each LOD
+            std::array<glm::vec4, MAX_TERRAIN_LODS> morph_ranges = {};
+        };
+
+        struct NodeBounds
+        {
+            glm::vec2 heights = {};
+            // Largest scale of the LOD ranges over the vertices of the node
+            float lod_scale = 1.0f;
+        };
+
+        struct Region
+        {
+            u32 level = 0;
+            // In texels of the level
+            glm::ivec2 origin = {};
+            glm::uvec2 size = {};
+        };
+
+        void generate_heights(const Region& region) const;
+        // Normals, slopes and material weights
+        void generate_surface(const Region& region) const;
+        // Texels that enter the windows when they move to origins, whole levels when the clipmap is invalid
+        std::vector<Region> window_regions(const std::array<glm::ivec2, clipmap_levels>& origins) const;
+        // Regions in a window of a level covering its dirty edited tiles
+        void add_edited_regions(u32 level, const glm::ivec2& window_origin, std::vector<Region>& regions);
+        // Publishes the regions of the last loaded batch of the heightfield and requests the next one
+        void stream_heightfield(const std::array<glm::ivec2, clipmap_levels>& origins);
+        // Writes the regions (see update_mirror()) and rebuilds what depends on them, the virtual texture is only
+        // invalidated from first_invalidated_region on. Heights are generated from the noise if loaded_values is empty
+        void write_regions(const std::vector<Region>& regions, size_t first_invalidated_region,
+                           size_t first_uploaded_region, std::vector<std::vector<u16>> loaded_values);
+        // Writes heights from the CPU, in rows of region.size.x values
+        void upload_heights(const Region& region, const u16* values) const;
+        void load_materials();
+        // Bakes the pages of the virtual texture requested by the previous frames
+        void update_virtual_texture(const glm::vec3& camera_pos);
+        // Min/max blocks covering the regions
+        void build_bounds(const std::vector<Region>& regions);
+        void read_back_bounds();
+        // Generates the regions on the CPU (or takes their loaded values) into the copy of the clipmap used by
+        // queries. Regions with edits, and all of them from first_uploaded_region on, are uploaded to the clipmap
+        void update_mirror(const std::vector<Region>& regions, size_t first_uploaded_region,
+                           std::vector<std::vector<u16>>& loaded_values);
+        // Compares a block of the heights the GPU generated for a region with the CPU ones, reports differences of
+        // more than a step (float rounding differs between the two)
+        void check_generated_heights(const Region& region, const u16* values) const;
+        // Range of the heights a node can sample and of the LOD scales of its vertices, the whole ranges when unknown
+        NodeBounds node_bounds(const glm::vec2& origin, float size) const;
+        // height = value * scale + bias, [-height_scale, height_scale] or the range of the heightfield
+        glm::vec2 height_scale_bias() const;
+        void update_lod_ranges(Selection& selection, const Camera& camera) const;
+        // Nodes are identified by their position in a grid of nodes of their size with a node at the world origin
+        bool select_node(Selection& selection, u32 lod, glm::ivec2 coord) const;
+        // Clipmaps and materials, units match the bindings of terrain.glsl
+        void bind_textures() const;
+        void set_clipmap_uniforms(Program& program) const;
+        void set_common_uniforms(Program& program, const Camera& camera, const glm::mat4& view_proj) const;
 
-        std::shared_ptr<Texture> _heightmap;
         std::shared_ptr<Program> _compute_program;
-        float _tesselation_factor = 4.0f;
+        std::shared_ptr<Program> _surface_program;
+        std::shared_ptr<Program> _bounds_program;
+        std::shared_ptr<Program> _bake_program;
+        u32 _generation = 0;
+
+        // One layer per level
+        std::unique_ptr<Texture> _clipmap;
+        std::unique_ptr<Texture> _normal_clipmap;
+        std::unique_ptr<Texture> _splat_clipmap;
+        // First texel of the window of each level, in texels of that level
+        std::array<glm::ivec2, clipmap_levels> _level_origins = {};
+        bool _clipmap_valid = false;
+        // Normals and weights of every level are outdated (the height scale changed)
+        bool _surface_dirty = false;
 
-        // Terrain material textures
-        std::shared_ptr<Texture> _grass_albedo;
-        std::shared_ptr<Texture> _forest_albedo;
-        std::shared_ptr<Texture> _rocks_albedo;
-        std::shared_ptr<Texture> _snow_albedo;
+        // Min/max heights of every level, one layer per level
+        std::unique_ptr<Texture> _bounds;
+        bool _bounds_dirty = false;
+        std::unique_ptr<ByteBuffer> _bounds_readback;
+        GLsync _bounds_fence = nullptr;
+        std::array<glm::ivec2, clipmap_levels> _readback_origins = {};
+        // Last read back mip (bounds_block_size texels of a level per element) and the windows it was built for
+        std::vector<glm::vec2> _block_bounds;
+        std::array<glm::ivec2, clipmap_levels> _block_bounds_origins = {};
 
-        // Raw OpenGL handles
+        // Created by update() for the current noise, null while a heightfield is loaded
+        std::unique_ptr<TerrainGenerator> _generator;
+        std::unique_ptr<HeightTileLoader> _heightfield;
+        // Regions of the batch being loaded and the windows they were computed for
+        std::vector<Region> _loading_regions;
+        std::array<glm::ivec2, clipmap_levels> _loading_origins = {};
+        HeightClipmap _height_mirror = HeightClipmap(clipmap_levels, clipmap_resolution, clipmap_texel_size);
+        TerrainEdits _edits = TerrainEdits(clipmap_levels, clipmap_texel_size);
+
+        // One layer per material (grass, forest, rocks, snow): albedo and roughness, normal (xy), AO and metalness
+        std::unique_ptr<Texture> _material_albedo;
+        std::unique_ptr<Texture> _material_normal;
+
+        std::unique_ptr<TerrainVirtualTexture> _virtual_texture;
+        bool _virtual_texture_enabled = true;
+
+        // Patches have no vertex attributes
         GLuint _vao = 0;
-        GLuint _vbo = 0;
-        GLuint _ibo = 0;
-        u32 _index_count = 0;
 
-        // Terrain settings
-        float _size = 8192.0f;
+        float _target_quad_pixels = 6.0f;
+        u32 _viewport_height = 1080;
+
+        mutable std::unique_ptr<TypedBuffer<shader::TerrainNode>> _node_buffer;
+        mutable Selection _selection;
+        mutable u32 _drawn_patches = 0;
+
+        // Noise settings, heights are in [-height_scale, height_scale]
         float _height_scale = 50.0f;
         float _noise_frequency = 0.02f;
     };
@@ -0,0 +1,173 @@
+#include "TerrainEdits.h"
+
+#include <algorithm>
+#include <cmath>
+
+namespace OM3D
+{
+
+    static glm::ivec2 floor_div(const glm::ivec2& value, i32 divisor)
+    {
+        return glm::ivec2(glm::floor(glm::vec2(value) / float(divisor)));
+    }
+
+    size_t TerrainEdits::TileHasher::operator()(const glm::ivec2& tile) const noexcept
+    {
+        size_t hash = size_t(u32(tile.x));
+        hash_combine(hash, size_t(u32(tile.y)));
+        return hash;
+    }
+
+    TerrainEdits::TerrainEdits(u32 level_count, float texel_size) : _levels(level_count)
+    {
+        for (u32 i = 0; i != level_count; ++i)
+        {
+            _levels[i].texel_size = texel_size * float(1u << i);
+        }
+    }
+
+    void TerrainEdits::add_stamp(const glm::vec2& center, float radius, float height)
+    {
+        DEBUG_ASSERT(radius > 0.0f);
+
+        const float inv_radius_sq = 1.0f / (radius * radius);
+        for (Level& level: _levels)
+        {
+            // Texels are sampled where they are, even when the stamp is smaller than them, so that levels agree
+            const glm::ivec2 first = glm::ivec2(glm::ceil((center - radius) / level.texel_size));
+            const glm::ivec2 last = glm::ivec2(glm::floor((center + radius) / level.texel_size));
+            if (first.x > last.x || first.y > last.y)
+            {
+                continue;
+            }
+
+            const glm::ivec2 first_tile = floor_div(first, i32(tile_size));
+            const glm::ivec2 last_tile = floor_div(last, i32(tile_size));
+            for (i32 tile_y = first_tile.y; tile_y <= last_tile.y; ++tile_y)
+            {
+                for (i32 tile_x = first_tile.x; tile_x <= last_tile.x; ++tile_x)
+                {
+                    const glm::ivec2 tile = glm::ivec2(tile_x, tile_y);
+                    std::vector<float>& offsets = level.tiles[tile];
+                    offsets.resize(size_t(tile_size) * tile_size, 0.0f);
+                    level.dirty.insert(tile);
+
+                    const glm::ivec2 tile_origin = tile * i32(tile_size);
+                    const glm::ivec2 tile_first = glm::max(first, tile_origin);
+                    const glm::ivec2 tile_last = glm::min(last, tile_origin + i32(tile_size) - 1);
+                    for (i32 y = tile_first.y; y <= tile_last.y; ++y)
+                    {
+                        for (i32 x = tile_first.x; x <= tile_last.x; ++x)
+                        {
+                            // Smooth falloff with a zero derivative at the center and at the radius
+                            const glm::vec2 delta = glm::vec2(x, y) * level.texel_size - center;
+                            const float t = std::max(1.0f - glm::dot(delta, delta) * inv_radius_sq, 0.0f);
+                            offsets[size_t(y - tile_origin.y) * tile_size + size_t(x - tile_origin.x)] +=
+                                    height * t * t;
+                        }
+                    }
+                }
+            }
+        }
+    }
+
+    void TerrainEdits::clear()
+    {
+        for (Level& level: _levels)
+        {
+            for (const auto& [tile, offsets]: level.tiles)
+            {
+                level.dirty.insert(tile);
+            }
+            level.tiles.clear();
+        }
+    }
+
+    void TerrainEdits::mark_dirty()
+    {
+        for (Level& level: _levels)
+        {
+            for (const auto& [tile, offsets]: level.tiles)
+            {
+                level.dirty.insert(tile);
+            }
+        }
+    }
+
+    bool TerrainEdits::empty() const
+    {
+        return std::all_of(_levels.begin(), _levels.end(), [](const Level& level) { return level.tiles.empty(); });
+    }
+
+    std::vector<glm::ivec2> TerrainEdits::take_dirty_tiles(u32 level)
+    {
+        std::vector<glm::ivec2> tiles(_levels[level].dirty.begin(), _levels[level].dirty.end());
+        _levels[level].dirty.clear();
+        return tiles;
+    }
+
+    bool TerrainEdits::is_edited(u32 level, const glm::ivec2& origin, const glm::uvec2& size) const
+    {
+        const Level& edits = _levels[level];
+        if (edits.tiles.empty())
+        {
+            return false;
+        }
+
+        const glm::ivec2 first_tile = floor_div(origin, i32(tile_size));
+        const glm::ivec2 last_tile = floor_div(origin + glm::ivec2(size) - 1, i32(tile_size));
+        for (i32 y = first_tile.y; y <= last_tile.y; ++y)
+        {
+            for (i32 x = first_tile.x; x <= last_tile.x; ++x)
+            {
+                if (edits.tiles.count(glm::ivec2(x, y)))
+                {
+                    return true;
+                }
+            }
+        }
+        return false;
+    }
+
+    void TerrainEdits::apply(u32 level, const glm::ivec2& origin, const glm::uvec2& size, const glm::vec2& scale_bias,
+                             u16* values) const
+    {
+        const Level& edits = _levels[level];
+        if (edits.tiles.empty())
+        {
+            return;
+        }
+
+        const float offset_to_value = 65535.0f / scale_bias.x;
+        const glm::ivec2 last = origin + glm::ivec2(size) - 1;
+        const glm::ivec2 first_tile = floor_div(origin, i32(tile_size));
+        const glm::ivec2 last_tile = floor_div(last, i32(tile_size));
+        for (i32 tile_y = first_tile.y; tile_y <= last_tile.y; ++tile_y)
+        {
+            for (i32 tile_x = first_tile.x; tile_x <= last_tile.x; ++tile_x)
+            {
+                const auto it = edits.tiles.find(glm::ivec2(tile_x, tile_y));
+                if (it == edits.tiles.end())
+                {
+                    continue;
+                }
+
+                const glm::ivec2 tile_origin = glm::ivec2(tile_x, tile_y) * i32(tile_size);
+                const glm::ivec2 first = glm::max(origin, tile_origin);
+                const glm::ivec2 tile_last = glm::min(last, tile_origin + i32(tile_size) - 1);
+                for (i32 y = first.y; y <= tile_last.y; ++y)
+                {
+                    const float* offsets = it->second.data() + size_t(y - tile_origin.y) * tile_size;
+                    u16* row = values + size_t(y - origin.y) * size.x;
+                    for (i32 x = first.x; x <= tile_last.x; ++x)
+                    {
+                        u16& value = row[x - origin.x];
+                        const float edited = float(value) + offsets[x - tile_origin.x] * offset_to_value;
+                        value = u16(std::clamp(edited, 0.0f, 65535.0f) + 0.5f);
+                    }
+                }
+            }
+        }
+    }
+
+} // namespace OM3D
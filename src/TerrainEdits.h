@@ -0,0 +1,63 @@
+#ifndef TERRAINEDITS_H
+#define TERRAINEDITS_H
+
+#include <utils.h>
+
+#include <glm/glm.hpp>
+
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+namespace OM3D
+{
+
+    // Sculpted height offsets added on top of the generated terrain.
+    // Offsets are stored sparsely in tiles of every clipmap level, at the resolution of that level: stamps are drawn
+    // into the tiles of all levels they overlap, and those tiles are reported as dirty so that only they are
+    // regenerated.
+    class TerrainEdits : NonCopyable
+    {
+    public:
+        // Texels per side of a tile, the same as the blocks of the min/max pyramid
+        static constexpr u32 tile_size = 32;
+
+        TerrainEdits(u32 level_count, float texel_size);
+
+        // Raises the terrain by height at center (lowers it if negative), fading out smoothly at radius
+        void add_stamp(const glm::vec2& center, float radius, float height);
+        // Removes every edit, the tiles that had some become dirty
+        void clear();
+        // Makes every edited tile dirty, e.g. when the offsets map to different normalized heights
+        void mark_dirty();
+
+        bool empty() const;
+
+        // Tiles changed since the last call, in tiles of the level
+        std::vector<glm::ivec2> take_dirty_tiles(u32 level);
+        // Whether a region (in texels of the level) overlaps edited tiles
+        bool is_edited(u32 level, const glm::ivec2& origin, const glm::uvec2& size) const;
+        // Adds the offsets to the normalized heights of a region (height = value * scale + bias), in rows of size.x
+        void apply(u32 level, const glm::ivec2& origin, const glm::uvec2& size, const glm::vec2& scale_bias,
+                   u16* values) const;
+
+    private:
+        struct TileHasher
+        {
+            size_t operator()(const glm::ivec2& tile) const noexcept;
+        };
+
+        struct Level
+        {
+            // Offsets in rows of tile_size
+            std::unordered_map<glm::ivec2, std::vector<float>, TileHasher> tiles;
+            std::unordered_set<glm::ivec2, TileHasher> dirty;
+            float texel_size = 0.0f;
+        };
+
+        std::vector<Level> _levels;
+    };
+
+} // namespace OM3D
+
+#endif // TERRAINEDITS_H
@@ -0,0 +1,496 @@
+#include "TerrainGenerator.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+
+#if defined(__SSE2__) || defined(_M_X64)
+#define OM3D_SSE2
+#include <emmintrin.h>
+#endif
+
+namespace OM3D
+{
+
+    // Must match fbm() in terrain_gen.comp
+    static constexpr u32 max_octaves = 6;
+    static constexpr float octave_shift = 100.0f;
+    static constexpr float octave_rotation = 0.5f;
+
+    // Changing the noise or how it is stored must change this, so that cached tiles aren't reused
+    static constexpr u32 noise_version = 2;
+    static constexpr u32 tile_magic = 0x54484d4f; // "OMHT"
+
+    static constexpr u32 pcg_multiplier = 1664525u;
+    static constexpr u32 pcg_increment = 1013904223u;
+
+    static glm::ivec2 floor_div(const glm::ivec2& value, i32 divisor)
+    {
+        return glm::ivec2(glm::floor(glm::vec2(value) / float(divisor)));
+    }
+
+    static u32 float_bits(float value)
+    {
+        u32 bits = 0;
+        std::memcpy(&bits, &value, sizeof(bits));
+        return bits;
+    }
+
+    // Written under another name first so that an interrupted write never leaves a truncated tile behind
+    static void write_tile_file(const std::string& path, const std::vector<u16>& values)
+    {
+        const std::string temp_path = path + ".tmp";
+        if (FILE* file = std::fopen(temp_path.c_str(), "wb"))
+        {
+            const u32 header[2] = {tile_magic, TerrainGenerator::tile_size};
+            const bool written = std::fwrite(header, sizeof(header), 1, file) == 1 &&
+                                 std::fwrite(values.data(), sizeof(u16), values.size(), file) == values.size();
+            std::fclose(file);
+
+            std::error_code error;
+            if (written)
+            {
+                std::filesystem::rename(temp_path, path, error);
+            }
+            else
+            {
+                std::filesystem::remove(temp_path, error);
+            }
+        }
+    }
+
+    // Removes the least recently used directories of the cache, current excepted, beyond max_cache_directories
+    static void evict_cache_directories(const std::filesystem::path& root, const std::filesystem::path& current)
+    {
+        std::vector<std::pair<std::filesystem::file_time_type, std::filesystem::path>> directories;
+        std::error_code error;
+        for (auto it = std::filesystem::directory_iterator(root, error);
+             !error && it != std::filesystem::directory_iterator(); it.increment(error))
+        {
+            if (it->is_directory(error) && it->path() != current)
+            {
+                directories.push_back({it->last_write_time(error), it->path()});
+            }
+        }
+
+        if (directories.size() < TerrainGenerator::max_cache_directories)
+        {
+            return;
+        }
+        std::sort(directories.begin(), directories.end(),
+                  [](const auto& a, const auto& b) { return a.first > b.first; });
+        for (size_t i = TerrainGenerator::max_cache_directories - 1; i != directories.size(); ++i)
+        {
+            std::filesystem::remove_all(directories[i].second, error);
+        }
+    }
+
+#if !defined(OM3D_SSE2) || defined(OM3D_DEBUG)
+    // Scalar version of the noise, debug builds check the SSE2 one against it
+
+    // pcg2d (Jarzynski & Olano 2020), only the first component is used
+    static float lattice_value(i32 x, i32 y)
+    {
+        u32 vx = u32(x) * pcg_multiplier + pcg_increment;
+        u32 vy = u32(y) * pcg_multiplier + pcg_increment;
+        vx += vy * pcg_multiplier;
+        vy += vx * pcg_multiplier;
+        vx ^= vx >> 16;
+        vy ^= vy >> 16;
+        vx += vy * pcg_multiplier;
+        vx ^= vx >> 16;
+        return float(vx >> 8) * (1.0f / 16777216.0f);
+    }
+
+    static float value_noise(float x, float y)
+    {
+        const float ix = std::floor(x);
+        const float iy = std::floor(y);
+        const float fx = x - ix;
+        const float fy = y - iy;
+        const i32 lx = i32(ix);
+        const i32 ly = i32(iy);
+
+        const float a = lattice_value(lx, ly);
+        const float b = lattice_value(lx + 1, ly);
+        const float c = lattice_value(lx, ly + 1);
+        const float d = lattice_value(lx + 1, ly + 1);
+        const float ux = fx * fx * (3.0f - 2.0f * fx);
+        const float uy = fy * fy * (3.0f - 2.0f * fy);
+        return glm::mix(a, b, ux) + (c - a) * uy * (1.0f - ux) + (d - b) * ux * uy;
+    }
+
+    // Stored value of a texel, position is its world position times the noise frequency
+    static u16 noise_value(glm::vec2 position, u32 octaves)
+    {
+        const float c = std::cos(octave_rotation);
+        const float s = std::sin(octave_rotation);
+
+        float v = 0.0f;
+        float amplitude = 0.5f;
+        for (u32 i = 0; i != octaves; ++i)
+        {
+            v += amplitude * value_noise(position.x, position.y);
+            const float rx = c * position.x - s * position.y;
+            const float ry = s * position.x + c * position.y;
+            position = glm::vec2(rx, ry) * 2.0f + octave_shift;
+            amplitude *= 0.5f;
+        }
+
+        // Same conversion as the r16 image store
+        const float value = v * 0.5f + 0.5f;
+        return u16(std::clamp(value, 0.0f, 1.0f) * 65535.0f + 0.5f);
+    }
+#endif
+
+#ifdef OM3D_SSE2
+    // SSE2 has no 32 bit multiplication nor rounding instructions
+    static __m128i mullo_epi32(__m128i a, __m128i b)
+    {
+        const __m128i even = _mm_mul_epu32(a, b);
+        const __m128i odd = _mm_mul_epu32(_mm_srli_epi64(a, 32), _mm_srli_epi64(b, 32));
+        return _mm_unpacklo_epi32(_mm_shuffle_epi32(even, _MM_SHUFFLE(0, 0, 2, 0)),
+                                  _mm_shuffle_epi32(odd, _MM_SHUFFLE(0, 0, 2, 0)));
+    }
+
+    static __m128 floor_ps(__m128 x)
+    {
+        const __m128 truncated = _mm_cvtepi32_ps(_mm_cvttps_epi32(x));
+        return _mm_sub_ps(truncated, _mm_and_ps(_mm_cmpgt_ps(truncated, x), _mm_set1_ps(1.0f)));
+    }
+
+    static __m128 lattice_value4(__m128i x, __m128i y)
+    {
+        const __m128i multiplier = _mm_set1_epi32(i32(pcg_multiplier));
+        const __m128i increment = _mm_set1_epi32(i32(pcg_increment));
+
+        __m128i vx = _mm_add_epi32(mullo_epi32(x, multiplier), increment);
+        __m128i vy = _mm_add_epi32(mullo_epi32(y, multiplier), increment);
+        vx = _mm_add_epi32(vx, mullo_epi32(vy, multiplier));
+        vy = _mm_add_epi32(vy, mullo_epi32(vx, multiplier));
+        vx = _mm_xor_si128(vx, _mm_srli_epi32(vx, 16));
+        vy = _mm_xor_si128(vy, _mm_srli_epi32(vy, 16));
+        vx = _mm_add_epi32(vx, mullo_epi32(vy, multiplier));
+        vx = _mm_xor_si128(vx, _mm_srli_epi32(vx, 16));
+        return _mm_mul_ps(_mm_cvtepi32_ps(_mm_srli_epi32(vx, 8)), _mm_set1_ps(1.0f / 16777216.0f));
+    }
+
+    static __m128 value_noise4(__m128 x, __m128 y)
+    {
+        const __m128 ix = floor_ps(x);
+        const __m128 iy = floor_ps(y);
+        const __m128 fx = _mm_sub_ps(x, ix);
+        const __m128 fy = _mm_sub_ps(y, iy);
+        const __m128i lx = _mm_cvttps_epi32(ix);
+        const __m128i ly = _mm_cvttps_epi32(iy);
+        const __m128i one = _mm_set1_epi32(1);
+
+        const __m128 a = lattice_value4(lx, ly);
+        const __m128 b = lattice_value4(_mm_add_epi32(lx, one), ly);
+        const __m128 c = lattice_value4(lx, _mm_add_epi32(ly, one));
+        const __m128 d = lattice_value4(_mm_add_epi32(lx, one), _mm_add_epi32(ly, one));
+
+        const __m128 three = _mm_set1_ps(3.0f);
+        const __m128 ux = _mm_mul_ps(_mm_mul_ps(fx, fx), _mm_sub_ps(three, _mm_add_ps(fx, fx)));
+        const __m128 uy = _mm_mul_ps(_mm_mul_ps(fy, fy), _mm_sub_ps(three, _mm_add_ps(fy, fy)));
+
+        const __m128 ab = _mm_add_ps(a, _mm_mul_ps(_mm_sub_ps(b, a), ux));
+        const __m128 ca = _mm_mul_ps(_mm_mul_ps(_mm_sub_ps(c, a), uy), _mm_sub_ps(_mm_set1_ps(1.0f), ux));
+        const __m128 db = _mm_mul_ps(_mm_mul_ps(_mm_sub_ps(d, b), ux), uy);
+        return _mm_add_ps(_mm_add_ps(ab, ca), db);
+    }
+#endif
+
+    size_t TerrainGenerator::TileKeyHasher::operator()(const TileKey& key) const noexcept
+    {
+        size_t hash = key.level;
+        hash_combine(hash, size_t(u32(key.coord.x)));
+        hash_combine(hash, size_t(u32(key.coord.y)));
+        return hash;
+    }
+
+    TerrainGenerator::TerrainGenerator(const Settings& settings, const std::string& cache_directory) :
+        _settings(settings)
+    {
+        // Exact bits of the settings, the noise version and the tile size name the directory
+        char name[64] = {};
+        std::snprintf(name, sizeof(name), "%08x_%08x_%u_%u", float_bits(settings.noise_frequency),
+                      float_bits(settings.texel_size), noise_version, tile_size);
+
+        const std::filesystem::path directory = std::filesystem::path(cache_directory) / name;
+        std::error_code error;
+        std::filesystem::create_directories(directory, error);
+        if (!error)
+        {
+            _cache_directory = directory.string();
+            // Tiles being written update the time too, it orders the directories to evict
+            std::filesystem::last_write_time(directory, std::filesystem::file_time_type::clock::now(), error);
+
+            _writer = std::thread([this, root = std::filesystem::path(cache_directory), directory]
+            {
+                evict_cache_directories(root, directory);
+                write_tiles();
+            });
+        }
+    }
+
+    TerrainGenerator::~TerrainGenerator()
+    {
+        if (_writer.joinable())
+        {
+            {
+                // Only the tile being written is finished, the others are generated again when needed
+                std::lock_guard<std::mutex> lock(_writer_mutex);
+                _stop_writer = true;
+            }
+            _writer_condition.notify_one();
+            _writer.join();
+        }
+    }
+
+    void TerrainGenerator::generate(u32 level, const glm::ivec2& origin, const glm::uvec2& size, u16* values)
+    {
+        if (size.x == 0 || size.y == 0)
+        {
+            return;
+        }
+
+        ++_use_count;
+
+        const glm::ivec2 first_tile = floor_div(origin, i32(tile_size));
+        const glm::ivec2 last_tile = floor_div(origin + glm::ivec2(size) - 1, i32(tile_size));
+
+        std::vector<TileKey> missing;
+        for (i32 y = first_tile.y; y <= last_tile.y; ++y)
+        {
+            for (i32 x = first_tile.x; x <= last_tile.x; ++x)
+            {
+                const TileKey key = {level, glm::ivec2(x, y)};
+                const auto it = _tiles.find(key);
+                if (it != _tiles.end())
+                {
+                    it->second.last_used = _use_count;
+                }
+                else
+                {
+                    missing.push_back(key);
+                }
+            }
+        }
+
+        // Tiles that aren't on disk either are generated row by row, so that a few tiles still use every thread
+        std::vector<std::vector<u16>> missing_values(missing.size());
+        std::vector<u32> generated;
+        for (u32 i = 0; i != missing.size(); ++i)
+        {
+            if (!load_tile(missing[i], missing_values[i]))
+            {
+                missing_values[i].resize(size_t(tile_size) * tile_size);
+                generated.push_back(i);
+            }
+        }
+        parallel_for(generated.size() * tile_size, 16, [&](size_t begin, size_t end)
+        {
+            for (size_t i = begin; i != end; ++i)
+            {
+                const u32 tile = generated[i / tile_size];
+                const u32 row = u32(i % tile_size);
+                generate_row(missing[tile], row, missing_values[tile].data() + size_t(row) * tile_size);
+            }
+        });
+        for (const u32 tile: generated)
+        {
+            save_tile(missing[tile], missing_values[tile]);
+        }
+        for (u32 i = 0; i != missing.size(); ++i)
+        {
+            _tiles[missing[i]] = {std::move(missing_values[i]), _use_count};
+        }
+
+        for (i32 y = first_tile.y; y <= last_tile.y; ++y)
+        {
+            for (i32 x = first_tile.x; x <= last_tile.x; ++x)
+            {
+                const Tile& tile = _tiles[{level, glm::ivec2(x, y)}];
+                const glm::ivec2 tile_origin = glm::ivec2(x, y) * i32(tile_size);
+
+                // Overlap of the tile and the region, in texels of the level
+                const glm::ivec2 first = glm::max(origin, tile_origin);
+                const glm::ivec2 last = glm::min(origin + glm::ivec2(size), tile_origin + i32(tile_size)) - 1;
+                const size_t width = size_t(last.x - first.x + 1);
+                for (i32 texel_y = first.y; texel_y <= last.y; ++texel_y)
+                {
+                    const u16* src = tile.values.data() + size_t(texel_y - tile_origin.y) * tile_size +
+                                     size_t(first.x - tile_origin.x);
+                    u16* dst = values + size_t(texel_y - origin.y) * size.x + size_t(first.x - origin.x);
+                    std::memcpy(dst, src, width * sizeof(u16));
+                }
+            }
+        }
+
+        evict_tiles();
+    }
+
+    void TerrainGenerator::generate_row(const TileKey& key, u32 row, u16* values) const
+    {
+        const float texel_size = _settings.texel_size * float(1u << key.level);
+
+        // Octaves finer than half a texel are left out (except for the first one), the same for the whole level
+        u32 octaves = 1;
+        for (float texel_freq = _settings.noise_frequency * texel_size * 2.0f;
+             octaves != max_octaves && texel_freq <= 0.5f; texel_freq *= 2.0f)
+        {
+            ++octaves;
+        }
+
+        const glm::ivec2 texel = key.coord * i32(tile_size) + glm::ivec2(0, i32(row));
+
+#ifdef OM3D_SSE2
+        const __m128 cos_rotation = _mm_set1_ps(std::cos(octave_rotation));
+        const __m128 sin_rotation = _mm_set1_ps(std::sin(octave_rotation));
+        const __m128 two = _mm_set1_ps(2.0f);
+        const __m128 shift = _mm_set1_ps(octave_shift);
+        const __m128 frequency = _mm_set1_ps(_settings.noise_frequency);
+        const __m128 world_y = _mm_set1_ps(float(texel.y) * texel_size);
+
+        for (u32 x = 0; x != tile_size; x += 4)
+        {
+            const __m128 texel_x = _mm_cvtepi32_ps(_mm_add_epi32(_mm_set1_epi32(texel.x + i32(x)),
+                                                                 _mm_setr_epi32(0, 1, 2, 3)));
+            __m128 px = _mm_mul_ps(_mm_mul_ps(texel_x, _mm_set1_ps(texel_size)), frequency);
+            __m128 py = _mm_mul_ps(world_y, frequency);
+
+            __m128 v = _mm_setzero_ps();
+            float amplitude = 0.5f;
+            for (u32 i = 0; i != octaves; ++i)
+            {
+                v = _mm_add_ps(v, _mm_mul_ps(_mm_set1_ps(amplitude), value_noise4(px, py)));
+                const __m128 rx = _mm_sub_ps(_mm_mul_ps(cos_rotation, px), _mm_mul_ps(sin_rotation, py));
+                const __m128 ry = _mm_add_ps(_mm_mul_ps(sin_rotation, px), _mm_mul_ps(cos_rotation, py));
+                px = _mm_add_ps(_mm_mul_ps(rx, two), shift);
+                py = _mm_add_ps(_mm_mul_ps(ry, two), shift);
+                amplitude *= 0.5f;
+            }
+
+            // Same conversion as the r16 image store
+            const __m128 half = _mm_set1_ps(0.5f);
+            __m128 value = _mm_add_ps(_mm_mul_ps(v, half), half);
+            value = _mm_min_ps(_mm_max_ps(value, _mm_setzero_ps()), _mm_set1_ps(1.0f));
+            alignas(16) i32 rounded[4] = {};
+            _mm_store_si128(reinterpret_cast<__m128i*>(rounded),
+                            _mm_cvttps_epi32(_mm_add_ps(_mm_mul_ps(value, _mm_set1_ps(65535.0f)), _mm_set1_ps(0.5f))));
+            for (u32 lane = 0; lane != 4; ++lane)
+            {
+                values[x + lane] = u16(rounded[lane]);
+#ifdef OM3D_DEBUG
+                // Only float rounding differs, by at most one step of the stored values
+                const glm::vec2 position = glm::vec2(float(texel.x + i32(x + lane)) * texel_size,
+                                                     float(texel.y) * texel_size) * _settings.noise_frequency;
+                DEBUG_ASSERT(std::abs(i32(values[x + lane]) - i32(noise_value(position, octaves))) <= 1);
+#endif
+            }
+        }
+#else
+        for (u32 x = 0; x != tile_size; ++x)
+        {
+            const glm::vec2 position = glm::vec2(float(texel.x + i32(x)) * texel_size, float(texel.y) * texel_size) *
+                                       _settings.noise_frequency;
+            values[x] = noise_value(position, octaves);
+        }
+#endif
+    }
+
+    std::string TerrainGenerator::tile_path(const TileKey& key) const
+    {
+        char name[64] = {};
+        std::snprintf(name, sizeof(name), "%u_%d_%d.r16", key.level, key.coord.x, key.coord.y);
+        return (std::filesystem::path(_cache_directory) / name).string();
+    }
+
+    bool TerrainGenerator::load_tile(const TileKey& key, std::vector<u16>& values) const
+    {
+        if (_cache_directory.empty())
+        {
+            return false;
+        }
+
+        if (FILE* file = std::fopen(tile_path(key).c_str(), "rb"))
+        {
+            DEFER(std::fclose(file));
+
+            u32 header[2] = {};
+            if (std::fread(header, sizeof(header), 1, file) != 1 || header[0] != tile_magic ||
+                header[1] != tile_size)
+            {
+                return false;
+            }
+
+            values.resize(size_t(tile_size) * tile_size);
+            return std::fread(values.data(), sizeof(u16), values.size(), file) == values.size();
+        }
+        return false;
+    }
+
+    void TerrainGenerator::save_tile(const TileKey& key, const std::vector<u16>& values)
+    {
+        if (_cache_directory.empty())
+        {
+            return;
+        }
+
+        {
+            std::lock_guard<std::mutex> lock(_writer_mutex);
+            _pending_writes.push_back({tile_path(key), values});
+        }
+        _writer_condition.notify_one();
+    }
+
+    void TerrainGenerator::write_tiles()
+    {
+        std::unique_lock<std::mutex> lock(_writer_mutex);
+        while (true)
+        {
+            _writer_condition.wait(lock, [this] { return _stop_writer || !_pending_writes.empty(); });
+            if (_stop_writer)
+            {
+                return;
+            }
+
+            const PendingWrite write = std::move(_pending_writes.front());
+            _pending_writes.pop_front();
+            lock.unlock();
+            write_tile_file(write.path, write.values);
+            lock.lock();
+        }
+    }
+
+    void TerrainGenerator::evict_tiles()
+    {
+        if (_tiles.size() <= max_cached_tiles)
+        {
+            return;
+        }
+
+        std::vector<std::pair<u64, TileKey>> tiles;
+        tiles.reserve(_tiles.size());
+        for (const auto& [key, tile]: _tiles)
+        {
+            // Tiles of the last region are kept even if it needed more than max_cached_tiles
+            if (tile.last_used != _use_count)
+            {
+                tiles.push_back({tile.last_used, key});
+            }
+        }
+
+        const size_t count = std::min(_tiles.size() - max_cached_tiles, tiles.size());
+        std::nth_element(tiles.begin(), tiles.begin() + count, tiles.end(),
+                         [](const auto& a, const auto& b) { return a.first < b.first; });
+        for (size_t i = 0; i != count; ++i)
+        {
+            _tiles.erase(tiles[i].second);
+        }
+    }
+
+} // namespace OM3D
@@ -0,0 +1,103 @@
+#ifndef TERRAINGENERATOR_H
+#define TERRAINGENERATOR_H
+
+#include <utils.h>
+
+#include <glm/glm.hpp>
+
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+namespace OM3D
+{
+
+    // CPU version of the heights generated by terrain_gen.comp (within float rounding), so that the terrain can be
+    // queried without reading the GPU back.
+    // Regions are assembled from world aligned tiles of every clipmap level, generated four texels at a time with SSE2
+    // across all hardware threads. Tiles are cached in memory and on disk, in a directory per set of settings, so that
+    // they are only generated once. A background thread writes them, and removes the least recently used directories
+    // beyond max_cache_directories.
+    class TerrainGenerator : NonCopyable
+    {
+    public:
+        struct Settings
+        {
+            float noise_frequency = 0.02f;
+            // World size of a texel of level 0, texels of level i are 2^i times larger
+            float texel_size = 1.0f;
+        };
+
+        // Texels per side of a tile
+        static constexpr u32 tile_size = 256;
+        // Tiles kept in memory, the least recently used ones are evicted first
+        static constexpr u32 max_cached_tiles = 256;
+        // Directories of settings kept on disk
+        static constexpr u32 max_cache_directories = 4;
+
+        TerrainGenerator(const Settings& settings, const std::string& cache_directory = "terrain_cache/");
+        ~TerrainGenerator();
+
+        const Settings& settings() const { return _settings; }
+
+        // Normalized heights (as stored in the clipmap) of a region of a level, in rows of size.x values. They don't
+        // depend on the height scale of the terrain, which only maps them to [-height_scale, height_scale]
+        void generate(u32 level, const glm::ivec2& origin, const glm::uvec2& size, u16* values);
+
+    private:
+        struct TileKey
+        {
+            u32 level = 0;
+            // In tiles
+            glm::ivec2 coord = {};
+
+            bool operator==(const TileKey& other) const { return level == other.level && coord == other.coord; }
+        };
+
+        struct TileKeyHasher
+        {
+            size_t operator()(const TileKey& key) const noexcept;
+        };
+
+        struct Tile
+        {
+            std::vector<u16> values;
+            u64 last_used = 0;
+        };
+
+        struct PendingWrite
+        {
+            std::string path;
+            std::vector<u16> values;
+        };
+
+        void generate_row(const TileKey& key, u32 row, u16* values) const;
+        std::string tile_path(const TileKey& key) const;
+        bool load_tile(const TileKey& key, std::vector<u16>& values) const;
+        // Queues the tile for the writer thread
+        void save_tile(const TileKey& key, const std::vector<u16>& values);
+        // Body of the writer thread, returns when the generator is destroyed
+        void write_tiles();
+        void evict_tiles();
+
+        Settings _settings;
+        // Empty if the directory couldn't be created, tiles are then only cached in memory
+        std::string _cache_directory;
+
+        std::unordered_map<TileKey, Tile, TileKeyHasher> _tiles;
+        u64 _use_count = 0;
+
+        std::thread _writer;
+        std::mutex _writer_mutex;
+        std::condition_variable _writer_condition;
+        std::deque<PendingWrite> _pending_writes;
+        bool _stop_writer = false;
+    };
+
+} // namespace OM3D
+
+#endif // TERRAINGENERATOR_H
@@ -0,0 +1,280 @@
+#include "TerrainVirtualTexture.h"
+
+#include <algorithm>
+#include <cmath>
+
+namespace OM3D
+{
+
+    static constexpr u32 window_pages = RVT_WINDOW_PAGES;
+    // Layout of the feedback buffer, must match TerrainFeedback in terrain_rvt.glsl
+    static constexpr size_t requested_bits_words = RVT_MIP_COUNT * window_pages * window_pages / 32;
+    static constexpr size_t requests_offset = (sizeof(u32) * (1 + requested_bits_words) + 15) / 16 * 16;
+    static constexpr size_t feedback_size = requests_offset + sizeof(glm::ivec4) * RVT_MAX_REQUESTS;
+
+    static glm::ivec2 floor_mod(const glm::ivec2& value, i32 divisor)
+    {
+        return ((value % divisor) + divisor) % divisor;
+    }
+
+    size_t TerrainVirtualTexture::PageKeyHasher::operator()(const PageKey& key) const noexcept
+    {
+        size_t hash = size_t(key.mip);
+        hash_combine(hash, size_t(u32(key.coord.x)));
+        hash_combine(hash, size_t(u32(key.coord.y)));
+        return hash;
+    }
+
+    TerrainVirtualTexture::TerrainVirtualTexture()
+    {
+        // Borders keep filtering inside of the pages
+        _albedo = std::make_unique<Texture>(glm::uvec2(physical_page_size), physical_pages, ImageFormat::RGBA8_UNORM,
+                                            WrapMode::Clamp);
+        glTextureParameteri(_albedo->id(), GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+        glTextureParameteri(_albedo->id(), GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+        _normal = std::make_unique<Texture>(glm::uvec2(physical_page_size), physical_pages, ImageFormat::RGBA8_UNORM,
+                                            WrapMode::Clamp);
+        glTextureParameteri(_normal->id(), GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+        glTextureParameteri(_normal->id(), GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+
+        // Integer textures are only complete without filtering
+        _indirection = std::make_unique<Texture>(glm::uvec2(window_pages), RVT_MIP_COUNT, ImageFormat::R32_UINT,
+                                                 WrapMode::Repeat);
+        glTextureParameteri(_indirection->id(), GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+        glTextureParameteri(_indirection->id(), GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+        _indirection->clear();
+
+        _feedback = std::make_unique<ByteBuffer>(nullptr, feedback_size);
+        _feedback->clear();
+        _feedback_readback = std::make_unique<ByteBuffer>(nullptr, feedback_size);
+
+        for (u32 layer = physical_pages; layer != 0; --layer)
+        {
+            _free_layers.push_back(layer - 1);
+        }
+    }
+
+    TerrainVirtualTexture::~TerrainVirtualTexture()
+    {
+        if (_feedback_fence)
+            glDeleteSync(_feedback_fence);
+    }
+
+    std::vector<TerrainVirtualTexture::Page> TerrainVirtualTexture::update(const glm::vec3& camera_pos,
+                                                                           const glm::vec2& coverage_min,
+                                                                           const glm::vec2& coverage_max)
+    {
+        ++_frame;
+        read_back_requests();
+
+        for (u32 mip = 0; mip != RVT_MIP_COUNT; ++mip)
+        {
+            const glm::vec2 camera_page = glm::vec2(camera_pos.x, camera_pos.z) / page_size(mip);
+            const glm::ivec2 window = glm::ivec2(glm::floor(camera_page)) - i32(window_pages / 2);
+            if (window != _windows[mip])
+            {
+                _windows[mip] = window;
+                _indirection_dirty[mip] = true;
+            }
+        }
+
+        // Parts of the partial pages that were outside of the coverage hold garbage, which could now be visible
+        if (coverage_min != _coverage_min || coverage_max != _coverage_max)
+        {
+            _coverage_min = coverage_min;
+            _coverage_max = coverage_max;
+            for (auto it = _pages.begin(); it != _pages.end();)
+            {
+                it = it->second.partial ? drop_page(it) : std::next(it);
+            }
+        }
+
+        // Coarsest pages first, they cover the most pixels
+        std::vector<Page> bakes;
+        while (!_pending.empty() && bakes.size() != RVT_MAX_BAKES)
+        {
+            const PageKey key = _pending.back();
+            _pending.pop_back();
+
+            const glm::ivec2 window = _windows[key.mip];
+            const bool in_window = glm::all(glm::greaterThanEqual(key.coord, window)) &&
+                                   glm::all(glm::lessThan(key.coord, window + i32(window_pages)));
+            if (!in_window || _pages.count(key))
+            {
+                continue;
+            }
+
+            u32 layer = 0;
+            if (!allocate_layer(layer))
+            {
+                // Every page is in use
+                _pending.clear();
+                break;
+            }
+
+            const glm::vec2 page_min = glm::vec2(key.coord) * page_size(key.mip);
+            const glm::vec2 page_max = page_min + page_size(key.mip);
+            const bool partial = glm::any(glm::lessThan(page_min, coverage_min)) ||
+                                 glm::any(glm::greaterThan(page_max, coverage_max));
+            _pages[key] = {layer, _readback_count, partial};
+            _indirection_dirty[key.mip] = true;
+            bakes.push_back({key.mip, key.coord, layer});
+        }
+
+        for (u32 mip = 0; mip != RVT_MIP_COUNT; ++mip)
+        {
+            if (_indirection_dirty[mip])
+            {
+                upload_indirection(mip);
+            }
+        }
+
+        return bakes;
+    }
+
+    void TerrainVirtualTexture::read_back_requests()
+    {
+        if (_feedback_fence)
+        {
+            // Never wait for the GPU, pages are requested again every frame
+            if (glClientWaitSync(_feedback_fence, 0, 0) == GL_TIMEOUT_EXPIRED)
+            {
+                return;
+            }
+            glDeleteSync(_feedback_fence);
+            _feedback_fence = nullptr;
+
+            ++_readback_count;
+            _pending.clear();
+
+            auto mapping = _feedback_readback->map_bytes(AccessType::ReadOnly);
+            const u32 count = std::min(*reinterpret_cast<const u32*>(mapping.data()), u32(RVT_MAX_REQUESTS));
+            const glm::ivec4* requests = reinterpret_cast<const glm::ivec4*>(mapping.data() + requests_offset);
+            for (u32 i = 0; i != count; ++i)
+            {
+                const PageKey key = {u32(requests[i].x), glm::ivec2(requests[i].y, requests[i].z)};
+                if (key.mip >= RVT_MIP_COUNT)
+                {
+                    continue;
+                }
+
+                if (const auto it = _pages.find(key); it != _pages.end())
+                {
+                    it->second.last_request = _readback_count;
+                }
+                else
+                {
+                    _pending.push_back(key);
+                }
+            }
+            std::sort(_pending.begin(), _pending.end(),
+                      [](const PageKey& a, const PageKey& b) { return a.mip < b.mip; });
+        }
+
+        // Requests accumulate until the previous readback is done
+        glMemoryBarrier(GL_BUFFER_UPDATE_BARRIER_BIT);
+        _feedback_readback->copy_from(*_feedback, 0);
+        _feedback->clear();
+        _feedback_fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+    }
+
+    TerrainVirtualTexture::PageMap::iterator TerrainVirtualTexture::drop_page(PageMap::iterator it)
+    {
+        _free_layers.push_back(it->second.layer);
+        _indirection_dirty[it->first.mip] = true;
+        return _pages.erase(it);
+    }
+
+    bool TerrainVirtualTexture::allocate_layer(u32& layer)
+    {
+        if (!_free_layers.empty())
+        {
+            layer = _free_layers.back();
+            _free_layers.pop_back();
+            return true;
+        }
+
+        // Pages requested by the last readback are still visible
+        auto oldest = _pages.end();
+        for (auto it = _pages.begin(); it != _pages.end(); ++it)
+        {
+            if (it->second.last_request < _readback_count &&
+                (oldest == _pages.end() || it->second.last_request < oldest->second.last_request))
+            {
+                oldest = it;
+            }
+        }
+        if (oldest == _pages.end())
+        {
+            return false;
+        }
+
+        drop_page(oldest);
+        layer = _free_layers.back();
+        _free_layers.pop_back();
+        return true;
+    }
+
+    void TerrainVirtualTexture::invalidate(const glm::vec2& world_min, const glm::vec2& world_max)
+    {
+        for (auto it = _pages.begin(); it != _pages.end();)
+        {
+            const glm::vec2 page_min = glm::vec2(it->first.coord) * page_size(it->first.mip);
+            const glm::vec2 page_max = page_min + page_size(it->first.mip);
+            const bool overlaps = glm::all(glm::lessThan(page_min, world_max)) &&
+                                  glm::all(glm::greaterThan(page_max, world_min));
+            it = overlaps ? drop_page(it) : std::next(it);
+        }
+    }
+
+    void TerrainVirtualTexture::invalidate()
+    {
+        for (auto it = _pages.begin(); it != _pages.end();)
+        {
+            it = drop_page(it);
+        }
+        _pending.clear();
+    }
+
+    void TerrainVirtualTexture::upload_indirection(u32 mip)
+    {
+        std::array<u32, window_pages * window_pages> entries = {};
+        const glm::ivec2 window = _windows[mip];
+        for (const auto& [key, page]: _pages)
+        {
+            const bool in_window = glm::all(glm::greaterThanEqual(key.coord, window)) &&
+                                   glm::all(glm::lessThan(key.coord, window + i32(window_pages)));
+            if (key.mip == mip && in_window)
+            {
+                const glm::ivec2 storage = floor_mod(key.coord, i32(window_pages));
+                entries[storage.y * window_pages + storage.x] = page.layer + 1;
+            }
+        }
+
+        glTextureSubImage3D(_indirection->id(), 0, 0, 0, GLint(mip), window_pages, window_pages, 1, GL_RED_INTEGER,
+                            GL_UNSIGNED_INT, entries.data());
+        _indirection_dirty[mip] = false;
+    }
+
+    void TerrainVirtualTexture::bind(Program& program, bool enabled) const
+    {
+        // Units and binding match terrain_rvt.glsl
+        _albedo->bind(6);
+        _normal->bind(7);
+        _indirection->bind(8);
+        _feedback->bind(BufferUsage::Storage, 15);
+
+        std::array<glm::vec4, RVT_MIP_COUNT> windows = {};
+        for (u32 mip = 0; mip != RVT_MIP_COUNT; ++mip)
+        {
+            windows[mip] = glm::vec4(glm::vec2(_windows[mip]), page_size(mip), 0.0f);
+        }
+        program.set_uniform(HASH("u_rvt_windows"), windows);
+        program.set_uniform(HASH("u_rvt_enabled"), u32(enabled));
+
+        // A different pixel of every 4x4 block requests pages each frame
+        const u32 pixel = _frame % 16;
+        program.set_uniform(HASH("u_rvt_feedback_pixel"), glm::uvec2(pixel % 4, pixel / 4));
+    }
+
+} // namespace OM3D
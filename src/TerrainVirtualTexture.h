@@ -0,0 +1,125 @@
+#ifndef TERRAINVIRTUALTEXTURE_H
+#define TERRAINVIRTUALTEXTURE_H
+
+#include <ByteBuffer.h>
+#include <Program.h>
+#include <Texture.h>
+#include <shader_structs.h>
+
+#include <glad/gl.h>
+#include <glm/glm.hpp>
+
+#include <array>
+#include <memory>
+#include <unordered_map>
+#include <vector>
+
+namespace OM3D
+{
+
+    // Runtime virtual texture of the terrain surface (albedo, roughness, normal, metalness), so that shading does a
+    // single lookup instead of blending material layers per pixel.
+    // Virtual space is split in square pages aligned on the world, at RVT_MIP_COUNT mips whose pages are twice as
+    // large each. Pages are baked on demand into layers of a physical cache, with a border for filtering. Every mip
+    // has an indirection window of RVT_WINDOW_PAGES pages centered on the camera with toroidal addressing (like the
+    // clipmap), mapping its pages to layers.
+    // Terrain pixels request the page of their mip into a feedback buffer, read back asynchronously. Missing pages
+    // are baked a few per frame, evicting the least recently requested ones. Until then, pixels use the finest baked
+    // page above their mip, or blend the materials when there is none.
+    class TerrainVirtualTexture : NonCopyable
+    {
+    public:
+        // World size of the pages of mip 0
+        static constexpr float page_world_size = 2.0f;
+        // Layers of the physical cache
+        static constexpr u32 physical_pages = 256;
+        static constexpr u32 physical_page_size = RVT_PAGE_SIZE + 2 * RVT_PAGE_BORDER;
+
+        struct Page
+        {
+            u32 mip = 0;
+            // In pages of the mip
+            glm::ivec2 coord = {};
+            u32 layer = 0;
+        };
+
+        TerrainVirtualTexture();
+        ~TerrainVirtualTexture();
+
+        // Reads requests back, moves the windows to the camera and returns the pages to bake before the next frame
+        // (at most RVT_MAX_BAKES), with their layers. Pages are only final when coverage (the world area that has
+        // terrain) contains them, the others are dropped when it changes
+        std::vector<Page> update(const glm::vec3& camera_pos, const glm::vec2& coverage_min,
+                                 const glm::vec2& coverage_max);
+
+        // Drops the baked pages overlapping a world area
+        void invalidate(const glm::vec2& world_min, const glm::vec2& world_max);
+        void invalidate();
+
+        // Binds the pages (units 6 and 7), the indirection (unit 8) and the feedback buffer, and sets the uniforms
+        void bind(Program& program, bool enabled) const;
+
+        Texture& albedo_pages() { return *_albedo; }
+        Texture& normal_pages() { return *_normal; }
+
+        static float page_size(u32 mip) { return page_world_size * float(1u << mip); }
+
+        u32 resident_pages() const { return u32(_pages.size()); }
+        u32 pending_pages() const { return u32(_pending.size()); }
+
+    private:
+        struct PageKey
+        {
+            u32 mip = 0;
+            glm::ivec2 coord = {};
+
+            bool operator==(const PageKey& other) const { return mip == other.mip && coord == other.coord; }
+        };
+
+        struct PageKeyHasher
+        {
+            size_t operator()(const PageKey& key) const noexcept;
+        };
+
+        struct ResidentPage
+        {
+            u32 layer = 0;
+            // Readback that last requested the page
+            u64 last_request = 0;
+            // Baked while partially outside of the coverage
+            bool partial = false;
+        };
+
+        using PageMap = std::unordered_map<PageKey, ResidentPage, PageKeyHasher>;
+
+        void read_back_requests();
+        PageMap::iterator drop_page(PageMap::iterator it);
+        // Free layer, evicting the least recently requested page if needed. False if all were requested last
+        bool allocate_layer(u32& layer);
+        void upload_indirection(u32 mip);
+
+        std::unique_ptr<Texture> _albedo;
+        std::unique_ptr<Texture> _normal;
+        std::unique_ptr<Texture> _indirection;
+
+        std::unique_ptr<ByteBuffer> _feedback;
+        std::unique_ptr<ByteBuffer> _feedback_readback;
+        GLsync _feedback_fence = nullptr;
+
+        PageMap _pages;
+        std::vector<u32> _free_layers;
+        // Requested by the last readback and not baked yet
+        std::vector<PageKey> _pending;
+        u64 _readback_count = 0;
+
+        // First page of the window of each mip
+        std::array<glm::ivec2, RVT_MIP_COUNT> _windows = {};
+        std::array<bool, RVT_MIP_COUNT> _indirection_dirty = {};
+        glm::vec2 _coverage_min = {};
+        glm::vec2 _coverage_max = {};
+        u32 _frame = 0;
+    };
+
+} // namespace OM3D
+
+#endif // TERRAINVIRTUALTEXTURE_H
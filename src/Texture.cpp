@@ -74,6 +74,58 @@ namespace OM3D
         glTextureParameteri(_handle.get(), GL_TEXTURE_WRAP_S, gl_wrap);
         glTextureParameteri(_handle.get(), GL_TEXTURE_WRAP_T, gl_wrap);
 
+        if (is_integer(_format))
+        {
+            // Integer textures are incomplete with linear filtering, even for texelFetch
+            glTextureParameteri(_handle.get(), GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+            glTextureParameteri(_handle.get(), GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+        }
+
+        if (bindless_enabled())
+        {
+            _bindless = glGetTextureHandleARB(_handle.get());
+            glMakeTextureHandleResidentARB(_bindless);
+        }
+    }
+
+
+    Texture::Texture(const glm::uvec2& size, u32 layers, ImageFormat format, WrapMode wrap, u32 mipmaps) :
+        _handle(create_texture_handle(GL_TEXTURE_2D_ARRAY)), _size(size), _layers(layers), _format(format),
+        _texture_type(GL_TEXTURE_2D_ARRAY)
+    {
+
+        const ImageFormatGL gl_format = image_format_to_gl(_format);
+        glTextureStorage3D(_handle.get(), mipmaps, gl_format.internal_format, _size.x, _size.y, _layers);
+
+        const GLenum gl_wrap = (wrap == WrapMode::Repeat) ? GL_REPEAT : GL_CLAMP_TO_EDGE;
+        glTextureParameteri(_handle.get(), GL_TEXTURE_WRAP_R, gl_wrap);
+        glTextureParameteri(_handle.get(), GL_TEXTURE_WRAP_S, gl_wrap);
+        glTextureParameteri(_handle.get(), GL_TEXTURE_WRAP_T, gl_wrap);
+
+        if (bindless_enabled())
+        {
+            _bindless = glGetTextureHandleARB(_handle.get());
+            glMakeTextureHandleResidentARB(_bindless);
+        }
+    }
+
+
+    Texture::Texture(Span<const TextureData> layers) :
+        _handle(create_texture_handle(GL_TEXTURE_2D_ARRAY)), _size(layers[0].size), _layers(u32(layers.size())),
+        _format(layers[0].format), _texture_type(GL_TEXTURE_2D_ARRAY)
+    {
+
+        const ImageFormatGL gl_format = image_format_to_gl(_format);
+        glTextureStorage3D(_handle.get(), mip_levels(_size), gl_format.internal_format, _size.x, _size.y, _layers);
+        for (u32 i = 0; i != _layers; ++i)
+        {
+            ALWAYS_ASSERT(layers[i].size == _size && layers[i].format == _format, "Texture array layers don't match");
+            glTextureSubImage3D(_handle.get(), 0, 0, 0, i, _size.x, _size.y, 1, gl_format.format,
+                                gl_format.component_type, layers[i].data.get());
+        }
+
+        glGenerateTextureMipmap(_handle.get());
+
         if (bindless_enabled())
         {
             _bindless = glGetTextureHandleARB(_handle.get());
@@ -144,9 +196,21 @@ namespace OM3D
 
     void Texture::bind(u32 index) const { glBindTextureUnit(index, _handle.get()); }
 
-    void Texture::bind_as_image(u32 index, AccessType access)
+    void Texture::clear()
     {
-        glBindImageTexture(index, _handle.get(), 0, texture_type() != GL_TEXTURE_2D, 0, access_type_to_gl(access),
+        const ImageFormatGL gl_format = image_format_to_gl(_format);
+        glClearTexImage(_handle.get(), 0, gl_format.format, gl_format.component_type, nullptr);
+    }
+
+    void Texture::clear(const glm::vec4& color)
+    {
+        DEBUG_ASSERT(!is_integer(_format));
+        glClearTexImage(_handle.get(), 0, GL_RGBA, GL_FLOAT, &color);
+    }
+
+    void Texture::bind_as_image(u32 index, AccessType access, u32 mip)
+    {
+        glBindImageTexture(index, _handle.get(), mip, texture_type() != GL_TEXTURE_2D, 0, access_type_to_gl(access),
                            image_format_to_gl(_format).internal_format);
     }
 
@@ -154,13 +218,16 @@ namespace OM3D
     {
         if (!_handle.is_valid())
             return;
-        // nearest filtering for depth map (avoid leaking) as default;
-        glTextureParameteri(_handle.get(), GL_TEXTURE_MIN_FILTER, GL_NEAREST);
-        glTextureParameteri(_handle.get(), GL_TEXTURE_MAG_FILTER, GL_NEAREST);
-        // clamp to border and make outside areas lit
+        // hardware 2x2 PCF: linear filtering with depth comparison
+        glTextureParameteri(_handle.get(), GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+        glTextureParameteri(_handle.get(), GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+        glTextureParameteri(_handle.get(), GL_TEXTURE_COMPARE_MODE, GL_COMPARE_REF_TO_TEXTURE);
+        // We are using reverse-Z: a fragment is lit if it is at least as close as the stored depth
+        glTextureParameteri(_handle.get(), GL_TEXTURE_COMPARE_FUNC, GL_GEQUAL);
+        // clamp to border and make outside areas lit (far is 0 with reverse-Z)
         glTextureParameteri(_handle.get(), GL_TEXTURE_WRAP_S, GL_CLAMP_TO_BORDER);
         glTextureParameteri(_handle.get(), GL_TEXTURE_WRAP_T, GL_CLAMP_TO_BORDER);
-        float borderColor[4] = {1.0f, 1.0f, 1.0f, 1.0f};
+        float borderColor[4] = {0.0f, 0.0f, 0.0f, 0.0f};
         glTextureParameterfv(_handle.get(), GL_TEXTURE_BORDER_COLOR, borderColor);
     }
 
@@ -170,6 +237,8 @@ namespace OM3D
 
     glm::uvec2 Texture::size() const { return _size; }
 
+    u32 Texture::layers() const { return _layers; }
+
     // Return number of mip levels needed
     u32 Texture::mip_levels(glm::uvec2 size)
     {
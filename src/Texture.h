@@ -5,6 +5,7 @@
 #include <graphics.h>
 
 #include <glm/vec2.hpp>
+#include <glm/vec4.hpp>
 
 #include <memory>
 #include <vector>
@@ -45,6 +46,10 @@ namespace OM3D
         u32 id() const { return _handle.get(); }
 
         Texture(const glm::uvec2& size, ImageFormat format, WrapMode wrap);
+        // 2D texture array
+        Texture(const glm::uvec2& size, u32 layers, ImageFormat format, WrapMode wrap, u32 mipmaps = 1);
+        // 2D texture array with mipmaps, layers must all have the same size and format
+        Texture(Span<const TextureData> layers);
 
         static Texture empty_cubemap(u32 size, ImageFormat format, u32 mipmaps = 1);
         static Texture cubemap_from_equirec(const Texture& equirec);
@@ -52,7 +57,13 @@ namespace OM3D
         bool is_null() const;
 
         void bind(u32 index) const;
-        void bind_as_image(u32 index, AccessType access);
+        // Every layer of a texture array is bound
+        void bind_as_image(u32 index, AccessType access, u32 mip = 0);
+
+        // Fill the first mip level with zeros, for formats that glClear doesn't handle (integer formats)
+        void clear();
+        // Fill the first mip level with a color, for float and normalized formats
+        void clear(const glm::vec4& color);
 
         // configure parameters appropriate for a depth/shadow texture
         void set_shadow_parameters();
@@ -62,6 +73,7 @@ namespace OM3D
         u32 texture_type() const;
 
         glm::uvec2 size() const;
+        u32 layers() const;
 
         static u32 mip_levels(glm::uvec2 size);
 
@@ -71,6 +83,7 @@ namespace OM3D
 
         GLHandle _handle;
         glm::uvec2 _size = {};
+        u32 _layers = 1;
         u64 _bindless = {};
         ImageFormat _format;
 
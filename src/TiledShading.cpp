@@ -0,0 +1,88 @@
+#include "TiledShading.h"
+
+#include <TimestampQuery.h>
+
+#include <glad/gl.h>
+
+namespace OM3D
+{
+
+    const char* TiledShading::tile_class_name(TileClass tile_class)
+    {
+        switch (tile_class)
+        {
+            case TileClass::Sky:
+                return "Sky tiles";
+            case TileClass::Terrain:
+                return "Terrain tiles";
+            case TileClass::Generic:
+                return "Generic tiles";
+            case TileClass::Count:
+                break;
+        }
+
+        FATAL("Unknown tile class");
+    }
+
+    TiledShading::TiledShading() : _classify_program(Program::from_file("tile_classify.comp"))
+    {
+        const std::array<std::string, 1> terrain_defines = {"TERRAIN_TILES"};
+        const std::array<std::string, 1> generic_defines = {"GENERIC_TILES"};
+        _shading_programs[u32(TileClass::Terrain)] = Program::from_file("tiled_shading.comp", terrain_defines);
+        _shading_programs[u32(TileClass::Generic)] = Program::from_file("tiled_shading.comp", generic_defines);
+
+        _dispatch_buffer = std::make_unique<TypedBuffer<glm::uvec3>>(nullptr, class_count);
+    }
+
+    void TiledShading::shade(const Texture& albedo_roughness, const Texture& normal_metal, const Texture& depth,
+                             Texture& output, glm::uvec2 size)
+    {
+        const glm::uvec2 tiles = (size + (tile_size - 1)) / tile_size;
+        if (tiles.x * tiles.y > _max_tiles)
+        {
+            _max_tiles = tiles.x * tiles.y;
+            _tile_buffer = std::make_unique<TypedBuffer<u32>>(nullptr, _max_tiles * class_count);
+        }
+
+        {
+            // Used by the previous frame's dispatches: don't wait for them
+            auto mapping = _dispatch_buffer->map(AccessType::WriteDiscard);
+            for (u32 i = 0; i != class_count; ++i)
+            {
+                mapping[i] = glm::uvec3(0, 1, 1);
+            }
+        }
+
+        albedo_roughness.bind(0);
+        normal_metal.bind(1);
+        depth.bind(2);
+        _dispatch_buffer->bind(BufferUsage::Storage, 10);
+        _tile_buffer->bind(BufferUsage::Storage, 11);
+
+        {
+            PROFILE_GPU("Tile classification");
+
+            _classify_program->bind();
+            _classify_program->set_uniform(HASH("render_size"), size);
+            _classify_program->set_uniform(HASH("max_tiles"), _max_tiles);
+            glDispatchCompute(tiles.x, tiles.y, 1);
+        }
+
+        glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT | GL_COMMAND_BARRIER_BIT);
+
+        output.bind_as_image(0, AccessType::WriteOnly);
+        _dispatch_buffer->bind(BufferUsage::DispatchIndirect);
+
+        for (u32 i = u32(TileClass::Terrain); i != class_count; ++i)
+        {
+            PROFILE_GPU(tile_class_name(TileClass(i)));
+
+            Program& program = *_shading_programs[i];
+            program.bind();
+            program.set_uniform(HASH("render_size"), size);
+            program.set_uniform(HASH("tile_offset"), i * _max_tiles);
+            glDispatchComputeIndirect(GLintptr(i * sizeof(glm::uvec3)));
+        }
+    }
+
+} // namespace OM3D
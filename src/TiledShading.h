@@ -0,0 +1,63 @@
+#ifndef TILEDSHADING_H
+#define TILEDSHADING_H
+
+#include <Program.h>
+#include <Texture.h>
+#include <TypedBuffer.h>
+
+#include <glm/vec2.hpp>
+#include <glm/vec3.hpp>
+
+#include <array>
+#include <memory>
+
+namespace OM3D
+{
+
+    // Deferred sun and IBL shading in compute shaders.
+    // The screen is split into tiles classified by what they contain, each class is then shaded by its own kernel,
+    // dispatched indirectly over the tiles of that class, so that simple tiles don't pay for the generic shading.
+    class TiledShading : NonMovable
+    {
+    public:
+        // Must match tiled_shading.glsl
+        static constexpr u32 tile_size = 16;
+
+        enum class TileClass : u32
+        {
+            // Only sky, never dispatched: the sky pass fills these
+            Sky,
+            // Only sky and dielectrics (metallic 0) of any roughness, which is what the terrain writes
+            Terrain,
+            // Anything else, full PBR
+            Generic,
+
+            Count,
+        };
+
+        static const char* tile_class_name(TileClass tile_class);
+
+        TiledShading();
+
+        // Expects the frame data, the IBL textures and the shadows to be bound.
+        // Shades the top left size texels of the G-buffer into output, a RGBA16_FLOAT texture.
+        // Sky texels (depth 0) are left untouched.
+        void shade(const Texture& albedo_roughness, const Texture& normal_metal, const Texture& depth, Texture& output,
+                   glm::uvec2 size);
+
+    private:
+        static constexpr u32 class_count = u32(TileClass::Count);
+
+        std::shared_ptr<Program> _classify_program;
+        // Indexed by class, except the sky which has no kernel
+        std::array<std::shared_ptr<Program>, class_count> _shading_programs;
+
+        // One indirect dispatch per class, followed by the tiles of each class
+        std::unique_ptr<TypedBuffer<glm::uvec3>> _dispatch_buffer;
+        std::unique_ptr<TypedBuffer<u32>> _tile_buffer;
+        u32 _max_tiles = 0;
+    };
+
+} // namespace OM3D
+
+#endif // TILEDSHADING_H
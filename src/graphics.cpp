@@ -26,6 +26,8 @@ namespace OM3D
         std::shared_ptr<Texture> metal_rough;
     } default_textures;
 
+    static std::shared_ptr<Program> blit_program;
+
     bool audit_bindings_before_draw = false;
 
     void debug_out(GLenum, GLenum type, GLuint, GLenum sev, GLsizei, const char* msg, const void*)
@@ -60,6 +62,12 @@ namespace OM3D
 
             case BufferUsage::Storage:
                 return GL_SHADER_STORAGE_BUFFER;
+
+            case BufferUsage::DispatchIndirect:
+                return GL_DISPATCH_INDIRECT_BUFFER;
+
+            case BufferUsage::PixelPack:
+                return GL_PIXEL_PACK_BUFFER;
         }
 
         FATAL("Unknown usage value");
@@ -70,6 +78,7 @@ namespace OM3D
         switch (access)
         {
             case AccessType::WriteOnly:
+            case AccessType::WriteDiscard:
                 return GL_WRITE_ONLY;
 
             case AccessType::ReadOnly:
@@ -183,6 +192,7 @@ namespace OM3D
     {
         brdf_lut_texture = {};
         default_textures = {};
+        blit_program = nullptr;
         profile::destroy_profile();
     }
 
@@ -205,9 +215,16 @@ namespace OM3D
         glDrawArrays(GL_TRIANGLES, 0, 3);
     }
 
-    void blit_to_screen(const Texture& tex)
+    void blit_to_screen(const Texture& tex) { blit_to_screen(tex, tex.size()); }
+
+    void blit_to_screen(const Texture& tex, const glm::uvec2& region)
     {
-        const std::shared_ptr<Program> blit_program = Program::from_files("passthrough.frag", "screen.vert");
+        // Programs are only cached while something holds them
+        if (!blit_program)
+        {
+            blit_program = Program::from_files("passthrough.frag", "screen.vert");
+        }
+        blit_program->set_uniform(HASH("uv_scale"), glm::vec2(region) / glm::vec2(tex.size()));
 
         glBindFramebuffer(GL_FRAMEBUFFER, 0);
         glDisable(GL_DEPTH_TEST); // In case glfw gives us a depth buffer
@@ -3,6 +3,8 @@
 
 #include <utils.h>
 
+#include <glm/vec2.hpp>
+
 #include <memory>
 #include <string_view>
 
@@ -45,13 +47,17 @@ namespace OM3D
         Index,
         Uniform,
         Storage,
+        DispatchIndirect,
+        PixelPack,
     };
 
     enum class AccessType
     {
         WriteOnly,
         ReadOnly,
-        ReadWrite
+        ReadWrite,
+        // Write only, the previous content is dropped so mapping doesn't wait for pending draws (buffers only)
+        WriteDiscard
     };
 
     u32 buffer_usage_to_gl(BufferUsage usage);
@@ -70,6 +76,8 @@ namespace OM3D
 
     void draw_full_screen_triangle();
     void blit_to_screen(const Texture& tex);
+    // Only blits the top left region of the texture
+    void blit_to_screen(const Texture& tex, const glm::uvec2& region);
 
     std::shared_ptr<Texture> default_black_texture();
     std::shared_ptr<Texture> default_white_texture();
@@ -4,10 +4,18 @@
 #define GLFW_INCLUDE_NONE
 #include <GLFW/glfw3.h>
 
+#include <AutoExposure.h>
+#include <DynamicResolution.h>
 #include <Framebuffer.h>
 #include <ImGuiRenderer.h>
+#include <LightClusters.h>
+#include <PostProcess.h>
+#include <RenderGraph.h>
 #include <Scene.h>
+#include <ShadowCascades.h>
 #include <Terrain.h>
+#include <TemporalAA.h>
+#include <TiledShading.h>
 #include <Texture.h>
 #include <TimestampQuery.h>
 #include <graphics.h>
@@ -16,6 +24,7 @@
 
 #include <filesystem>
 #include <iostream>
+#include <random>
 #include <vector>
 
 using namespace OM3D;
@@ -27,12 +36,37 @@ static float sun_azimuth = 45.0f;
 static float sun_intensity = 7.0f;
 static float ibl_intensity = 1.0f;
 static float exposure = 0.33f;
-static float tesselation_factor = 4.0f;
 static int gbuffer_debug_mode = 2; // 0=depth, 1=normal, 2=albedo, 3=metallic, 4=roughness
+static bool point_lights_enabled = true;
+static bool cluster_heatmap = false;
+static bool gbuffer_debug_view = false;
+static bool visibility_buffer = false;
+static int shadow_cascade_count = 4;
+static float shadow_split_lambda = 0.75f;
+static float shadow_distance = 500.0f;
+static int shadow_cached_cascades = 2;
+static int upscale_filter = 1; // 0=bilinear, 1=edge-aware
+static std::string heightfield_file;
+static bool terrain_sculpting = false;
+static float sculpt_radius = 15.0f;
+// Height added per second at the center of the brush
+static float sculpt_strength = 10.0f;
+// Terrain settings being dragged, they are applied on release
+static float edited_noise_frequency = 0.0f;
+static float edited_height_scale = 0.0f;
 
 static std::unique_ptr<Scene> scene;
 static std::shared_ptr<Texture> envmap;
 static std::unique_ptr<Terrain> terrain;
+static std::unique_ptr<LightClusters> light_clusters;
+static std::unique_ptr<ShadowCascades> shadows;
+static std::unique_ptr<RenderGraph> render_graph;
+static DynamicResolution dynamic_resolution;
+static std::unique_ptr<TemporalAA> taa;
+static std::unique_ptr<AutoExposure> auto_exposure;
+static std::unique_ptr<TiledShading> tiled_shading;
+static std::unique_ptr<PostProcess> post_process;
+static PostProcess::Settings post_settings;
 
 namespace OM3D
 {
@@ -49,6 +83,32 @@ void parse_args(int argc, char** argv)
         {
             OM3D::audit_bindings_before_draw = true;
         }
+        else if (arg == "--heightfield" && i + 1 < argc)
+        {
+            heightfield_file = argv[++i];
+        }
+        else if (arg == "--convert-heightfield" && i + 2 < argc)
+        {
+            // Followed by the input, the output, and optionally the texel size, the min height and the max height
+            const std::string input = argv[++i];
+            const std::string output = argv[++i];
+            HeightTileFile::ConvertSettings settings;
+            for (float* value: {&settings.texel_size, &settings.min_height, &settings.max_height})
+            {
+                char* end = nullptr;
+                const float parsed = i + 1 < argc ? std::strtof(argv[i + 1], &end) : 0.0f;
+                if (!end || end == argv[i + 1] || *end)
+                {
+                    break;
+                }
+                *value = parsed;
+                ++i;
+            }
+
+            const bool converted = HeightTileFile::convert(input, output, settings).is_ok;
+            std::cerr << (converted ? "Converted " : "Failed to convert ") << input << std::endl;
+            std::exit(converted ? EXIT_SUCCESS : EXIT_FAILURE);
+        }
         else
         {
             std::cerr << "Unknown argument \"" << arg << "\"" << std::endl;
@@ -139,6 +199,30 @@ void process_inputs(GLFWwindow* window, Camera& camera)
         int height = 0;
         glfwGetWindowSize(window, &width, &height);
         camera.set_ratio(float(width) / float(height));
+
+        // Right click raises the terrain under the cursor, lowers it with control
+        if (terrain_sculpting && glfwGetMouseButton(window, GLFW_MOUSE_BUTTON_RIGHT) == GLFW_PRESS)
+        {
+            glm::vec2 ndc = glm::vec2(new_mouse_pos) / glm::vec2(width, height) * 2.0f - 1.0f;
+            ndc.y = -ndc.y;
+
+            // Reverse-Z: depth is 1 on the near plane
+            const glm::mat4 inv_view_proj = glm::inverse(camera.view_proj_matrix());
+            const glm::vec4 near_point = inv_view_proj * glm::vec4(ndc, 1.0f, 1.0f);
+            const glm::vec4 far_point = inv_view_proj * glm::vec4(ndc, 0.5f, 1.0f);
+
+            TerrainRay ray;
+            ray.origin = camera.position();
+            ray.direction = glm::normalize(glm::vec3(far_point) / far_point.w - glm::vec3(near_point) / near_point.w);
+            TerrainHit hit;
+            terrain->raycast(ray, hit);
+            if (hit.is_hit())
+            {
+                const bool lower = glfwGetKey(window, GLFW_KEY_LEFT_CONTROL) == GLFW_PRESS;
+                terrain->add_stamp(glm::vec2(hit.position.x, hit.position.z), sculpt_radius,
+                                   (lower ? -sculpt_strength : sculpt_strength) * delta_time);
+            }
+        }
     }
 
     mouse_pos = new_mouse_pos;
@@ -157,6 +241,14 @@ void load_envmap(const std::string& filename)
     }
 }
 
+void load_color_grading_lut(const std::string& filename)
+{
+    if (post_process->load_color_grading_lut(filename))
+    {
+        post_settings.color_grading = true;
+    }
+}
+
 void load_scene(const std::string& filename)
 {
     if (auto res = Scene::from_gltf(filename); res.is_ok)
@@ -172,6 +264,24 @@ void load_scene(const std::string& filename)
     }
 }
 
+void add_random_lights(u32 count)
+{
+    static std::mt19937 rng(42);
+    std::uniform_real_distribution<float> horizontal(-200.0f, 200.0f);
+    std::uniform_real_distribution<float> vertical(5.0f, 40.0f);
+    std::uniform_real_distribution<float> radius(5.0f, 20.0f);
+    std::uniform_real_distribution<float> color(0.0f, 1.0f);
+
+    for (u32 i = 0; i != count; ++i)
+    {
+        PointLight light;
+        light.set_position(glm::vec3(horizontal(rng), vertical(rng), horizontal(rng)));
+        light.set_color(glm::vec3(color(rng), color(rng), color(rng)) * 200.0f);
+        light.set_radius(radius(rng));
+        scene->add_light(std::move(light));
+    }
+}
+
 std::vector<std::string> list_data_files(Span<const std::string> extensions = {})
 {
     std::vector<std::string> files;
@@ -241,6 +351,7 @@ void gui(ImGuiRenderer& imgui)
 
     bool open_scene_popup = false;
     bool load_envmap_popup = false;
+    bool load_lut_popup = false;
     if (ImGui::BeginMainMenuBar())
     {
         if (ImGui::BeginMenu("File"))
@@ -253,12 +364,43 @@ void gui(ImGuiRenderer& imgui)
             {
                 load_envmap_popup = true;
             }
+            if (ImGui::MenuItem("Open Color Grading LUT"))
+            {
+                load_lut_popup = true;
+            }
             ImGui::EndMenu();
         }
 
         if (ImGui::BeginMenu("Lighting"))
         {
-            ImGui::DragFloat("Exposure", &exposure, 0.01f, 0.01f, 10.0f, "%.2f", ImGuiSliderFlags_Logarithmic);
+            bool auto_exposure_enabled = auto_exposure->enabled();
+            if (ImGui::Checkbox("Auto exposure", &auto_exposure_enabled))
+            {
+                auto_exposure->set_enabled(auto_exposure_enabled);
+            }
+            if (auto_exposure_enabled)
+            {
+                float compensation = auto_exposure->compensation();
+                if (ImGui::DragFloat("Compensation (EV)", &compensation, 0.05f, -5.0f, 5.0f, "%.2f"))
+                {
+                    auto_exposure->set_compensation(compensation);
+                }
+                float percentiles[] = {auto_exposure->low_percentile(), auto_exposure->high_percentile()};
+                if (ImGui::DragFloat2("Percentiles", percentiles, 0.005f, 0.0f, 1.0f, "%.3f") &&
+                    percentiles[0] < percentiles[1])
+                {
+                    auto_exposure->set_percentiles(percentiles[0], percentiles[1]);
+                }
+                float speeds[] = {auto_exposure->speed_up(), auto_exposure->speed_down()};
+                if (ImGui::DragFloat2("Adaptation up/down", speeds, 0.05f, 0.1f, 20.0f, "%.2f"))
+                {
+                    auto_exposure->set_speeds(speeds[0], speeds[1]);
+                }
+            }
+            else
+            {
+                ImGui::DragFloat("Exposure", &exposure, 0.01f, 0.01f, 10.0f, "%.2f", ImGuiSliderFlags_Logarithmic);
+            }
 
             ImGui::Separator();
 
@@ -272,12 +414,126 @@ void gui(ImGuiRenderer& imgui)
             ImGui::DragFloat("Sun Intensity", &sun_intensity, 0.05f, 0.0f, 100.0f, "%.1f");
             scene->set_sun(sun_altitude, sun_azimuth, glm::vec3(sun_intensity));
 
+            ImGui::Separator();
+
+            ImGui::Checkbox("Point lights", &point_lights_enabled);
+            ImGui::Checkbox("Cluster heatmap", &cluster_heatmap);
+            if (ImGui::Button("Add 1000 random lights"))
+            {
+                add_random_lights(1000);
+            }
+
+            ImGui::EndMenu();
+        }
+        if (ImGui::BeginMenu("Shadows"))
+        {
+            ImGui::SliderInt("Cascades", &shadow_cascade_count, 1, int(ShadowCascades::max_cascades));
+            ImGui::DragFloat("Split lambda", &shadow_split_lambda, 0.01f, 0.0f, 1.0f, "%.2f");
+            ImGui::DragFloat("Distance", &shadow_distance, 1.0f, 10.0f, 2000.0f, "%.0f");
+            ImGui::SliderInt("Cached cascades", &shadow_cached_cascades, 0, shadow_cascade_count);
+
+            shadows->set_cascade_count(u32(shadow_cascade_count));
+            shadows->set_split_lambda(shadow_split_lambda);
+            shadows->set_max_distance(shadow_distance);
+            shadow_cached_cascades = std::min(shadow_cached_cascades, shadow_cascade_count);
+            shadows->set_first_cached_cascade(u32(shadow_cascade_count - shadow_cached_cascades));
+
+            ImGui::Separator();
+
+            for (u32 i = 0; i != shadows->cascade_count(); ++i)
+            {
+                ImGui::Text("Cascade %u: %s", i, shadows->was_rendered(i) ? "rendered" : "cached");
+            }
+
             ImGui::EndMenu();
         }
         if (ImGui::BeginMenu("Terrain"))
         {
-            ImGui::DragFloat("Tesselation Factor", &tesselation_factor, 0.1f, 1.0f, 64.0f);
-            terrain->set_tesselation_factor(tesselation_factor);
+            float target_quad_pixels = terrain->target_quad_pixels();
+            if (ImGui::DragFloat("Quad size (pixels)", &target_quad_pixels, 0.05f, 1.0f, 32.0f, "%.2f"))
+            {
+                terrain->set_target_quad_pixels(std::max(target_quad_pixels, 1.0f));
+            }
+            ImGui::Text("%u patches", terrain->drawn_patches());
+
+            bool virtual_texture = terrain->virtual_texture_enabled();
+            if (ImGui::Checkbox("Virtual texture", &virtual_texture))
+            {
+                terrain->set_virtual_texture_enabled(virtual_texture);
+            }
+            ImGui::Text("%u pages baked, %u pending", terrain->virtual_texture().resident_pages(),
+                        terrain->virtual_texture().pending_pages());
+
+            if (terrain->has_heightfield())
+            {
+                ImGui::Text("Heightfield: %s", heightfield_file.c_str());
+                if (ImGui::Button("Use procedural heights"))
+                {
+                    terrain->unload_heightfield();
+                }
+            }
+            else
+            {
+                ImGui::DragFloat("Noise frequency", &edited_noise_frequency, 0.0005f, 0.001f, 0.2f, "%.4f");
+                if (ImGui::IsItemDeactivatedAfterEdit())
+                {
+                    terrain->set_noise_frequency(std::max(edited_noise_frequency, 0.001f));
+                }
+                if (!ImGui::IsItemActive())
+                {
+                    edited_noise_frequency = terrain->noise_frequency();
+                }
+                if (!heightfield_file.empty() && ImGui::Button("Use heightfield"))
+                {
+                    terrain->load_heightfield(heightfield_file);
+                }
+            }
+            // Heightfields are stored with their own range of heights, the scale only applies to the noise
+            ImGui::BeginDisabled(terrain->has_heightfield());
+            ImGui::DragFloat("Height scale", &edited_height_scale, 0.5f, 1.0f, 500.0f);
+            if (ImGui::IsItemDeactivatedAfterEdit())
+            {
+                terrain->set_height_scale(std::max(edited_height_scale, 1.0f));
+            }
+            if (!ImGui::IsItemActive())
+            {
+                edited_height_scale = terrain->height_scale();
+            }
+            ImGui::EndDisabled();
+
+            ImGui::Separator();
+            ImGui::Checkbox("Sculpt (right click, control lowers)", &terrain_sculpting);
+            ImGui::DragFloat("Brush radius", &sculpt_radius, 0.1f, 1.0f, 200.0f);
+            ImGui::DragFloat("Brush strength", &sculpt_strength, 0.1f, 0.1f, 100.0f);
+            sculpt_radius = std::max(sculpt_radius, 1.0f);
+            if (ImGui::Button("Clear edits"))
+            {
+                terrain->clear_edits();
+            }
+
+            ImGui::Separator();
+            if (scene)
+            {
+                const Camera& camera = scene->camera();
+                const glm::vec2 position = glm::vec2(camera.position().x, camera.position().z);
+                float ground_height = 0.0f;
+                terrain->heights(position, ground_height);
+                ImGui::Text("Ground height: %.2f", ground_height);
+
+                TerrainRay ray;
+                ray.origin = camera.position();
+                ray.direction = camera.forward();
+                TerrainHit hit;
+                terrain->raycast(ray, hit);
+                if (hit.is_hit())
+                {
+                    ImGui::Text("View ray hit at %.1f", hit.distance);
+                }
+                else
+                {
+                    ImGui::Text("View ray doesn't hit");
+                }
+            }
             ImGui::EndMenu();
         }
         if (scene && ImGui::BeginMenu("Scene Info"))
@@ -287,8 +543,30 @@ void gui(ImGuiRenderer& imgui)
             ImGui::EndMenu();
         }
 
+        if (ImGui::BeginMenu("Post-processing"))
+        {
+            if (ImGui::BeginCombo("Tone mapping", PostProcess::tone_mapping_name(post_settings.tone_mapping)))
+            {
+                for (u32 i = 0; i != u32(PostProcess::ToneMapping::Count); ++i)
+                {
+                    const auto tone_mapping = PostProcess::ToneMapping(i);
+                    if (ImGui::Selectable(PostProcess::tone_mapping_name(tone_mapping),
+                                          tone_mapping == post_settings.tone_mapping))
+                    {
+                        post_settings.tone_mapping = tone_mapping;
+                    }
+                }
+                ImGui::EndCombo();
+            }
+            ImGui::Checkbox("Color grading", &post_settings.color_grading);
+            ImGui::Checkbox("Dithering", &post_settings.dithering);
+            ImGui::EndMenu();
+        }
+
         if (ImGui::BeginMenu("G-Buffer Debug"))
         {
+            ImGui::Checkbox("Show", &gbuffer_debug_view);
+            ImGui::Separator();
             ImGui::RadioButton("Depth", &gbuffer_debug_mode, 0);
             ImGui::RadioButton("Normal", &gbuffer_debug_mode, 1);
             ImGui::RadioButton("Albedo", &gbuffer_debug_mode, 2);
@@ -297,6 +575,118 @@ void gui(ImGuiRenderer& imgui)
             ImGui::EndMenu();
         }
 
+        if (ImGui::BeginMenu("Render Graph"))
+        {
+            ImGui::BeginDisabled(!scene->supports_visibility_buffer());
+            ImGui::Checkbox("Visibility buffer", &visibility_buffer);
+            ImGui::EndDisabled();
+
+            ImGui::Separator();
+
+            const auto to_mb = [](u64 bytes) { return float(double(bytes) / (1024.0 * 1024.0)); };
+            const u64 requested = render_graph->requested_transient_bytes();
+            const u64 allocated = render_graph->allocated_transient_bytes();
+
+            ImGui::Text("%u transient textures, %u allocated", render_graph->transient_texture_count(),
+                        render_graph->pooled_texture_count());
+            ImGui::Text("Requested: %.1f MB", to_mb(requested));
+            ImGui::Text("Allocated: %.1f MB", to_mb(allocated));
+            ImGui::Text("Saved by aliasing: %.1f MB", to_mb(requested > allocated ? requested - allocated : 0));
+
+            ImGui::Separator();
+
+            u32 index = 0;
+            for (const RenderGraph::PassInfo& pass: render_graph->passes())
+            {
+                if (pass.culled)
+                {
+                    ImGui::TextDisabled("   %s (culled)", pass.name.c_str());
+                }
+                else
+                {
+                    ImGui::Text("%2u %s", index++, pass.name.c_str());
+                }
+            }
+
+            ImGui::EndMenu();
+        }
+
+        if (ImGui::BeginMenu("Anti-Aliasing"))
+        {
+            bool enabled = taa->enabled();
+            if (ImGui::Checkbox("TAA", &enabled))
+            {
+                taa->set_enabled(enabled);
+            }
+
+            ImGui::BeginDisabled(!enabled);
+            float blend_factor = taa->blend_factor();
+            if (ImGui::SliderFloat("Current frame weight", &blend_factor, 0.02f, 1.0f))
+            {
+                taa->set_blend_factor(blend_factor);
+            }
+
+            bool sharp_history = taa->sharp_history();
+            if (ImGui::Checkbox("Catmull-Rom history", &sharp_history))
+            {
+                taa->set_sharp_history(sharp_history);
+            }
+
+            if (ImGui::Button("Reset history"))
+            {
+                taa->reset_history();
+            }
+
+            ImGui::Text("%u jitter phases", taa->jitter_phase_count());
+            ImGui::EndDisabled();
+
+            ImGui::EndMenu();
+        }
+
+        if (ImGui::BeginMenu("Dynamic Resolution"))
+        {
+            bool enabled = dynamic_resolution.enabled();
+            if (ImGui::Checkbox("Enabled", &enabled))
+            {
+                dynamic_resolution.set_enabled(enabled);
+            }
+
+            float budget_ms = dynamic_resolution.budget() * 1000.0f;
+            if (ImGui::DragFloat("GPU budget (ms)", &budget_ms, 0.1f, 1.0f, 100.0f, "%.1f"))
+            {
+                dynamic_resolution.set_budget(std::max(budget_ms, 1.0f) / 1000.0f);
+            }
+
+            float min_scale = dynamic_resolution.min_scale();
+            if (ImGui::SliderFloat("Min scale", &min_scale, 0.25f, DynamicResolution::max_scale))
+            {
+                dynamic_resolution.set_min_scale(min_scale);
+            }
+
+            float scale = dynamic_resolution.scale();
+            ImGui::BeginDisabled(enabled);
+            if (ImGui::SliderFloat("Scale", &scale, dynamic_resolution.min_scale(), DynamicResolution::max_scale))
+            {
+                dynamic_resolution.set_scale(scale);
+            }
+            ImGui::EndDisabled();
+
+            ImGui::Separator();
+            // TAA upsamples on its own
+            ImGui::BeginDisabled(taa->enabled());
+            ImGui::RadioButton("Bilinear upscale", &upscale_filter, 0);
+            ImGui::RadioButton("Edge-aware upscale", &upscale_filter, 1);
+            ImGui::EndDisabled();
+
+            ImGui::Separator();
+            const ImVec2 display_size = ImGui::GetIO().DisplaySize;
+            const glm::uvec2 internal_size =
+                    dynamic_resolution.internal_size(glm::uvec2(u32(display_size.x), u32(display_size.y)));
+            ImGui::Text("Internal resolution: %ux%u (%.0f%%)", internal_size.x, internal_size.y, scale * 100.0f);
+
+            ImGui::EndMenu();
+        }
+
         if (ImGui::MenuItem("GPU Profiler"))
         {
             open_gpu_profiler = true;
@@ -357,6 +747,24 @@ void gui(ImGuiRenderer& imgui)
         ImGui::EndPopup();
     }
 
+    if (load_lut_popup)
+    {
+        ImGui::OpenPopup("###openlutpopup");
+
+        const std::array<std::string, 3> extensions = {".png", ".jpg", ".tga"};
+        load_files = list_data_files(extensions);
+    }
+
+    if (ImGui::BeginPopup("###openlutpopup", ImGuiWindowFlags_AlwaysAutoResize))
+    {
+        if (load_file_window(load_files, load_color_grading_lut))
+        {
+            ImGui::CloseCurrentPopup();
+        }
+
+        ImGui::EndPopup();
+    }
+
     if (open_gpu_profiler)
     {
         if (ImGui::Begin(ICON_FA_CLOCK " GPU Profiler"))
@@ -441,106 +849,422 @@ void load_default_scene()
     }
 }
 
+// Size independent rendering resources, created once.
+// Render targets are transient textures owned by the render graph and follow the window size.
 struct RendererState
 {
-    static RendererState create(glm::uvec2 size)
+    static RendererState create()
     {
         RendererState state;
 
-        state.size = size;
+        state.gbuffer_debug_program = Program::from_files("gbuffer_debug.frag", "screen.vert");
+        state.oit_composite_program = Program::from_files("oit_composite.frag", "screen.vert");
 
-        if (state.size.x > 0 && state.size.y > 0)
-        {
+        state.point_light_material = Material::point_light_material();
+        state.point_light_heatmap_material = Material::point_light_material(true);
+
+        // Terrain height generation, the clipmap is owned by the terrain
+        state.heightmap_program = Program::from_file("terrain_gen.comp");
+
+        // Terrain rendering programs (CDLOD patches)
+        state.terrain_gbuffer_program = Program::from_files("terrain_gbuffer.frag", "terrain.vert");
+        state.terrain_depth_program = Program::from_files("depth.frag", "terrain.vert");
+
+        return state;
+    }
+
+    // Window size, updated every frame
+    glm::uvec2 size = {};
+
+    std::shared_ptr<Program> gbuffer_debug_program;
+    std::shared_ptr<Program> oit_composite_program;
 
-            state.depth_texture = Texture(size, ImageFormat::Depth32_FLOAT, WrapMode::Clamp);
-            state.lit_hdr_texture = Texture(size, ImageFormat::RGBA16_FLOAT, WrapMode::Clamp);
-            state.tone_mapped_texture = Texture(size, ImageFormat::RGBA8_UNORM, WrapMode::Clamp);
-            state.main_framebuffer = Framebuffer(&state.depth_texture, std::array{&state.lit_hdr_texture});
-            state.tone_map_framebuffer = Framebuffer(nullptr, std::array{&state.tone_mapped_texture});
+    Material point_light_material;
+    Material point_light_heatmap_material;
 
-            state.depth_program = Program::from_files("depth.frag", "basic.vert");
+    std::shared_ptr<Program> heightmap_program;
 
-            state.gbuffer_albedo_roughness = Texture(size, ImageFormat::RGBA8_sRGB, WrapMode::Clamp);
-            state.gbuffer_normal_metal = Texture(size, ImageFormat::RGBA8_UNORM, WrapMode::Clamp);
-            state.gbuffer_framebuffer = Framebuffer(
-                    &state.depth_texture, std::array{&state.gbuffer_albedo_roughness, &state.gbuffer_normal_metal});
-            state.gbuffer_debug_output = Texture(size, ImageFormat::RGBA8_UNORM, WrapMode::Clamp);
-            state.gbuffer_debug_framebuffer = Framebuffer(nullptr, std::array{&state.gbuffer_debug_output});
-            state.gbuffer_debug_program = Program::from_files("gbuffer_debug.frag", "screen.vert");
+    std::shared_ptr<Program> terrain_gbuffer_program;
+    std::shared_ptr<Program> terrain_depth_program;
+};
 
-            // Shading framebuffer outputs to lit_hdr_texture
-            state.shading_framebuffer = Framebuffer(nullptr, std::array{&state.lit_hdr_texture});
+// Declares the passes of the frame and runs them, passes whose results aren't displayed are culled by the graph
+void render_frame(RendererState& renderer)
+{
+    using Access = RenderGraph::Access;
+    using Resource = RenderGraph::Resource;
 
-            // shadow map resources
-            const glm::uvec2 shadow_size = glm::uvec2(2048u, 2048u);
-            state.shadow_depth_texture = Texture(shadow_size, ImageFormat::Depth32_FLOAT, WrapMode::Clamp);
-            state.shadow_depth_texture.set_shadow_parameters();
-            state.shadow_framebuffer = Framebuffer(&state.shadow_depth_texture);
-            state.shadow_program = Program::from_files("shadow.frag", "shadow.vert");
+    RenderGraph& graph = *render_graph;
+    graph.reset();
 
-            state.scene_shading_program = Program::from_files("scene.frag", "screen.vert"); // Without IBL
-            state.pl_shading_program = Program::from_files("pl.frag", "screen.vert");
-            state.point_light_material = Material::point_light_material();
+    const glm::uvec2 output_size = renderer.size;
+    if (!output_size.x || !output_size.y)
+    {
+        // Minimized window
+        return;
+    }
 
-            // Heightmap and normalmap resources
-            const glm::uvec2 heightmap_size = glm::uvec2(8192u, 8192u);
-            state.heightmap_texture =
-                    std::make_shared<Texture>(heightmap_size, ImageFormat::R32_FLOAT, WrapMode::Clamp);
-            state.normalmap_texture =
-                    std::make_shared<Texture>(heightmap_size, ImageFormat::RGBA16_FLOAT, WrapMode::Clamp);
-            state.heightmap_program = Program::from_file("terrain_gen.comp");
+    // Everything up to the tonemap renders at the internal resolution, in the top left corner of targets allocated for
+    // the output resolution so that scale changes never reallocate them
+    const glm::uvec2 size = dynamic_resolution.internal_size(output_size);
 
-            // Terrain rendering programs (tessellation shaders)
-            state.terrain_gbuffer_program =
-                    Program::from_files("terrain_gbuffer.frag", "terrain.vert", "terrain.tesc", "terrain.tese");
-            state.terrain_depth_program =
-                    Program::from_files("depth.frag", "terrain.vert", "terrain.tesc", "terrain.tese");
-            state.heightmap_program->bind();
+    // Jitters the camera until end_frame()
+    taa->begin_frame(scene->camera(), size, output_size);
 
-            // Bind textures to image units
-            state.heightmap_texture->bind_as_image(0, AccessType::ReadWrite);
-            state.normalmap_texture->bind_as_image(1, AccessType::ReadWrite);
-        }
+    const Resource shadow_map = graph.import_texture("Shadow map", shadows->shadow_map());
 
-        return state;
+    // The clipmap lives outside of the graph, it is read by every terrain draw
+    graph.add_pass(
+            "Terrain clipmap", [&](RenderGraph::PassBuilder& builder) { builder.set_side_effect(); },
+            [&](const RenderGraph::PassContext&)
+            {
+                // LODs follow the output resolution, not the dynamic one, so that they don't change with it
+                terrain->set_viewport_height(output_size.y);
+                terrain->update(scene->camera().position());
+            });
+
+    Resource depth;
+    graph.add_pass(
+            "Z-prepass",
+            [&](RenderGraph::PassBuilder& builder)
+            {
+                depth = builder.create_texture("Depth", {size, ImageFormat::Depth32_FLOAT, output_size});
+                builder.write(depth, Access::DepthAttachment);
+            },
+            [&](const RenderGraph::PassContext& pass)
+            {
+                pass.bind_framebuffer(true, false);
+
+                scene->render_depth();
+
+                renderer.terrain_depth_program->bind();
+                terrain->render(*renderer.terrain_depth_program, scene->camera());
+            });
+
+    graph.add_pass(
+            "Shadow pass",
+            [&](RenderGraph::PassBuilder& builder) { builder.write(shadow_map, Access::DepthAttachment); },
+            [&](const RenderGraph::PassContext&)
+            { shadows->render(*scene, *terrain, *renderer.terrain_depth_program); });
+
+    // Visibility buffer: opaque objects only write their draw and triangle IDs,
+    // their materials are then evaluated once per pixel in the G-buffer pass
+    const bool use_visibility = visibility_buffer && scene->supports_visibility_buffer();
+    Resource visibility;
+    if (use_visibility)
+    {
+        graph.add_pass(
+                "Visibility pass",
+                [&](RenderGraph::PassBuilder& builder)
+                {
+                    visibility = builder.create_texture("Visibility", {size, ImageFormat::R32_UINT, output_size});
+                    builder.read(depth, Access::DepthAttachment);
+                    builder.write(visibility, Access::ColorAttachment);
+                },
+                [&](const RenderGraph::PassContext& pass)
+                {
+                    // glClear doesn't support integer formats
+                    pass.texture(visibility).clear();
+                    pass.bind_framebuffer(false, false);
+                    scene->render_visibility();
+                });
     }
 
-    glm::uvec2 size = {};
+    Resource albedo_roughness;
+    Resource normal_metal;
+    Resource motion;
+    graph.add_pass(
+            "G-Buffer pass",
+            [&](RenderGraph::PassBuilder& builder)
+            {
+                albedo_roughness =
+                        builder.create_texture("Albedo roughness", {size, ImageFormat::RGBA8_sRGB, output_size});
+                normal_metal = builder.create_texture("Normal metal", {size, ImageFormat::RGBA8_UNORM, output_size});
+                builder.write(depth, Access::DepthAttachment);
+                builder.write(albedo_roughness, Access::ColorAttachment);
+                builder.write(normal_metal, Access::ColorAttachment);
+                if (taa->enabled())
+                {
+                    motion = builder.create_texture("Motion", {size, ImageFormat::RG16_FLOAT, output_size});
+                    builder.write(motion, Access::ColorAttachment);
+                }
+                if (use_visibility)
+                {
+                    builder.read(visibility);
+                }
+            },
+            [&](const RenderGraph::PassContext& pass)
+            {
+                pass.bind_framebuffer(false, true);
+                taa->bind();
+                if (use_visibility)
+                {
+                    scene->render_from_visibility(pass.texture(visibility));
+                }
+                else
+                {
+                    scene->render();
+                }
+
+                renderer.terrain_gbuffer_program->bind();
+                terrain->render(*renderer.terrain_gbuffer_program, scene->camera());
+            });
 
-    Texture depth_texture;
-    Texture lit_hdr_texture;
-    Texture tone_mapped_texture;
+    Resource gbuffer_debug;
+    graph.add_pass(
+            "G-Buffer Debug",
+            [&](RenderGraph::PassBuilder& builder)
+            {
+                gbuffer_debug = builder.create_texture("G-Buffer debug", {size, ImageFormat::RGBA8_UNORM, output_size});
+                builder.read(albedo_roughness);
+                builder.read(normal_metal);
+                builder.read(depth);
+                builder.write(gbuffer_debug, Access::ColorAttachment);
+            },
+            [&](const RenderGraph::PassContext& pass)
+            {
+                pass.bind_framebuffer(false, true);
+                renderer.gbuffer_debug_program->bind();
+                renderer.gbuffer_debug_program->set_uniform(HASH("debug_mode"), u32(gbuffer_debug_mode));
 
-    // Shadow map resources
-    Texture shadow_depth_texture;
-    Framebuffer shadow_framebuffer;
-    std::shared_ptr<Program> shadow_program;
+                pass.texture(albedo_roughness).bind(0);
+                pass.texture(normal_metal).bind(1);
+                pass.texture(depth).bind(2);
 
-    Texture gbuffer_albedo_roughness;
-    Texture gbuffer_normal_metal;
-    Framebuffer gbuffer_framebuffer;
-    Texture gbuffer_debug_output;
-    Framebuffer gbuffer_debug_framebuffer;
-    std::shared_ptr<Program> gbuffer_debug_program;
+                draw_full_screen_triangle();
+            });
+
+    Resource lit_hdr;
+    graph.add_pass(
+            "Scene Shading Pass",
+            [&](RenderGraph::PassBuilder& builder)
+            {
+                lit_hdr = builder.create_texture("Lit HDR", {size, ImageFormat::RGBA16_FLOAT, output_size});
+                builder.read(albedo_roughness);
+                builder.read(normal_metal);
+                builder.read(depth);
+                builder.read(shadow_map);
+                builder.write(lit_hdr, Access::ImageStore);
+            },
+            [&](const RenderGraph::PassContext& pass)
+            {
+                // Following full screen passes don't set these
+                glDisable(GL_BLEND);
+                glDisable(GL_DEPTH_TEST);
+                glDepthMask(GL_FALSE);
+                glDisable(GL_CULL_FACE);
 
-    Framebuffer main_framebuffer;
-    Framebuffer tone_map_framebuffer;
+                scene->bind_buffer();
+                shadows->bind();
+                tiled_shading->shade(pass.texture(albedo_roughness), pass.texture(normal_metal), pass.texture(depth),
+                                     pass.texture(lit_hdr), size);
+            });
 
-    std::shared_ptr<Program> depth_program;
+    if (point_lights_enabled && (cluster_heatmap || !scene->point_lights().is_empty()))
+    {
+        light_clusters->resize(size);
+        const Resource clusters = graph.import_buffer("Light clusters", light_clusters->cluster_buffer());
+        const Resource light_indices = graph.import_buffer("Light indices", light_clusters->index_buffer());
 
-    Framebuffer shading_framebuffer;
-    std::shared_ptr<Program> scene_shading_program;
-    std::shared_ptr<Program> pl_shading_program;
-    Material point_light_material;
+        graph.add_pass(
+                "Light Culling",
+                [&](RenderGraph::PassBuilder& builder)
+                {
+                    builder.write(clusters, Access::StorageWrite);
+                    builder.write(light_indices, Access::StorageWrite);
+                },
+                [&](const RenderGraph::PassContext&)
+                {
+                    scene->bind_buffer_pl();
+                    light_clusters->update(*scene);
+                });
 
-    // Heightmap and normalmap resources
-    std::shared_ptr<Texture> heightmap_texture;
-    std::shared_ptr<Texture> normalmap_texture;
-    std::shared_ptr<Program> heightmap_program;
+        graph.add_pass(
+                "Point Lights Shading Pass",
+                [&](RenderGraph::PassBuilder& builder)
+                {
+                    builder.read(clusters, Access::StorageRead);
+                    builder.read(light_indices, Access::StorageRead);
+                    builder.read(albedo_roughness);
+                    builder.read(normal_metal);
+                    builder.read(depth);
+                    builder.write(lit_hdr, Access::ColorAttachment);
+                },
+                [&](const RenderGraph::PassContext& pass)
+                {
+                    pass.bind_framebuffer(false, false);
+
+                    pass.texture(albedo_roughness).bind(0);
+                    pass.texture(normal_metal).bind(1);
+                    pass.texture(depth).bind(2);
+
+                    const Material& material =
+                            cluster_heatmap ? renderer.point_light_heatmap_material : renderer.point_light_material;
+                    material.bind();
+                    light_clusters->bind(material.program());
+                    draw_full_screen_triangle();
+
+                    glDepthMask(GL_TRUE);
+                    glDisable(GL_BLEND);
+                    glEnable(GL_CULL_FACE);
+                    glCullFace(GL_BACK);
+                });
+    }
 
-    std::shared_ptr<Program> terrain_gbuffer_program;
-    std::shared_ptr<Program> terrain_depth_program;
-};
+    // Only the pixels no geometry covered pass the depth test
+    graph.add_pass(
+            "Sky pass",
+            [&](RenderGraph::PassBuilder& builder)
+            {
+                builder.read(depth, Access::DepthAttachment);
+                builder.write(lit_hdr, Access::ColorAttachment);
+            },
+            [&](const RenderGraph::PassContext& pass)
+            {
+                pass.bind_framebuffer(false, false);
+                scene->render_sky();
+            });
+
+    // Weighted blended OIT: transparent surfaces are accumulated in a single unsorted pass, then composited
+    Resource transparent_accum;
+    Resource transparent_revealage;
+    if (scene->has_transparent_objects())
+    {
+        graph.add_pass(
+                "Transparency pass",
+                [&](RenderGraph::PassBuilder& builder)
+                {
+                    transparent_accum = builder.create_texture("Transparent accumulation",
+                                                               {size, ImageFormat::RGBA16_FLOAT, output_size});
+                    transparent_revealage = builder.create_texture("Transparent revealage",
+                                                                   {size, ImageFormat::R16_FLOAT, output_size});
+                    builder.read(depth, Access::DepthAttachment);
+                    builder.read(shadow_map);
+                    builder.write(transparent_accum, Access::ColorAttachment);
+                    builder.write(transparent_revealage, Access::ColorAttachment);
+                },
+                [&](const RenderGraph::PassContext& pass)
+                {
+                    pass.texture(transparent_accum).clear(glm::vec4(0.0f));
+                    pass.texture(transparent_revealage).clear(glm::vec4(1.0f));
+                    pass.bind_framebuffer(false, false);
+
+                    shadows->bind();
+                    scene->render_transparent();
+                });
+
+        graph.add_pass(
+                "Transparency composite",
+                [&](RenderGraph::PassBuilder& builder)
+                {
+                    builder.read(transparent_accum);
+                    builder.read(transparent_revealage);
+                    builder.write(lit_hdr, Access::ColorAttachment);
+                },
+                [&](const RenderGraph::PassContext& pass)
+                {
+                    pass.bind_framebuffer(false, false);
+
+                    glEnable(GL_BLEND);
+                    glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+                    glDisable(GL_CULL_FACE);
+
+                    renderer.oit_composite_program->bind();
+                    pass.texture(transparent_accum).bind(0);
+                    pass.texture(transparent_revealage).bind(1);
+                    draw_full_screen_triangle();
+
+                    glDisable(GL_BLEND);
+                });
+    }
+
+    // Measured before TAA, at the internal resolution
+    Resource exposure_data;
+    if (auto_exposure->enabled())
+    {
+        exposure_data = graph.import_buffer("Exposure", auto_exposure->exposure_buffer());
+        graph.add_pass(
+                "Auto Exposure",
+                [&](RenderGraph::PassBuilder& builder)
+                {
+                    builder.read(lit_hdr);
+                    builder.write(exposure_data, Access::StorageWrite);
+                },
+                [&](const RenderGraph::PassContext& pass)
+                { auto_exposure->update(pass.texture(lit_hdr), size, delta_time); });
+    }
+
+    Resource resolved = lit_hdr;
+    if (taa->enabled())
+    {
+        const Resource history = graph.import_texture("TAA history", taa->history());
+        resolved = graph.import_texture("TAA output", taa->next_history());
+
+        graph.add_pass(
+                "TAA Resolve",
+                [&](RenderGraph::PassBuilder& builder)
+                {
+                    builder.read(lit_hdr);
+                    builder.read(depth);
+                    builder.read(motion);
+                    builder.read(history);
+                    builder.write(resolved, Access::ColorAttachment);
+                },
+                [&](const RenderGraph::PassContext& pass)
+                {
+                    pass.bind_framebuffer(false, false);
+                    taa->resolve(pass.texture(lit_hdr), pass.texture(depth), pass.texture(motion), size);
+                });
+    }
+
+    if (gbuffer_debug_view)
+    {
+        graph.add_pass(
+                "Blit",
+                [&](RenderGraph::PassBuilder& builder)
+                {
+                    builder.read(gbuffer_debug);
+                    builder.set_side_effect();
+                },
+                [&](const RenderGraph::PassContext& pass)
+                {
+                    // The G-Buffer debug view is at the internal resolution and gets stretched
+                    glViewport(0, 0, output_size.x, output_size.y);
+                    blit_to_screen(pass.texture(gbuffer_debug), pass.size(gbuffer_debug));
+                });
+    }
+    else
+    {
+        // Upscaling, exposure, tone mapping, color grading and dithering in a single pass writing the screen
+        graph.add_pass(
+                "Post-processing",
+                [&](RenderGraph::PassBuilder& builder)
+                {
+                    builder.read(resolved);
+                    if (exposure_data.is_valid())
+                    {
+                        builder.read(exposure_data, Access::StorageRead);
+                    }
+                    builder.set_side_effect();
+                },
+                [&](const RenderGraph::PassContext& pass)
+                {
+                    PostProcess::Settings settings = post_settings;
+                    settings.exposure = exposure;
+                    settings.auto_exposure = exposure_data.is_valid();
+                    settings.upscale_filter = u32(upscale_filter);
+
+                    glViewport(0, 0, output_size.x, output_size.y);
+                    auto_exposure->bind();
+                    post_process->render(pass.texture(resolved), pass.size(resolved), settings);
+                });
+    }
+
+    graph.compile();
+    graph.execute();
+
+    taa->end_frame(scene->camera());
+}
 
 int main(int argc, char** argv)
 {
@@ -577,10 +1301,23 @@ int main(int argc, char** argv)
 
 
     terrain = std::make_unique<Terrain>();
-
-
-    auto tonemap_program = Program::from_files("tonemap.frag", "screen.vert");
-    RendererState renderer;
+    light_clusters = std::make_unique<LightClusters>();
+    shadows = std::make_unique<ShadowCascades>();
+    render_graph = std::make_unique<RenderGraph>();
+    taa = std::make_unique<TemporalAA>();
+    auto_exposure = std::make_unique<AutoExposure>();
+    tiled_shading = std::make_unique<TiledShading>();
+    post_process = std::make_unique<PostProcess>();
+
+
+    RendererState renderer = RendererState::create();
+    terrain->init(renderer.heightmap_program);
+    if (!heightfield_file.empty())
+    {
+        terrain->load_heightfield(heightfield_file);
+    }
+    edited_noise_frequency = terrain->noise_frequency();
+    edited_height_scale = terrain->height_scale();
 
     for (;;)
     {
@@ -592,17 +1329,22 @@ int main(int argc, char** argv)
 
         process_profile_markers();
 
+        for (const ProfileZone& zone: retrieve_profile())
+        {
+            if (zone.name == "Frame")
+            {
+                dynamic_resolution.update(zone.gpu_time);
+                break;
+            }
+        }
+
         {
             int width = 0;
             int height = 0;
             glfwGetWindowSize(window, &width, &height);
 
-            if (renderer.size != glm::uvec2(width, height))
-            {
-                renderer = RendererState::create(glm::uvec2(width, height));
-                terrain->init(renderer.heightmap_program, renderer.heightmap_texture);
-            }
-            
+            // Render targets are reallocated by the render graph when needed
+            renderer.size = glm::uvec2(std::max(width, 0), std::max(height, 0));
         }
 
         update_delta_time();
@@ -616,183 +1358,7 @@ int main(int argc, char** argv)
         {
             PROFILE_GPU("Frame");
             glPushDebugGroup(GL_DEBUG_SOURCE_APPLICATION, 0, -1, "Frame");
-            // Z-prepass (for G-Buffer)
-            {
-                PROFILE_GPU("Z-prepass");
-                glPushDebugGroup(GL_DEBUG_SOURCE_APPLICATION, 0, -1, "Z-prepass");
-
-                renderer.gbuffer_framebuffer.bind(true, false);
-
-                // Disable color channels (this improves the performance)
-                glColorMask(GL_FALSE, GL_FALSE, GL_FALSE, GL_FALSE);
-                renderer.depth_program->bind();
-                scene->render();
-                
-
-
-                renderer.terrain_depth_program->bind();
-                terrain->render(*renderer.terrain_depth_program, scene->camera());
-                glColorMask(GL_TRUE, GL_TRUE, GL_TRUE, GL_TRUE);
-
-                glPopDebugGroup();
-            }
-
-            // {
-            //     // --- Shadow depth pass ---
-            //     PROFILE_GPU("Shadow pass");
-            //     glPushDebugGroup(GL_DEBUG_SOURCE_APPLICATION, 0, -1, "Shadow pass");
-
-            //     const float alt = glm::radians(sun_altitude);
-            //     const float azi = glm::radians(sun_azimuth);
-            //     const glm::vec3 light_dir =
-            //             glm::normalize(glm::vec3(sin(azi) * cos(alt), sin(alt), cos(azi) * cos(alt)));
-
-            //     const glm::vec3 scene_center = glm::vec3(0.0f);
-            //     const glm::vec3 light_pos = scene_center - light_dir * sun_altitude;
-
-            //     const float ortho_size = 20.0f;
-            //     const glm::mat4 light_view = glm::lookAt(light_pos, scene_center, glm::vec3(0.0f, 1.0f, 0.0f));
-            //     const glm::mat4 light_proj = glm::ortho(-ortho_size, ortho_size, -ortho_size, ortho_size, 0.1f,
-            //     100.0f); const glm::mat4 light_space = light_proj * light_view;
-
-            //     scene->set_light_view_proj(light_space);
-
-            //     const glm::uvec2 shadow_size = renderer.shadow_depth_texture.size();
-            //     renderer.shadow_framebuffer.bind(true, false);
-            //     glViewport(0, 0, shadow_size.x, shadow_size.y);
-
-            //     GLint prev_depth_func = 0;
-            //     glGetIntegerv(GL_DEPTH_FUNC, &prev_depth_func);
-            //     GLdouble prev_clear_depth = 0.0;
-            //     glGetDoublev(GL_DEPTH_CLEAR_VALUE, &prev_clear_depth);
-
-            //     glEnable(GL_CULL_FACE);
-            //     glCullFace(GL_BACK);
-            //     glEnable(GL_DEPTH_TEST);
-            //     glDepthFunc(GL_LEQUAL);
-            //     glClearDepth(1.0);
-            //     glClear(GL_DEPTH_BUFFER_BIT);
-
-            //     renderer.shadow_program->bind();
-            //     renderer.shadow_program->set_uniform(HASH("lightSpaceMatrix"), light_space);
-            //     for (const SceneObject& obj: scene->objects())
-            //     {
-            //         obj.render_depth_only(*renderer.shadow_program);
-            //     }
-
-            //     glDepthFunc(prev_depth_func);
-            //     glClearDepth(prev_clear_depth);
-
-            //     int w = int(renderer.size.x);
-            //     int h = int(renderer.size.y);
-            //     glViewport(0, 0, w, h);
-
-            //     glPopDebugGroup();
-            // }
-
-
-            // G-Buffer pass
-
-            {
-
-                PROFILE_GPU("G-Buffer pass");
-                glPushDebugGroup(GL_DEBUG_SOURCE_APPLICATION, 0, -1, "G-Buffer pass");
-
-                renderer.gbuffer_framebuffer.bind(false, true);
-                renderer.shadow_depth_texture.bind(6);
-                scene->render();
-
-                renderer.terrain_gbuffer_program->bind();
-                terrain->render(*renderer.terrain_gbuffer_program, scene->camera());
-
-                glPopDebugGroup();
-            }
-
-            /*{
-                PROFILE_GPU("G-Buffer Debug");
-                glPushDebugGroup(GL_DEBUG_SOURCE_APPLICATION, 0, -1, "G-Buffer Debug");
-
-                renderer.gbuffer_debug_framebuffer.bind(false, true);
-                renderer.gbuffer_debug_program->bind();
-                renderer.gbuffer_debug_program->set_uniform(HASH("debug_mode"), u32(gbuffer_debug_mode));
-
-                renderer.gbuffer_albedo_roughness.bind(0);
-                renderer.gbuffer_normal_metal.bind(1);
-                renderer.depth_texture.bind(2);
-
-                draw_full_screen_triangle();
-
-                glPopDebugGroup();
-            }
-
-            */
-            {
-                PROFILE_GPU("Scene Shading Pass");
-                glPushDebugGroup(GL_DEBUG_SOURCE_APPLICATION, 0, -1, "Scene Shading Pass");
-
-                glDisable(GL_BLEND);
-                glDisable(GL_DEPTH_TEST);
-                glDepthMask(GL_FALSE);
-                glDisable(GL_CULL_FACE);
-
-                renderer.shading_framebuffer.bind(false, true);
-                renderer.scene_shading_program->bind();
-
-                renderer.gbuffer_albedo_roughness.bind(0);
-                renderer.gbuffer_normal_metal.bind(1);
-                renderer.depth_texture.bind(2);
-                scene->bind_buffer();
-
-                draw_full_screen_triangle();
-
-                glPopDebugGroup();
-            }
-
-            // {
-            //     PROFILE_GPU("Point Lights Shading Pass");
-            //     glPushDebugGroup(GL_DEBUG_SOURCE_APPLICATION, 0, -1, "Point Lights Shading Pass");
-
-            //     renderer.shading_framebuffer.bind(false, false);
-
-            //     renderer.gbuffer_albedo_roughness.bind(0);
-            //     renderer.gbuffer_normal_metal.bind(1);
-            //     renderer.depth_texture.bind(2);
-            //     scene->bind_buffer_pl();
-
-            //     renderer.point_light_material.bind();
-            //     draw_full_screen_triangle();
-
-            //     glDepthMask(GL_TRUE);
-            //     glDisable(GL_BLEND);
-            //     glEnable(GL_CULL_FACE);
-            //     glCullFace(GL_BACK);
-
-            //     glPopDebugGroup();
-            // }
-
-            // Apply a tonemap as a full screen pass
-            {
-                PROFILE_GPU("Tonemap");
-                glPushDebugGroup(GL_DEBUG_SOURCE_APPLICATION, 0, -1, "Tonemap");
-
-                renderer.tone_map_framebuffer.bind(false, true);
-                tonemap_program->bind();
-                tonemap_program->set_uniform(HASH("exposure"), exposure);
-                renderer.lit_hdr_texture.bind(0);
-                draw_full_screen_triangle();
-
-                glPopDebugGroup();
-            }
-
-            // Blit debug result to screen
-            {
-                PROFILE_GPU("Blit");
-                glPushDebugGroup(GL_DEBUG_SOURCE_APPLICATION, 0, -1, "Blit");
-
-                blit_to_screen(renderer.tone_mapped_texture);
-
-                glPopDebugGroup();
-            }
+            render_frame(renderer);
 
             // Draw GUI on top
             glPushDebugGroup(GL_DEBUG_SOURCE_APPLICATION, 0, -1, "GUI");
@@ -809,8 +1375,14 @@ int main(int argc, char** argv)
     // destroy scene and child OpenGL objects
     scene = nullptr;
     envmap = nullptr;
+    light_clusters = nullptr;
+    shadows = nullptr;
     imgui = nullptr;
-    tonemap_program = nullptr;
+    render_graph = nullptr;
+    taa = nullptr;
+    auto_exposure = nullptr;
+    tiled_shading = nullptr;
+    post_process = nullptr;
     renderer = {};
     destroy_graphics();
 }
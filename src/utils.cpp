@@ -6,8 +6,11 @@
 #include <cstdio>
 #include <cstdlib>
 
+#include <algorithm>
 #include <chrono>
 #include <iostream>
+#include <thread>
+#include <vector>
 
 #ifdef OS_WIN
 #include <windows.h>
@@ -96,6 +99,32 @@ namespace OM3D
     }
 
 
+    void parallel_for(size_t count, size_t min_range_size, const std::function<void(size_t, size_t)>& func)
+    {
+        const size_t max_threads = std::max(size_t(std::thread::hardware_concurrency()), size_t(1));
+        const size_t thread_count = std::clamp(count / std::max(min_range_size, size_t(1)), size_t(1), max_threads);
+        const size_t range_size = (count + thread_count - 1) / thread_count;
+
+        // The calling thread takes the first range
+        std::vector<std::thread> threads;
+        threads.reserve(thread_count - 1);
+        for (size_t i = 1; i < thread_count; ++i)
+        {
+            const size_t begin = i * range_size;
+            const size_t end = std::min(begin + range_size, count);
+            if (begin < end)
+            {
+                threads.emplace_back(func, begin, end);
+            }
+        }
+        func(0, std::min(range_size, count));
+
+        for (std::thread& thread: threads)
+        {
+            thread.join();
+        }
+    }
+
     bool ends_with(std::string_view str, std::string_view suffix)
     {
         if (str.size() < suffix.size())
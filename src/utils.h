@@ -5,6 +5,7 @@
 
 #include <array>
 #include <cstdint>
+#include <functional>
 #include <string>
 #include <utility>
 
@@ -258,6 +259,10 @@ namespace OM3D
     double program_time();
     Result<std::string> read_text_file(const std::string& file_name);
 
+    // Splits [0, count) in ranges of at least min_range_size and calls func(begin, end) for them on all hardware
+    // threads, returns once every range is done
+    void parallel_for(size_t count, size_t min_range_size, const std::function<void(size_t, size_t)>& func);
+
     bool ends_with(std::string_view str, std::string_view suffix);
 
 } // namespace OM3D